@@ -9,6 +9,7 @@
 
 #include "managed_i2c.h"
 
+#include "input_latency.h"
 #include "touchpad.h"
 
 static const char* TAG = "hardware";
@@ -21,8 +22,6 @@ ST7789V dev_st7789v = {0};
 
 static pax_buf_t pax_buffer;
 
-static xQueueHandle input_queue;
-
 static esp_err_t _bus_init() {
     esp_err_t res;
 
@@ -129,8 +128,8 @@ esp_err_t bsp_init() {
 //        return res;
 //    }
     
-    input_queue = xQueueCreate(8, sizeof(input_message_t));
-    init_touch(input_queue);
+    input_buffer_init();
+    init_touch();
 
     bsp_ready = true;
     
@@ -147,14 +146,19 @@ ST7789V* get_st7789v() {
 
 esp_err_t display_flush() {
     if (!bsp_ready) return ESP_FAIL;
-    return st7789v_write(&dev_st7789v, pax_buffer.buf);
+    esp_err_t res = st7789v_write(&dev_st7789v, pax_buffer.buf);
+    input_latency_frame_done();
+    return res;
+}
+
+esp_err_t display_flush_partial(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+    if (!bsp_ready) return ESP_FAIL;
+    esp_err_t res = st7789v_write_partial(&dev_st7789v, pax_buffer.buf, x0, y0, x1, y1);
+    input_latency_frame_done();
+    return res;
 }
 
 pax_buf_t* get_pax_buffer() {
     if (!bsp_ready) return NULL;
     return &pax_buffer;
 }
-
-xQueueHandle get_input_queue() {
-    return input_queue;
-}
@@ -37,3 +37,6 @@
 #define INPUT_TOUCH0 0
 #define INPUT_TOUCH1 1
 #define INPUT_TOUCH2 2
+
+// Inputs that only move a selection and may be merged when a screen is slow to process them
+#define INPUT_COALESCE_MASK (1 << INPUT_TOUCH1)
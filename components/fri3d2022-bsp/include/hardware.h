@@ -9,11 +9,7 @@
 #include "st7789v.h"
 #include "pax_gfx.h"
 #include "fri3d_badge.h"
-
-typedef struct _input_message {
-    uint8_t input;
-    bool    state;
-} input_message_t;
+#include "input_buffer.h"
 
 /** \brief Initialize basic board support
  *
@@ -35,6 +31,7 @@ ST7789V* get_st7789v();
 
 esp_err_t display_flush();
 
-pax_buf_t* get_pax_buffer();
+/** \brief Send only the rectangle from (x0, y0) to (x1, y1), inclusive, of the frame buffer to the display */
+esp_err_t display_flush_partial(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
 
-xQueueHandle get_input_queue();
+pax_buf_t* get_pax_buffer();
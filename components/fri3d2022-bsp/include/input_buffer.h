@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+
+// Amount of messages the input buffer can hold before input is dropped.
+#define INPUT_BUFFER_SIZE 32
+
+typedef struct _input_message {
+    uint8_t  input;
+    bool     state;
+    uint16_t count;      // Amount of identical inputs merged into this message, at least 1
+    int64_t  timestamp;  // Time at which the first merged input was detected, in microseconds since boot
+} input_message_t;
+
+// Create the input buffer, called by bsp_init().
+void input_buffer_init();
+
+// Add an input to the buffer, called by the input drivers.
+// Navigation inputs identical to the last queued input are merged into it by
+// incrementing its count. Returns false if the buffer is full and the input was dropped.
+bool input_buffer_send(const input_message_t* message);
+
+// Wait at most `timeout` ticks for an input and remove it from the buffer.
+// Returns whether a message was received.
+bool input_buffer_receive(input_message_t* message, TickType_t timeout);
+
+// Get the amount of inputs that were dropped and merged since boot.
+void input_buffer_get_stats(uint32_t* dropped, uint32_t* coalesced);
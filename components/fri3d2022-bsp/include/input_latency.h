@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Maximum amount of screens for which latency is tracked separately.
+#define INPUT_LATENCY_MAX_SCREENS 12
+
+// Amount of histogram buckets per screen.
+#define INPUT_LATENCY_BUCKETS 40
+
+typedef struct _input_latency_stats {
+    const char* screen;
+    uint32_t    count;
+    uint32_t    p50_ms;
+    uint32_t    p99_ms;
+    uint32_t    max_ms;
+} input_latency_stats_t;
+
+// Set the name of the screen that is currently handling input.
+// The name is not copied and must remain valid, use a string literal.
+void input_latency_set_screen(const char* screen);
+
+// Register an input event, called by the input driver.
+// The first frame flushed after this event is attributed to it.
+void input_latency_mark_input(int64_t timestamp);
+
+// Register a completed frame, called by display_flush().
+void input_latency_frame_done();
+
+// Get the amount of screens for which latency has been recorded.
+size_t input_latency_get_screen_count();
+
+// Get the latency statistics of the screen at `index`.
+// Returns false if there is no screen at that index.
+bool input_latency_get_stats(size_t index, input_latency_stats_t* stats);
+
+// Print the histograms as CSV on the serial console.
+void input_latency_dump();
+
+// Clear all recorded latency histograms.
+void input_latency_reset();
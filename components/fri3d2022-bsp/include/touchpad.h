@@ -1,6 +1,3 @@
 #pragma once
 
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
-
-void init_touch(xQueueHandle output_queue);
+void init_touch();
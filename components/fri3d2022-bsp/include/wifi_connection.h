@@ -24,11 +24,15 @@ typedef enum {
 // Retry forever.
 #define WIFI_INFINITE_RETRIES 255
 
+// Maximum amount of networks kept by an asynchronous scan.
+#define WIFI_SCAN_MAX_NETWORKS 64
+
 esp_netif_ip_info_t* wifi_get_ip_info();
 
 // First time initialisation of the WiFi stack.
 // Initialises internal resources and ESP32 WiFi.
 // Use this if nothing else initialises ESP32 WiFi.
+// Called on first use by the connect and scan functions, calling it again does nothing.
 void wifi_init();
 
 // First time initialisation of the WiFi stack.
@@ -58,6 +62,10 @@ void wifi_connect_async(const char* aSsid, const char* aPassword, wifi_auth_mode
 // Will try at most `aRetryMax` times, or forever if it's WIFI_INFINITE_RETRIES.
 void wifi_connect_ent_async(const char* aSsid, const char *aIdent, const char *aAnonIdent, const char* aPassword, esp_eap_ttls_phase2_types phase2, uint8_t aRetryMax);
 
+// Connect to the access point `bssid` on `channel` on the next connection attempt.
+// This skips scanning all channels, the attempt fails if the access point is not found there.
+void wifi_set_connect_hint(const uint8_t *bssid, uint8_t channel);
+
 // Disconnect from WiFi and do not attempt to reconnect.
 void wifi_disconnect();
 
@@ -73,5 +81,25 @@ bool wifi_is_connected();
 // Returns the number of APs found.
 size_t wifi_scan(wifi_ap_record_t **aps);
 
+// Start scanning for WiFi networks in the background, one channel at a time.
+// The results are updated as each channel is done, see wifi_scan_async_get.
+// Returns false if a scan is already running or could not be started.
+bool wifi_scan_async_start();
+
+// Test whether the asynchronous scan is still running.
+bool wifi_scan_async_busy();
+
+// Get the amount of changes to the asynchronous scan results.
+// Use this to check whether the results have to be fetched again.
+uint32_t wifi_scan_async_generation();
+
+// Copy at most `max` networks found by the asynchronous scan so far to `aps`.
+// Networks are de-duplicated by SSID, keeping the strongest access point, and sorted strongest first.
+// Returns the number of networks copied.
+size_t wifi_scan_async_get(wifi_ap_record_t *aps, size_t max);
+
+// Stop the asynchronous scan, waiting for it to finish, and release the results.
+void wifi_scan_async_stop();
+
 // Get the strength value for a given RSSI.
 wifi_strength_t wifi_rssi_to_strength(int8_t rssi);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+
+// The link is kept up for this long after the last user released it, so that the next user doesn't have to associate again.
+#define WIFI_SESSION_GRACE_MS 30000
+
+// Get a reference to a connection to the stored WiFi network, connecting if there is none.
+// The access point and channel of the last connection are cached in NVS, so that connecting doesn't need a full scan.
+// Returns false if no connection could be made, in which case no reference is taken.
+bool wifi_session_acquire();
+
+// Like wifi_session_acquire, but an idle connection is dropped first, so that the connection is made from scratch.
+// A connection that is in use by other users is reused.
+bool wifi_session_acquire_fresh();
+
+// Release a reference taken with wifi_session_acquire. WiFi is disabled when no references are taken for WIFI_SESSION_GRACE_MS.
+void wifi_session_release();
+
+// Mark the start and end of a transfer. Power save is disabled while transfers are running and enabled again when the link is idle.
+void wifi_session_transfer_begin();
+void wifi_session_transfer_end();
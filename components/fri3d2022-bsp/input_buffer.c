@@ -0,0 +1,76 @@
+#include "input_buffer.h"
+
+#include <string.h>
+
+#include "fri3d_badge.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static portMUX_TYPE      buffer_lock     = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t buffer_available = NULL;
+static input_message_t   buffer[INPUT_BUFFER_SIZE];
+static size_t            buffer_head     = 0;
+static size_t            buffer_count    = 0;
+static uint32_t          stats_dropped   = 0;
+static uint32_t          stats_coalesced = 0;
+
+void input_buffer_init() {
+    buffer_available = xSemaphoreCreateBinary();
+    buffer_head      = 0;
+    buffer_count     = 0;
+}
+
+bool input_buffer_send(const input_message_t* message) {
+    bool result = true;
+    portENTER_CRITICAL(&buffer_lock);
+    input_message_t* last = (buffer_count > 0) ? &buffer[(buffer_head + buffer_count - 1) % INPUT_BUFFER_SIZE] : NULL;
+    if ((last != NULL) && (INPUT_COALESCE_MASK & (1 << message->input)) && (last->input == message->input) && (last->state == message->state) &&
+        (last->count < UINT16_MAX)) {
+        // Merge with the last queued input, keeping the timestamp of the oldest one
+        last->count++;
+        stats_coalesced++;
+    } else if (buffer_count < INPUT_BUFFER_SIZE) {
+        input_message_t* slot = &buffer[(buffer_head + buffer_count) % INPUT_BUFFER_SIZE];
+        memcpy(slot, message, sizeof(input_message_t));
+        if (slot->count < 1) slot->count = 1;
+        buffer_count++;
+    } else {
+        stats_dropped++;
+        result = false;
+    }
+    portEXIT_CRITICAL(&buffer_lock);
+    if (result) xSemaphoreGive(buffer_available);
+    return result;
+}
+
+bool input_buffer_receive(input_message_t* message, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+    while (true) {
+        portENTER_CRITICAL(&buffer_lock);
+        if (buffer_count > 0) {
+            memcpy(message, &buffer[buffer_head], sizeof(input_message_t));
+            buffer_head = (buffer_head + 1) % INPUT_BUFFER_SIZE;
+            buffer_count--;
+            portEXIT_CRITICAL(&buffer_lock);
+            return true;
+        }
+        portEXIT_CRITICAL(&buffer_lock);
+
+        TickType_t remaining = portMAX_DELAY;
+        if (timeout != portMAX_DELAY) {
+            TickType_t waited = xTaskGetTickCount() - start;
+            if (waited >= timeout) return false;
+            remaining = timeout - waited;
+        }
+        // The semaphore may have been given for a message that was already received, so check the buffer again after waking up
+        if ((xSemaphoreTake(buffer_available, remaining) != pdTRUE) && (timeout != portMAX_DELAY) && (buffer_count == 0)) return false;
+    }
+}
+
+void input_buffer_get_stats(uint32_t* dropped, uint32_t* coalesced) {
+    portENTER_CRITICAL(&buffer_lock);
+    if (dropped != NULL) *dropped = stats_dropped;
+    if (coalesced != NULL) *coalesced = stats_coalesced;
+    portEXIT_CRITICAL(&buffer_lock);
+}
@@ -0,0 +1,135 @@
+#include "input_latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef struct _input_latency_screen {
+    const char* name;
+    uint32_t    count;
+    uint32_t    max_ms;
+    uint32_t    buckets[INPUT_LATENCY_BUCKETS];
+} input_latency_screen_t;
+
+static portMUX_TYPE           latency_lock  = portMUX_INITIALIZER_UNLOCKED;
+static input_latency_screen_t screens[INPUT_LATENCY_MAX_SCREENS];
+static size_t                 screen_count  = 0;
+static const char*            active_screen = "unknown";
+static int64_t                pending_input = 0;  // Timestamp of the oldest input not yet shown on screen, 0 if none
+
+// Upper bound (in milliseconds) of a histogram bucket.
+// The first 8 buckets are 1 ms wide, after that every power of two is split into 4 buckets.
+static uint32_t bucket_upper_bound(size_t bucket) {
+    if (bucket < 8) return bucket + 1;
+    size_t octave = (bucket - 8) / 4;
+    size_t step   = (bucket - 8) % 4;
+    return (8 << octave) + (step + 1) * (2 << octave);
+}
+
+static size_t bucket_for(uint32_t latency_ms) {
+    for (size_t bucket = 0; bucket < INPUT_LATENCY_BUCKETS - 1; bucket++) {
+        if (latency_ms < bucket_upper_bound(bucket)) return bucket;
+    }
+    return INPUT_LATENCY_BUCKETS - 1;  // Overflow bucket
+}
+
+static input_latency_screen_t* find_screen(const char* name) {
+    for (size_t index = 0; index < screen_count; index++) {
+        if ((screens[index].name == name) || (strcmp(screens[index].name, name) == 0)) return &screens[index];
+    }
+    if (screen_count >= INPUT_LATENCY_MAX_SCREENS) return NULL;
+    input_latency_screen_t* screen = &screens[screen_count++];
+    memset(screen, 0, sizeof(input_latency_screen_t));
+    screen->name = name;
+    return screen;
+}
+
+static uint32_t percentile(const input_latency_screen_t* screen, uint32_t percent) {
+    if (screen->count == 0) return 0;
+    uint32_t target     = ((screen->count * percent) + 99) / 100;
+    uint32_t cumulative = 0;
+    for (size_t bucket = 0; bucket < INPUT_LATENCY_BUCKETS; bucket++) {
+        cumulative += screen->buckets[bucket];
+        if (cumulative >= target) {
+            uint32_t bound = bucket_upper_bound(bucket);
+            return (bound < screen->max_ms) ? bound : screen->max_ms;
+        }
+    }
+    return screen->max_ms;
+}
+
+void input_latency_set_screen(const char* screen) {
+    portENTER_CRITICAL(&latency_lock);
+    active_screen = (screen != NULL) ? screen : "unknown";
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+void input_latency_mark_input(int64_t timestamp) {
+    portENTER_CRITICAL(&latency_lock);
+    if (pending_input == 0) pending_input = timestamp;
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+void input_latency_frame_done() {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&latency_lock);
+    if (pending_input != 0) {
+        uint32_t                latency_ms = (now - pending_input) / 1000;
+        input_latency_screen_t* screen     = find_screen(active_screen);
+        if (screen != NULL) {
+            screen->buckets[bucket_for(latency_ms)]++;
+            screen->count++;
+            if (latency_ms > screen->max_ms) screen->max_ms = latency_ms;
+        }
+        pending_input = 0;
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+size_t input_latency_get_screen_count() { return screen_count; }
+
+bool input_latency_get_stats(size_t index, input_latency_stats_t* stats) {
+    if (stats == NULL) return false;
+    portENTER_CRITICAL(&latency_lock);
+    if (index >= screen_count) {
+        portEXIT_CRITICAL(&latency_lock);
+        return false;
+    }
+    input_latency_screen_t* screen = &screens[index];
+    stats->screen                  = screen->name;
+    stats->count                   = screen->count;
+    stats->p50_ms                  = percentile(screen, 50);
+    stats->p99_ms                  = percentile(screen, 99);
+    stats->max_ms                  = screen->max_ms;
+    portEXIT_CRITICAL(&latency_lock);
+    return true;
+}
+
+void input_latency_dump() {
+    printf("screen,count,p50_ms,p99_ms,max_ms");
+    for (size_t bucket = 0; bucket < INPUT_LATENCY_BUCKETS - 1; bucket++) {
+        printf(",lt%u", bucket_upper_bound(bucket));
+    }
+    printf(",overflow\r\n");
+    for (size_t index = 0; index < screen_count; index++) {
+        input_latency_screen_t screen;
+        portENTER_CRITICAL(&latency_lock);
+        memcpy(&screen, &screens[index], sizeof(input_latency_screen_t));
+        portEXIT_CRITICAL(&latency_lock);
+        printf("%s,%u,%u,%u,%u", screen.name, screen.count, percentile(&screen, 50), percentile(&screen, 99), screen.max_ms);
+        for (size_t bucket = 0; bucket < INPUT_LATENCY_BUCKETS; bucket++) {
+            printf(",%u", screen.buckets[bucket]);
+        }
+        printf("\r\n");
+    }
+}
+
+void input_latency_reset() {
+    portENTER_CRITICAL(&latency_lock);
+    screen_count  = 0;
+    pending_input = 0;
+    portEXIT_CRITICAL(&latency_lock);
+}
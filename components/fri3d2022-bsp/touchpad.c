@@ -3,12 +3,14 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "driver/touch_pad.h"
 #include "soc/rtc_periph.h"
 #include "soc/sens_periph.h"
 
 #include "hardware.h"
+#include "input_latency.h"
 
 static const char *TAG = "Touch pad";
 
@@ -18,10 +20,9 @@ static const char *TAG = "Touch pad";
 
 static uint32_t touch_pads[TOUCH_PAD_AMOUNT] = {7, 6, 4};
 static bool s_pad_activated[TOUCH_PAD_AMOUNT];
+static int64_t s_pad_timestamp[TOUCH_PAD_AMOUNT];
 static uint8_t touch_pad_mapping[TOUCH_PAD_AMOUNT] = {INPUT_TOUCH0, INPUT_TOUCH1, INPUT_TOUCH2};
 
-static xQueueHandle queue = NULL;
-
 static void set_thresholds(void) {
     uint16_t touch_value;
     for (int i = 0; i < TOUCH_PAD_AMOUNT; i++) {
@@ -36,7 +37,8 @@ static void rtc_intr(void *arg) {
     //clear interrupt
     touch_pad_clear_status();
     for (int i = 0; i < TOUCH_PAD_AMOUNT; i++) {
-        if ((pad_intr >> touch_pads[i]) & 0x01) {
+        if (((pad_intr >> touch_pads[i]) & 0x01) && !s_pad_activated[i]) {
+            s_pad_timestamp[i] = esp_timer_get_time();
             s_pad_activated[i] = true;
         }
     }
@@ -59,7 +61,11 @@ static void tp_example_read_task(void *pvParameter)
                 input_message_t message;
                 message.input = touch_pad_mapping[i];
                 message.state = true;
-                xQueueSend(queue, &message, 0);
+                message.count = 1;
+                message.timestamp = s_pad_timestamp[i];
+                if (input_buffer_send(&message)) {
+                    input_latency_mark_input(message.timestamp);
+                }
 
                 // Wait a while for the pad being released
                 vTaskDelay(300 / portTICK_PERIOD_MS);
@@ -73,8 +79,7 @@ static void tp_example_read_task(void *pvParameter)
     }
 }
 
-void init_touch(xQueueHandle output_queue) {
-    queue = output_queue;
+void init_touch() {
     ESP_ERROR_CHECK(touch_pad_init());
     touch_pad_set_fsm_mode(TOUCH_FSM_MODE_TIMER);
     touch_pad_set_voltage(TOUCH_HVOLT_2V7, TOUCH_LVOLT_0V5, TOUCH_HVOLT_ATTEN_1V);
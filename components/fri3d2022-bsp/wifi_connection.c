@@ -2,6 +2,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -18,12 +19,42 @@ static const char *TAG = "wifi_connection";
 
 static EventGroupHandle_t wifiEventGroup;
 
+// The WiFi stack is brought up on first use, most boots never need it.
+#define WIFI_INIT_NONE 0
+#define WIFI_INIT_BUSY 1
+#define WIFI_INIT_DONE 2
+
+static portMUX_TYPE initLock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t initState = WIFI_INIT_NONE;
+
 static uint8_t retryCount = 0;
 static uint8_t maxRetries = 3;
 static bool isScanning = false;
 
+// Access point to connect to on the next connection attempt, skipping the scan.
+static uint8_t hintBssid[6];
+static uint8_t hintChannel = 0;
+
 static esp_netif_ip_info_t ip_info = {0};
 
+// Size of the SSID hash set of the asynchronous scan, a power of two of at least twice WIFI_SCAN_MAX_NETWORKS.
+#define WIFI_SCAN_HASH_SIZE 128
+
+// Networks found by the asynchronous scan.
+typedef struct {
+    wifi_ap_record_t records[WIFI_SCAN_MAX_NETWORKS]; // Strongest access point per SSID, in order of discovery
+    uint8_t order[WIFI_SCAN_MAX_NETWORKS];             // Indices into records, strongest first
+    uint8_t hash[WIFI_SCAN_HASH_SIZE];                 // Index into records plus one per slot, 0 if the slot is free
+    size_t count;
+    uint32_t generation;                               // Incremented whenever the list changes
+} wifi_scan_list_t;
+
+static SemaphoreHandle_t scanMutex;
+static SemaphoreHandle_t scanFinished;
+static wifi_scan_list_t *scanList = NULL;
+static volatile bool scanStop = false;
+static volatile bool scanRunning = false;
+
 #define WIFI_SORT_ERRCHECK(err) do {int res = (err); if(res) {ESP_LOGE(TAG, "WiFi connection error: %s", esp_err_to_name(res)); goto error; } } while(0)
 
 // Handles WiFi events required to stay connected.
@@ -39,6 +70,7 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
         xEventGroupClearBits(wifiEventGroup, WIFI_STARTED_BIT);
         ESP_LOGI(TAG, "WiFi station stop.");
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        xEventGroupClearBits(wifiEventGroup, WIFI_CONNECTED_BIT);
         if (maxRetries == WIFI_INFINITE_RETRIES || retryCount < maxRetries) {
             esp_wifi_connect();
             retryCount++;
@@ -58,12 +90,62 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
     }
 }
 
+// Apply the connection hint to a config, the hint is used only once.
+static void wifi_apply_hint(wifi_config_t *wifi_config) {
+    if (hintChannel == 0) return;
+    memcpy(wifi_config->sta.bssid, hintBssid, sizeof(hintBssid));
+    wifi_config->sta.bssid_set = true;
+    wifi_config->sta.channel = hintChannel;
+    hintChannel = 0;
+}
+
+// Connect to a specific access point on a known channel on the next connection attempt, without scanning all channels.
+void wifi_set_connect_hint(const uint8_t *bssid, uint8_t channel) {
+    memcpy(hintBssid, bssid, sizeof(hintBssid));
+    hintChannel = channel;
+}
+
 esp_netif_ip_info_t* wifi_get_ip_info() {
     return &ip_info;
 }
 
-// Firt time initialisation of the WiFi stack.
+// Claim the initialisation of the WiFi stack.
+// Returns false if it is already done, waiting for another task that is busy doing it.
+static bool wifi_init_claim() {
+    portENTER_CRITICAL(&initLock);
+    bool claimed = initState == WIFI_INIT_NONE;
+    if (claimed) initState = WIFI_INIT_BUSY;
+    portEXIT_CRITICAL(&initLock);
+    if (!claimed) {
+        while (initState == WIFI_INIT_BUSY) vTaskDelay(1);
+    }
+    return claimed;
+}
+
+// Test whether the WiFi stack has been initialised.
+static bool wifi_is_initialised() {
+    return initState == WIFI_INIT_DONE;
+}
+
+static void wifi_init_resources() {
+    // Create an event group for WiFi things.
+    wifiEventGroup = xEventGroupCreate();
+    scanMutex = xSemaphoreCreateMutex();
+    scanFinished = xSemaphoreCreateBinary();
+    
+    // Register event handlers for WiFi.
+    esp_event_handler_instance_t instance_any_id;
+    esp_event_handler_instance_t instance_got_ip;
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, &instance_any_id));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, &instance_got_ip));
+}
+
+// First time initialisation of the WiFi stack.
+// Does nothing if the WiFi stack has already been initialised.
 void wifi_init() {
+    if (!wifi_init_claim()) return;
+    ESP_LOGI(TAG, "Initialising the WiFi stack");
+    
     // Initialise WiFi stack.
     ESP_ERROR_CHECK(esp_netif_init());
     
@@ -74,24 +156,20 @@ void wifi_init() {
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     
     // Initialise internal resources.
-    wifi_init_no_hardware();
+    wifi_init_resources();
     
     // Turn off WiFi hardware.
     ESP_ERROR_CHECK(esp_wifi_stop());
+    initState = WIFI_INIT_DONE;
 }
 
 // First time initialisation of the WiFi stack.
 // Initialises internal resources only.
 // Use this if ESP32 WiFi is already initialised.
 void wifi_init_no_hardware() {
-    // Create an event group for WiFi things.
-    wifiEventGroup = xEventGroupCreate();
-    
-    // Register event handlers for WiFi.
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, &instance_got_ip));
+    if (!wifi_init_claim()) return;
+    wifi_init_resources();
+    initState = WIFI_INIT_DONE;
 }
 
 // Connect to a traditional username/password WiFi network.
@@ -116,6 +194,8 @@ bool wifi_connect_ent(const char* aSsid, const char *aIdent, const char *aAnonId
 // Will return right away.
 // Will try at most `aRetryMax` times, or forever if it's WIFI_INFINITE_RETRIES.
 void wifi_connect_async(const char* aSsid, const char* aPassword, wifi_auth_mode_t aAuthmode, uint8_t aRetryMax) {
+    wifi_init();
+    
     // Set the retry counts.
     retryCount = 0;
     maxRetries = aRetryMax;
@@ -130,6 +210,7 @@ void wifi_connect_async(const char* aSsid, const char* aPassword, wifi_auth_mode
     strncpy((char*) wifi_config.sta.ssid, aSsid, 32);
     strncpy((char*) wifi_config.sta.password, aPassword, 64);
     wifi_config.sta.threshold.authmode = aAuthmode;
+    wifi_apply_hint(&wifi_config);
     
     // Set WiFi config.
     WIFI_SORT_ERRCHECK(esp_wifi_set_mode(WIFI_MODE_STA));
@@ -149,6 +230,7 @@ void wifi_connect_async(const char* aSsid, const char* aPassword, wifi_auth_mode
 // Will return right away.
 // Will try at most `aRetryMax` times, or forever if it's WIFI_INFINITE_RETRIES.
 void wifi_connect_ent_async(const char* aSsid, const char *aIdent, const char *aAnonIdent, const char* aPassword, esp_eap_ttls_phase2_types phase2, uint8_t aRetryMax) {
+    wifi_init();
     retryCount = 0;
     maxRetries = aRetryMax;
     wifi_config_t wifi_config = {0};
@@ -157,6 +239,7 @@ void wifi_connect_ent_async(const char* aSsid, const char *aIdent, const char *a
         return false;
     }
     strncpy((char*) wifi_config.sta.ssid, aSsid, 32);
+    wifi_apply_hint(&wifi_config);
     
     // Disable WiFi if it was active, reset event bits
     esp_wifi_disconnect();
@@ -188,12 +271,14 @@ void wifi_connect_ent_async(const char* aSsid, const char *aIdent, const char *a
 
 // Disconnect from WiFi and do not attempt to reconnect.
 void wifi_disconnect() {
+    if (!wifi_is_initialised()) return;
     maxRetries = 0;
     esp_wifi_stop();
 }
 
 // Awaits WiFi to be connected for at most `max_delay_millis` milliseconds.
 bool wifi_await(uint64_t max_delay_millis) {
+    if (!wifi_is_initialised()) return false;
     if (!max_delay_millis) max_delay_millis = portMAX_DELAY;
     else max_delay_millis = pdMS_TO_TICKS(max_delay_millis);
     // Await an update from the event handler.
@@ -218,6 +303,7 @@ bool wifi_await(uint64_t max_delay_millis) {
 
 // Test whether WiFi is currently connected.
 bool wifi_is_connected() {
+    if (!wifi_is_initialised()) return false;
     // This information is stored in the event group bits.
     // Simply extract with bitwise and.
     uint32_t bits = xEventGroupGetBits(wifiEventGroup) & WIFI_CONNECTED_BIT;
@@ -260,8 +346,34 @@ static inline void wifi_desc_record(wifi_ap_record_t *record) {
     free(phy_str);
 }
 
+// Run a blocking scan, starting the WiFi station first if it isn't running.
+// Sets `started` if WiFi was started for the scan and has to be stopped when done.
+static esp_err_t wifi_scan_blocking(const wifi_scan_config_t *cfg, bool *started) {
+    esp_err_t res = esp_wifi_scan_start(cfg, true);
+    if (res != ESP_ERR_WIFI_NOT_STARTED) return res;
+    
+    // If it complains that the wifi wasn't started, then do so.
+    ESP_LOGI(TAG, "Starting WiFi for scan");
+    
+    // Set to station but don't connect.
+    res = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (res) return res;
+    
+    // Start WiFi.
+    res = esp_wifi_start();
+    if (res) return res;
+    *started = true;
+    
+    // Await the STA started bit.
+    xEventGroupWaitBits(wifiEventGroup, WIFI_STARTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(2000));
+    
+    // Try again.
+    return esp_wifi_scan_start(cfg, true);
+}
+
 // Scan for WiFi access points.
 size_t wifi_scan(wifi_ap_record_t **aps_out) {
+    wifi_init();
     isScanning = true;
     wifi_ap_record_t *aps = NULL;
     // Scan for any non-hidden APs on all channels.
@@ -275,31 +387,12 @@ size_t wifi_scan(wifi_ap_record_t **aps_out) {
     
     // Start the scan now.
     ESP_LOGI(TAG, "Starting scan...");
-    esp_err_t res = esp_wifi_scan_start(&cfg, true);
     // Whether to call esp_wifi_stop() on finish.
     bool stopWhenDone = false;
-    if (res == ESP_ERR_WIFI_NOT_STARTED) {
-        // If it complains that the wifi wasn't started, then do so.
-        ESP_LOGI(TAG, "Starting WiFi for scan");
-        
-        // Set to station but don't connect.
-        res = esp_wifi_set_mode(WIFI_MODE_STA);
-        if (res) goto ohno;
-        
-        // Start WiFi.
-        res = esp_wifi_start();
-        if (res) goto ohno;
-        stopWhenDone = true;
-        
-        // Await the STA started bit.
-        xEventGroupWaitBits(wifiEventGroup, WIFI_STARTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(2000));
-        
-        // Try again.
-        res = esp_wifi_scan_start(&cfg, true);
-    }
+    esp_err_t res = wifi_scan_blocking(&cfg, &stopWhenDone);
     if (res) {
-        ohno:
         ESP_LOGE(TAG, "Error in WiFi scan: %s", esp_err_to_name(res));
+        if (stopWhenDone) esp_wifi_stop();
         isScanning = false;
         return 0;
     }
@@ -341,6 +434,208 @@ size_t wifi_scan(wifi_ap_record_t **aps_out) {
     return 0;
 }
 
+// FNV-1a hash of an SSID.
+static uint32_t wifi_ssid_hash(const uint8_t *ssid) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < 32 && ssid[i]; i++) {
+        hash = (hash ^ ssid[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Find the hash set slot of an SSID, which is either the slot holding it or the free slot to add it in.
+static size_t wifi_scan_find_slot(const wifi_scan_list_t *list, const uint8_t *ssid) {
+    size_t slot = wifi_ssid_hash(ssid) & (WIFI_SCAN_HASH_SIZE - 1);
+    while (list->hash[slot]) {
+        const wifi_ap_record_t *record = &list->records[list->hash[slot] - 1];
+        if (!strncmp((const char*) record->ssid, (const char*) ssid, sizeof(record->ssid))) break;
+        slot = (slot + 1) & (WIFI_SCAN_HASH_SIZE - 1);
+    }
+    return slot;
+}
+
+// Insert a record into the sorted order, after the records at least as strong.
+static void wifi_scan_order_insert(wifi_scan_list_t *list, uint8_t index, size_t used) {
+    int8_t rssi = list->records[index].rssi;
+    size_t low = 0, high = used;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (list->records[list->order[mid]].rssi >= rssi) low = mid + 1;
+        else high = mid;
+    }
+    memmove(&list->order[low + 1], &list->order[low], used - low);
+    list->order[low] = index;
+}
+
+// Remove a record from the sorted order.
+static void wifi_scan_order_remove(wifi_scan_list_t *list, uint8_t index) {
+    for (size_t pos = 0; pos < list->count; pos++) {
+        if (list->order[pos] == index) {
+            memmove(&list->order[pos], &list->order[pos + 1], list->count - pos - 1);
+            return;
+        }
+    }
+}
+
+// Merge an access point into the scan results, keeping only the strongest access point per SSID.
+// Returns whether the results changed.
+static bool wifi_scan_merge(wifi_scan_list_t *list, const wifi_ap_record_t *record) {
+    // Hidden networks can't be picked by name.
+    if (!record->ssid[0]) return false;
+    
+    size_t slot = wifi_scan_find_slot(list, record->ssid);
+    if (list->hash[slot]) {
+        // Known SSID, only a stronger access point moves it up.
+        uint8_t index = list->hash[slot] - 1;
+        if (record->rssi <= list->records[index].rssi) return false;
+        wifi_scan_order_remove(list, index);
+        list->records[index] = *record;
+        wifi_scan_order_insert(list, index, list->count - 1);
+        return true;
+    }
+    
+    // New SSID.
+    if (list->count >= WIFI_SCAN_MAX_NETWORKS) return false;
+    uint8_t index = list->count;
+    list->records[index] = *record;
+    list->hash[slot] = index + 1;
+    wifi_scan_order_insert(list, index, list->count);
+    list->count++;
+    return true;
+}
+
+// Scans the channels one by one, merging the results of each channel as soon as it is done.
+static void wifi_scan_task(void *arg) {
+    // Scan the channels allowed in the configured country.
+    uint8_t firstChannel = 1, lastChannel = 13;
+    wifi_country_t country;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+        firstChannel = country.schan;
+        lastChannel = country.schan + country.nchan - 1;
+    }
+    
+    bool stopWhenDone = false;
+    for (uint8_t channel = firstChannel; channel <= lastChannel && !scanStop; channel++) {
+        wifi_scan_config_t cfg = {
+            .ssid    = NULL,
+            .bssid   = NULL,
+            .channel = channel,
+            .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+            .scan_time = { .active={ 0, 0 } },
+        };
+        esp_err_t res = wifi_scan_blocking(&cfg, &stopWhenDone);
+        if (res) {
+            if (!scanStop) ESP_LOGE(TAG, "Error in WiFi scan of channel %u: %s", channel, esp_err_to_name(res));
+            break;
+        }
+        
+        uint16_t num_ap = 0;
+        esp_wifi_scan_get_ap_num(&num_ap);
+        if (!num_ap) continue;
+        wifi_ap_record_t *aps = malloc(sizeof(wifi_ap_record_t) * num_ap);
+        if (!aps) {
+            ESP_LOGE(TAG, "Out of memory (%zd bytes)", sizeof(wifi_ap_record_t) * num_ap);
+            num_ap = 0;
+            esp_wifi_scan_get_ap_records(&num_ap, NULL);
+            continue;
+        }
+        if (esp_wifi_scan_get_ap_records(&num_ap, aps) == ESP_OK) {
+            xSemaphoreTake(scanMutex, portMAX_DELAY);
+            bool changed = false;
+            for (uint16_t i = 0; i < num_ap; i++) {
+                wifi_desc_record(&aps[i]);
+                changed |= wifi_scan_merge(scanList, &aps[i]);
+            }
+            if (changed) scanList->generation++;
+            xSemaphoreGive(scanMutex);
+        }
+        free(aps);
+    }
+    
+    if (stopWhenDone) {
+        // Stop WiFi because it was started only for this scan.
+        esp_wifi_stop();
+    }
+    isScanning = false;
+    xSemaphoreGive(scanFinished);
+    scanRunning = false;
+    vTaskDelete(NULL);
+}
+
+// Start scanning for WiFi networks in the background, one channel at a time.
+bool wifi_scan_async_start() {
+    wifi_init();
+    if (scanRunning) return false;
+    wifi_scan_async_stop();
+    // Forget the completion of a previous scan that was never stopped.
+    xSemaphoreTake(scanFinished, 0);
+    
+    wifi_scan_list_t *list = calloc(1, sizeof(wifi_scan_list_t));
+    if (!list) {
+        ESP_LOGE(TAG, "Out of memory (%zd bytes)", sizeof(wifi_scan_list_t));
+        return false;
+    }
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    scanList = list;
+    xSemaphoreGive(scanMutex);
+    
+    ESP_LOGI(TAG, "Starting asynchronous scan...");
+    isScanning = true;
+    scanStop = false;
+    scanRunning = true;
+    if (xTaskCreate(wifi_scan_task, "wifi_scan", 4096, NULL, tskIDLE_PRIORITY + 2, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the scan task");
+        isScanning = false;
+        scanRunning = false;
+        return false;
+    }
+    return true;
+}
+
+// Test whether the asynchronous scan is still running.
+bool wifi_scan_async_busy() {
+    return scanRunning;
+}
+
+// Get the amount of changes to the asynchronous scan results.
+uint32_t wifi_scan_async_generation() {
+    if (!wifi_is_initialised()) return 0;
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    uint32_t generation = scanList ? scanList->generation : 0;
+    xSemaphoreGive(scanMutex);
+    return generation;
+}
+
+// Copy the networks found by the asynchronous scan so far, strongest first.
+size_t wifi_scan_async_get(wifi_ap_record_t *aps, size_t max) {
+    if (!wifi_is_initialised()) return 0;
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    size_t count = 0;
+    if (scanList) {
+        count = scanList->count < max ? scanList->count : max;
+        for (size_t i = 0; i < count; i++) {
+            aps[i] = scanList->records[scanList->order[i]];
+        }
+    }
+    xSemaphoreGive(scanMutex);
+    return count;
+}
+
+// Stop the asynchronous scan, waiting for it to finish, and release the results.
+void wifi_scan_async_stop() {
+    if (!wifi_is_initialised()) return;
+    if (scanRunning) {
+        scanStop = true;
+        // Abort the channel being scanned.
+        esp_wifi_scan_stop();
+        xSemaphoreTake(scanFinished, portMAX_DELAY);
+    }
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    free(scanList);
+    scanList = NULL;
+    xSemaphoreGive(scanMutex);
+}
+
 // Get the strength value for a given RSSI.
 wifi_strength_t wifi_rssi_to_strength(int8_t rssi) {
     if (rssi > WIFI_THRESH_VERY_GOOD) return WIFI_STRENGTH_VERY_GOOD;
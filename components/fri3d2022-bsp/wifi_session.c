@@ -0,0 +1,184 @@
+#include "wifi_session.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "wifi_connect.h"
+#include "wifi_connection.h"
+
+static const char* TAG = "wifi_session";
+
+#define WIFI_SESSION_TASK_STACK 4096
+
+static portMUX_TYPE       session_init_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t  session_lock      = NULL;  // Held while connecting and while changing the amount of users
+static esp_timer_handle_t grace_timer       = NULL;
+static int                session_users     = 0;
+static int                session_transfers = 0;
+static portMUX_TYPE       transfer_lock     = portMUX_INITIALIZER_UNLOCKED;
+
+// Read the access point that the stored network was found on last time, returns false if it is not known.
+static bool load_fast_connect(uint8_t* bssid, uint8_t* channel) {
+    nvs_handle_t handle;
+    if (nvs_open("system", NVS_READONLY, &handle) != ESP_OK) return false;
+    char   ssid[33]      = {0};
+    char   fast_ssid[33] = {0};
+    size_t length        = sizeof(ssid);
+    size_t fast_length   = sizeof(fast_ssid);
+    size_t bssid_length  = 6;
+    bool   found         = (nvs_get_str(handle, "wifi.ssid", ssid, &length) == ESP_OK);
+    found                = found && (nvs_get_str(handle, "wifi.fast.ssid", fast_ssid, &fast_length) == ESP_OK);
+    found                = found && (nvs_get_blob(handle, "wifi.fast.bssid", bssid, &bssid_length) == ESP_OK) && (bssid_length == 6);
+    found                = found && (nvs_get_u8(handle, "wifi.fast.chan", channel) == ESP_OK);
+    nvs_close(handle);
+    return found && (strcmp(ssid, fast_ssid) == 0);  // Only valid for the network it was recorded for
+}
+
+static void store_fast_connect(const wifi_ap_record_t* ap) {
+    uint8_t bssid[6];
+    uint8_t channel;
+    if (load_fast_connect(bssid, &channel) && (memcmp(bssid, ap->bssid, 6) == 0) && (channel == ap->primary)) return;  // Unchanged, save a flash write
+    nvs_handle_t handle;
+    if (nvs_open("system", NVS_READWRITE, &handle) != ESP_OK) return;
+    nvs_set_str(handle, "wifi.fast.ssid", (const char*) ap->ssid);
+    nvs_set_blob(handle, "wifi.fast.bssid", ap->bssid, 6);
+    nvs_set_u8(handle, "wifi.fast.chan", ap->primary);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void clear_fast_connect() {
+    nvs_handle_t handle;
+    if (nvs_open("system", NVS_READWRITE, &handle) != ESP_OK) return;
+    nvs_erase_key(handle, "wifi.fast.bssid");
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static bool session_connect() {
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool    connected = false;
+    if (load_fast_connect(bssid, &channel)) {
+        ESP_LOGI(TAG, "Connecting to the cached access point on channel %u", channel);
+        wifi_set_connect_hint(bssid, channel);
+        connected = wifi_connect_to_stored();
+        if (!connected) {
+            ESP_LOGW(TAG, "Cached access point not found, scanning");
+            clear_fast_connect();
+        }
+    }
+    if (!connected) connected = wifi_connect_to_stored();
+    if (!connected) {
+        wifi_disconnect_and_disable();
+        return false;
+    }
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) store_fast_connect(&ap);
+    esp_wifi_set_ps((session_transfers > 0) ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM);
+    return true;
+}
+
+static void grace_task(void* arg) {
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    // A user may have come and gone while this task waited for the lock, then a new grace period is running
+    if ((session_users == 0) && (!esp_timer_is_active(grace_timer))) {
+        ESP_LOGI(TAG, "No users left, disabling WiFi");
+        wifi_disconnect_and_disable();
+    }
+    xSemaphoreGive(session_lock);
+    vTaskDelete(NULL);
+}
+
+static void grace_expired(void* arg) {
+    // Runs on the timer task, which must not block on a connection attempt or on stopping WiFi, a task does that instead
+    if (xTaskCreate(grace_task, "wifi_session", WIFI_SESSION_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to start the task that disables WiFi, trying again later");
+        esp_timer_start_once(grace_timer, WIFI_SESSION_GRACE_MS * 1000ULL);
+    }
+}
+
+static bool session_init() {
+    portENTER_CRITICAL(&session_init_lock);
+    bool initialized = (session_lock != NULL);
+    portEXIT_CRITICAL(&session_init_lock);
+    if (initialized) return true;
+
+    const esp_timer_create_args_t timer_args = {.callback = grace_expired, .name = "wifi_session"};
+    esp_timer_handle_t            timer      = NULL;
+    SemaphoreHandle_t             lock       = xSemaphoreCreateMutex();
+    if ((lock == NULL) || (esp_timer_create(&timer_args, &timer) != ESP_OK)) {
+        if (lock != NULL) vSemaphoreDelete(lock);
+        return false;
+    }
+
+    portENTER_CRITICAL(&session_init_lock);
+    bool lost = (session_lock != NULL);  // Another task initialized the session at the same time
+    if (!lost) {
+        grace_timer  = timer;
+        session_lock = lock;
+    }
+    portEXIT_CRITICAL(&session_init_lock);
+    if (lost) {
+        esp_timer_delete(timer);
+        vSemaphoreDelete(lock);
+    }
+    return true;
+}
+
+static bool session_acquire(bool fresh) {
+    if (!session_init()) return false;
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    esp_timer_stop(grace_timer);
+    bool connected = wifi_is_connected();
+    if (connected && fresh && (session_users == 0)) {
+        ESP_LOGI(TAG, "Dropping the idle WiFi connection to connect again");
+        wifi_disconnect_and_disable();
+        connected = false;
+    }
+    if (connected) {
+        ESP_LOGI(TAG, "Reusing the WiFi connection (%d users)", session_users);
+    } else {
+        connected = session_connect();
+    }
+    if (connected) session_users++;
+    xSemaphoreGive(session_lock);
+    return connected;
+}
+
+bool wifi_session_acquire() { return session_acquire(false); }
+
+bool wifi_session_acquire_fresh() { return session_acquire(true); }
+
+void wifi_session_release() {
+    if (session_lock == NULL) return;
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    if (session_users > 0) session_users--;
+    if (session_users == 0) {
+        esp_timer_stop(grace_timer);
+        esp_timer_start_once(grace_timer, WIFI_SESSION_GRACE_MS * 1000ULL);
+    }
+    xSemaphoreGive(session_lock);
+}
+
+void wifi_session_transfer_begin() {
+    portENTER_CRITICAL(&transfer_lock);
+    bool first = (session_transfers++ == 0);
+    portEXIT_CRITICAL(&transfer_lock);
+    // Power save adds up to a beacon interval of latency to every packet, which slows down downloads a lot
+    if (first) esp_wifi_set_ps(WIFI_PS_NONE);
+}
+
+void wifi_session_transfer_end() {
+    portENTER_CRITICAL(&transfer_lock);
+    bool last = (session_transfers > 0) && (--session_transfers == 0);
+    portEXIT_CRITICAL(&transfer_lock);
+    if (last) esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+}
@@ -77,12 +77,14 @@ bool keyboard(float aPosX, float aPosY, float aWidth, float aHeight, const char*
     bool running = true;
     while (running) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             bool    value = button_message.state;
             switch (button_message.input) {
                 case INPUT_TOUCH1:
                     if (value) {
-                        pkb_press(&kb_ctx, PKB_RIGHT);
+                        for (uint16_t step = 0; step < button_message.count; step++) {
+                            pkb_press(&kb_ctx, PKB_RIGHT);
+                        }
                     } else {
                         pkb_release(&kb_ctx, PKB_RIGHT);
                     }
@@ -58,6 +58,7 @@ bool       menu_remove_item(menu_t* menu, size_t position);
 bool       menu_navigate_to(menu_t* menu, size_t position);
 void       menu_navigate_previous(menu_t* menu);
 void       menu_navigate_next(menu_t* menu);
+void       menu_navigate_next_steps(menu_t* menu, size_t steps);
 void       menu_navigate_previous_row(menu_t* menu);
 void       menu_navigate_next_row(menu_t* menu);
 size_t     menu_get_position(menu_t* menu);
@@ -188,6 +188,12 @@ void menu_navigate_next(menu_t* menu) {
     menu->position = (menu->position + 1) % menu->length;
 }
 
+void menu_navigate_next_steps(menu_t* menu, size_t steps) {
+    if (menu == NULL) return;
+    if (menu->length < 1) return;
+    menu->position = (menu->position + steps) % menu->length;
+}
+
 void menu_navigate_previous_row(menu_t* menu) {
     for (size_t index = 0; index < menu->grid_entry_count_x; index++) {
         menu_navigate_previous(menu);
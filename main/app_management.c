@@ -5,17 +5,23 @@
 #include <freertos/queue.h>
 #include <freertos/task.h>
 #include <sdkconfig.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#include "app_management.h"
+#include "app_manifest.h"
+#include "appfs_patch.h"
 #include "appfs_wrapper.h"
 #include "bootscreen.h"
 #include "cJSON.h"
+#include "download_scheduler.h"
 #include "filesystems.h"
 #include "graphics_wrapper.h"
 #include "hardware.h"
 #include "http_download.h"
+#include "install_journal.h"
 #include "menu.h"
 #include "metadata.h"
 #include "pax_codecs.h"
@@ -39,31 +45,176 @@ bool create_dir(const char* path) {
     return mkdir(path, 0777) == 0;
 }
 
+typedef struct {
+    const char*           name;
+    size_t                files_shown;
+    int                   percent_shown;
+    install_status_cb_t   status;
+    void*                 user;
+    const download_job_t* jobs;
+    cJSON**               job_files;  // Entry in the app info of each job
+    uint8_t (*hashes)[APP_MANIFEST_HASH_SIZE];  // Hash of each downloaded file
+    install_journal_t*    journal;
+} install_progress_t;
+
+static void free_download_jobs(download_job_t* jobs, size_t count) {
+    for (size_t index = 0; index < count; index++) {
+        free((char*) jobs[index].path);
+    }
+    free(jobs);
+}
+
+static void install_progress(size_t files_done, size_t files_total, size_t bytes_done, size_t bytes_total, void* user) {
+    install_progress_t* progress = (install_progress_t*) user;
+    int                 percent  = (bytes_total > 0) ? ((bytes_done * 100) / bytes_total) : ((files_done * 100) / files_total);
+    if (percent > 100) percent = 100;
+    if ((files_done == progress->files_shown) && (percent == progress->percent_shown)) return;
+    progress->files_shown   = files_done;
+    progress->percent_shown = percent;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "Installing %s:\nDownloaded %u of %u files (%d%%)", progress->name, files_done, files_total, percent);
+    progress->status(buffer, percent, progress->user);
+}
+
+// Hash and verify a downloaded file while the other files are still downloading, and record it in the journal
+static bool install_file_done(size_t index, void* user) {
+    install_progress_t* progress   = (install_progress_t*) user;
+    const char*         path       = progress->jobs[index].path;
+    cJSON*              name_obj   = cJSON_GetObjectItem(progress->job_files[index], "name");
+    cJSON*              sha256_obj = cJSON_GetObjectItem(progress->job_files[index], "sha256");
+    uint8_t             published[APP_MANIFEST_HASH_SIZE];
+    if (!sha256_file(path, progress->hashes[index])) return false;
+    if (cJSON_IsString(sha256_obj) && sha256_parse(sha256_obj->valuestring, published) &&
+        (memcmp(progress->hashes[index], published, APP_MANIFEST_HASH_SIZE) != 0)) {
+        ESP_LOGE(TAG, "Hash of %s does not match the app info", path);
+        remove(path);
+        return false;
+    }
+    install_journal_file(progress->journal, name_obj->valuestring, progress->hashes[index]);
+    return true;
+}
+
+typedef struct {
+    appfs_sink_t           sink;
+    bool                   started;
+    const char*            name;
+    const char*            title;
+    uint16_t               version;
+    size_t                 size_hint;  // Size from the app info, used when the server does not send a content-length header
+    const char*            copy_path;
+    mbedtls_sha256_context sha256;  // Hash of the received data
+} appfs_download_t;
+
+static bool appfs_receive(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    appfs_download_t* download = (appfs_download_t*) user;
+    if (offset == 0) {
+        if (download->started) appfs_sink_abort(&download->sink);  // Download is being retried
+        download->started = false;
+        size_t size       = (total > 0) ? total : download->size_hint;
+        if (appfs_sink_begin(&download->sink, download->name, download->title, download->version, size, download->copy_path) != ESP_OK) return false;
+        download->started = true;
+        mbedtls_sha256_starts_ret(&download->sha256, 0);
+    }
+    mbedtls_sha256_update_ret(&download->sha256, data, length);
+    return appfs_sink_write(&download->sink, data, length) == ESP_OK;
+}
+
+typedef struct {
+    appfs_patch_t patch;
+    bool          started;
+    esp_err_t     error;  // Reason the patch could not be applied
+} appfs_patch_download_t;
+
+static bool patch_receive(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    appfs_patch_download_t* download = (appfs_patch_download_t*) user;
+    if ((offset == 0) && download->started) {
+        // Download is being retried from the start, appfs_patch_begin clears the patch so its arguments are copied first
+        appfs_patch_t patch = download->patch;
+        appfs_patch_abort(&download->patch);
+        download->error = appfs_patch_begin(&download->patch, patch.name, patch.title, patch.version, patch.copy_path);
+        if (download->error != ESP_OK) return false;
+    }
+    download->started = true;
+    download->error   = appfs_patch_write(&download->patch, data, length);
+    return download->error == ESP_OK;
+}
+
+// Update the binary in AppFS with a patch against the installed version, if the app info offers one:
+// "patches": [{"from": "<SHA-256 of the installed binary>", "url": "...", "size": 1234}]
+static bool install_binary_patch(cJSON* file_obj, const app_manifest_t* manifest, const char* name, const char* slug, uint16_t version, const char* copy_path,
+                                 install_journal_t* journal, uint8_t* hash) {
+    const uint8_t* installed   = app_manifest_find(manifest, name);
+    cJSON*         patches_obj = cJSON_GetObjectItem(file_obj, "patches");
+    if ((installed == NULL) || (!cJSON_IsArray(patches_obj)) || (!appfsExists(slug))) return false;
+
+    cJSON* patch_obj;
+    cJSON_ArrayForEach(patch_obj, patches_obj) {
+        cJSON*  from_obj = cJSON_GetObjectItem(patch_obj, "from");
+        cJSON*  url_obj  = cJSON_GetObjectItem(patch_obj, "url");
+        uint8_t from[APP_MANIFEST_HASH_SIZE];
+        if ((!cJSON_IsString(from_obj)) || (!cJSON_IsString(url_obj)) || (!sha256_parse(from_obj->valuestring, from))) continue;
+        if (memcmp(from, installed, APP_MANIFEST_HASH_SIZE) != 0) continue;
+
+        appfs_patch_download_t download = {0};
+        if (appfs_patch_begin(&download.patch, slug, name, version, copy_path) != ESP_OK) return false;
+        install_journal_appfs(journal, download.patch.temp_name, false);  // The installed entry stays intact until the patched entry replaces it
+        bool success = download_stream(url_obj->valuestring, patch_receive, &download);
+        if (success) {
+            memcpy(hash, download.patch.expected, APP_MANIFEST_HASH_SIZE);
+            success = (appfs_patch_finish(&download.patch) == ESP_OK);
+            if (success) install_journal_appfs(journal, download.patch.temp_name, true);
+        } else {
+            ESP_LOGW(TAG, "Failed to apply patch %s (%d)", url_obj->valuestring, download.error);
+            appfs_patch_abort(&download.patch);
+        }
+        return success;
+    }
+    return false;
+}
+
+// A file is unchanged if the hash recorded when it was installed matches the hash published in the app info
+static bool file_unchanged(const app_manifest_t* manifest, const char* name, const uint8_t* published, const char* path, size_t size) {
+    const uint8_t* installed = app_manifest_find(manifest, name);
+    if ((published == NULL) || (installed == NULL) || (memcmp(installed, published, APP_MANIFEST_HASH_SIZE) != 0)) return false;
+    struct stat st;
+    return (stat(path, &st) == 0) && ((size_t) st.st_size == size);  // Still there, and not replaced by hand
+}
+
+static void show_install_status(const char* message, int percent, void* user) {
+    render_message((char*) message);
+    display_flush();
+}
+
 bool install_app(bool wait, const char* type_slug, bool to_sd_card, char* data_app_info, size_t size_app_info, cJSON* json_app_info) {
+    bool result = install_app_status(type_slug, to_sd_card, data_app_info, size_app_info, json_app_info, show_install_status, NULL);
+    if (wait) wait_for_button();
+    return result;
+}
+
+bool install_app_status(const char* type_slug, bool to_sd_card, char* data_app_info, size_t size_app_info, cJSON* json_app_info, install_status_cb_t status,
+                        void* user) {
     cJSON* slug_obj = cJSON_GetObjectItem(json_app_info, "slug");
     cJSON* name_obj = cJSON_GetObjectItem(json_app_info, "name");
     // cJSON* author_obj      = cJSON_GetObjectItem(json_app_info, "author");
     // cJSON* license_obj     = cJSON_GetObjectItem(json_app_info, "license");
     // cJSON* description_obj = cJSON_GetObjectItem(json_app_info, "description");
-    cJSON* version_obj = cJSON_GetObjectItem(json_app_info, "version");
-    cJSON* files_obj   = cJSON_GetObjectItem(json_app_info, "files");
+    cJSON* version_obj  = cJSON_GetObjectItem(json_app_info, "version");
+    cJSON* files_obj    = cJSON_GetObjectItem(json_app_info, "files");
+    cJSON* category_obj = cJSON_GetObjectItem(json_app_info, "category");
 
     char buffer[257];
     buffer[sizeof(buffer) - 1] = '\0';
 
     // Create folders
     snprintf(buffer, sizeof(buffer) - 1, "Installing %s:\nCreating folders...", name_obj->valuestring);
-    render_message(buffer);
-    display_flush();
+    status(buffer, -1, user);
 
     snprintf(buffer, sizeof(buffer) - 1, "%s/apps", to_sd_card ? sdcard_path : internal_path);
     printf("Creating dir: %s\r\n", buffer);
     if (!create_dir(buffer)) {
         // Failed to create app directory
         ESP_LOGI(TAG, "Failed to create %s", buffer);
-        render_message("Failed create folder");
-        display_flush();
-        if (wait) wait_for_button();
+        status("Failed create folder", -1, user);
         return false;
     }
 
@@ -72,9 +223,7 @@ bool install_app(bool wait, const char* type_slug, bool to_sd_card, char* data_a
     if (!create_dir(buffer)) {
         // failed to create app type directory
         ESP_LOGI(TAG, "Failed to create %s", buffer);
-        render_message("Failed create folder");
-        display_flush();
-        if (wait) wait_for_button();
+        status("Failed create folder", -1, user);
         return false;
     }
 
@@ -83,96 +232,198 @@ bool install_app(bool wait, const char* type_slug, bool to_sd_card, char* data_a
     if (!create_dir(buffer)) {
         // failed to create app directory
         ESP_LOGI(TAG, "Failed to create %s", buffer);
-        render_message("Failed create folder");
-        display_flush();
-        if (wait) wait_for_button();
+        status("Failed create folder", -1, user);
         return false;
     }
 
+    // The manifest records the hashes of the installed files, unchanged files are not downloaded again
+    char app_path[128];
+    snprintf(app_path, sizeof(app_path), "%s/apps/%s/%s", to_sd_card ? sdcard_path : internal_path, type_slug, slug_obj->valuestring);
+    app_manifest_t old_manifest = {0};
+    app_manifest_t new_manifest = {0};
+    app_manifest_load(app_path, &old_manifest);
+    install_journal_load(app_path, &old_manifest);  // Files completed by an install that was interrupted
+
+    // The journal takes over from the manifest while files are being replaced, it lists the files that are known to be complete
+    install_journal_t journal = {0};
+    if (!install_journal_begin(&journal, app_path, type_slug, cJSON_IsString(category_obj) ? category_obj->valuestring : NULL, slug_obj->valuestring,
+                               to_sd_card)) {
+        app_manifest_free(&old_manifest);
+        status("Failed to write the install journal", -1, user);
+        return false;
+    }
+    if (!install_journal_manifest(&journal, &old_manifest)) {
+        // The manifest is kept, so the installed files are still known when the app is installed again
+        app_manifest_free(&old_manifest);
+        install_journal_close(&journal);
+        status("Failed to write the install journal", -1, user);
+        return false;
+    }
+    snprintf(buffer, sizeof(buffer) - 1, "%s/%s", app_path, APP_MANIFEST_FN);
+    remove(buffer);  // Files are about to be replaced, an interrupted install must not leave their old hashes behind
+
     // Download files
+    size_t          job_count = 0;
+    download_job_t* jobs      = calloc(cJSON_GetArraySize(files_obj) + 1, sizeof(download_job_t));
+    cJSON**         job_files = calloc(cJSON_GetArraySize(files_obj) + 1, sizeof(cJSON*));
+    if ((jobs == NULL) || (job_files == NULL)) {
+        free(jobs);
+        free(job_files);
+        app_manifest_free(&old_manifest);
+        install_journal_close(&journal);
+        status("Out of memory", -1, user);
+        return false;
+    }
+
+    bool   success = true;
     cJSON* file_obj;
     cJSON_ArrayForEach(file_obj, files_obj) {
-        cJSON* name_obj = cJSON_GetObjectItem(file_obj, "name");
-        cJSON* url_obj  = cJSON_GetObjectItem(file_obj, "url");
-        // cJSON* size_obj = cJSON_GetObjectItem(file_obj, "size");
-        if ((strcmp(type_slug, esp32_type) == 0) && (strcmp(name_obj->valuestring, esp32_bin_fn) == 0)) {
+        cJSON*   name_obj   = cJSON_GetObjectItem(file_obj, "name");
+        cJSON*   url_obj    = cJSON_GetObjectItem(file_obj, "url");
+        cJSON*   size_obj   = cJSON_GetObjectItem(file_obj, "size");
+        cJSON*   sha256_obj = cJSON_GetObjectItem(file_obj, "sha256");
+        uint8_t  published_hash[APP_MANIFEST_HASH_SIZE];
+        uint8_t* published = (cJSON_IsString(sha256_obj) && sha256_parse(sha256_obj->valuestring, published_hash)) ? published_hash : NULL;
+        size_t   size      = (size_obj != NULL) ? size_obj->valueint : 0;
+        bool     is_binary = (strcmp(type_slug, esp32_type) == 0) && (strcmp(name_obj->valuestring, esp32_bin_fn) == 0);
+        snprintf(buffer, sizeof(buffer) - 1, "%s/%s", app_path, name_obj->valuestring);
+
+        bool unchanged = false;
+        if (is_binary) {
+            // The binary is installed in AppFS, the copy on the SD card is optional
+            unchanged = (published != NULL) && appfsExists(slug_obj->valuestring) && (app_manifest_find(&old_manifest, name_obj->valuestring) != NULL) &&
+                        (memcmp(app_manifest_find(&old_manifest, name_obj->valuestring), published, APP_MANIFEST_HASH_SIZE) == 0);
+        } else {
+            unchanged = file_unchanged(&old_manifest, name_obj->valuestring, published, buffer, size);
+        }
+        if (unchanged) {
+            ESP_LOGI(TAG, "%s is unchanged", name_obj->valuestring);
+            success = app_manifest_set(&new_manifest, name_obj->valuestring, published);
+            if (!success) break;
+            continue;
+        }
+
+        if (is_binary) {
             snprintf(buffer, sizeof(buffer) - 1, "Installing %s:\nDownloading '%s' to AppFS", name_obj->valuestring, name_obj->valuestring);
-            render_message(buffer);
-            display_flush();
-            snprintf(buffer, sizeof(buffer) - 1, "%s/apps/%s/%s/%s", to_sd_card ? sdcard_path : internal_path, type_slug, slug_obj->valuestring,
-                     name_obj->valuestring);
-            uint8_t* esp32_binary_data;
-            size_t   esp32_binary_size;
-            bool     success = download_ram(url_obj->valuestring, (uint8_t**) &esp32_binary_data, &esp32_binary_size);
+            status(buffer, -1, user);
+            snprintf(buffer, sizeof(buffer) - 1, "%s/%s", app_path, name_obj->valuestring);
+
+            uint8_t hash[APP_MANIFEST_HASH_SIZE];
+            if (install_binary_patch(file_obj, &old_manifest, name_obj->valuestring, slug_obj->valuestring, version_obj->valueint, to_sd_card ? buffer : NULL,
+                                     &journal, hash)) {
+                ESP_LOGI(TAG, "%s updated with a patch", name_obj->valuestring);
+                success = app_manifest_set(&new_manifest, name_obj->valuestring, hash);
+                if (!success) break;
+                continue;
+            }
+
+            appfs_download_t download = {
+                .name      = slug_obj->valuestring,
+                .title     = name_obj->valuestring,
+                .version   = version_obj->valueint,
+                .size_hint = size,
+                .copy_path = to_sd_card ? buffer : NULL,
+            };
+            mbedtls_sha256_init(&download.sha256);
+            install_journal_appfs(&journal, slug_obj->valuestring, false);  // The installed entry is replaced as soon as data arrives
+            success = download_stream(url_obj->valuestring, appfs_receive, &download);
+            mbedtls_sha256_finish_ret(&download.sha256, hash);
+            mbedtls_sha256_free(&download.sha256);
+            if (success && download.started && (published != NULL) && (memcmp(hash, published, APP_MANIFEST_HASH_SIZE) != 0)) {
+                ESP_LOGE(TAG, "Hash of %s does not match the app info", url_obj->valuestring);
+                success = false;
+            }
+            if (success && download.started) {  // Ignore 0 bytes files
+                success = (appfs_sink_finish(&download.sink) == ESP_OK);
+            } else if (download.started) {
+                appfs_sink_abort(&download.sink);
+            }
+            if (success && download.started) {
+                install_journal_appfs(&journal, slug_obj->valuestring, true);
+                install_journal_file(&journal, name_obj->valuestring, hash);
+                success = app_manifest_set(&new_manifest, name_obj->valuestring, hash);
+            }
             if (!success) {
-                ESP_LOGI(TAG, "Failed to download %s to RAM", url_obj->valuestring);
-                render_message("Failed to download file");
-                display_flush();
-                if (wait) wait_for_button();
+                ESP_LOGI(TAG, "Failed to install %s to AppFS", url_obj->valuestring);
+                status("Failed to install app to AppFS", -1, user);
+                free_download_jobs(jobs, job_count);
+                free(job_files);
+                app_manifest_free(&old_manifest);
+                app_manifest_free(&new_manifest);
+                install_journal_close(&journal);
                 return false;
             }
-            if (esp32_binary_data != NULL) {  // Ignore 0 bytes files
-                esp_err_t res = appfs_store_in_memory_app(true, slug_obj->valuestring, name_obj->valuestring, version_obj->valueint, esp32_binary_size,
-                                                          esp32_binary_data);
-                if (res != ESP_OK) {
-                    free(esp32_binary_data);
-                    ESP_LOGI(TAG, "Failed to store ESP32 binary");
-                    render_message("Failed to install app to AppFS");
-                    display_flush();
-                    if (wait) wait_for_button();
-                    return false;
-                }
-                if (to_sd_card) {
-                    render_message("Storing a copy of the ESP32\nbinary to the SD card...");
-                    display_flush();
-                    printf("Creating file: %s\r\n", buffer);
-                    FILE* binary_fd = fopen(buffer, "w");
-                    if (binary_fd == NULL) {
-                        free(esp32_binary_data);
-                        ESP_LOGI(TAG, "Failed to install ESP32 binary to %s", buffer);
-                        render_message("Failed to install app to SD card");
-                        display_flush();
-                        if (wait) wait_for_button();
-                        return false;
-                    }
-                    fwrite(esp32_binary_data, 1, esp32_binary_size, binary_fd);
-                    fclose(binary_fd);
-                }
-                free(esp32_binary_data);
-            }
         } else {
-            snprintf(buffer, sizeof(buffer) - 1, "Installing %s:\nDownloading '%s'...", name_obj->valuestring, name_obj->valuestring);
-            render_message(buffer);
-            display_flush();
-            snprintf(buffer, sizeof(buffer) - 1, "%s/apps/%s/%s/%s", to_sd_card ? sdcard_path : internal_path, type_slug, slug_obj->valuestring,
-                     name_obj->valuestring);
-            printf("Downloading file: %s\r\n", buffer);
-            if (!download_file(url_obj->valuestring, buffer)) {
-                ESP_LOGI(TAG, "Failed to download %s to %s", url_obj->valuestring, buffer);
-                render_message("Failed to download file");
-                display_flush();
-                if (wait) wait_for_button();
-                return false;
+            // Other files are downloaded concurrently below
+            download_job_t* job  = &jobs[job_count];
+            job->url             = url_obj->valuestring;
+            job->path            = strdup(buffer);
+            job->size            = size;
+            job_files[job_count] = file_obj;
+            if (job->path == NULL) {
+                success = false;
+                break;
             }
+            job_count++;
         }
     }
 
+    if (!success) {
+        free_download_jobs(jobs, job_count);
+        free(job_files);
+        app_manifest_free(&old_manifest);
+        app_manifest_free(&new_manifest);
+        install_journal_close(&journal);
+        status("Out of memory", -1, user);
+        return false;
+    }
+
+    printf("Downloading %u files\r\n", job_count);
+    uint8_t(*hashes)[APP_MANIFEST_HASH_SIZE] = calloc(job_count + 1, APP_MANIFEST_HASH_SIZE);
+    install_progress_t progress_args         = {.name = name_obj->valuestring, .files_shown = SIZE_MAX, .percent_shown = -1, .status = status, .user = user};
+    progress_args.jobs                       = jobs;
+    progress_args.job_files                  = job_files;
+    progress_args.hashes                     = hashes;
+    progress_args.journal                    = &journal;
+    success                                  = (hashes != NULL) && download_files(jobs, job_count, install_progress, install_file_done, &progress_args);
+
+    // The downloaded files have been verified by install_file_done
+    for (size_t index = 0; success && (index < job_count); index++) {
+        cJSON* name_obj = cJSON_GetObjectItem(job_files[index], "name");
+        success         = app_manifest_set(&new_manifest, name_obj->valuestring, hashes[index]);
+    }
+    free(hashes);
+
+    free_download_jobs(jobs, job_count);
+    free(job_files);
+    app_manifest_free(&old_manifest);
+    if (!success) {
+        app_manifest_free(&new_manifest);
+        install_journal_close(&journal);
+        ESP_LOGI(TAG, "Failed to download the files of %s", slug_obj->valuestring);
+        status("Failed to download file", -1, user);
+        return false;
+    }
+
     // Install metadata.json
     snprintf(buffer, sizeof(buffer) - 1, "%s/apps/%s/%s/%s", to_sd_card ? sdcard_path : internal_path, type_slug, slug_obj->valuestring, metadata_json_fn);
     FILE* metadata_fd = fopen(buffer, "w");
     if (metadata_fd == NULL) {
+        app_manifest_free(&new_manifest);
+        install_journal_close(&journal);
         ESP_LOGI(TAG, "Failed to install metadata to %s", buffer);
-        render_message("Failed to install metadata");
-        display_flush();
-        if (wait) wait_for_button();
+        status("Failed to install metadata", -1, user);
         return false;
     }
     fwrite(data_app_info, 1, size_app_info, metadata_fd);
     fclose(metadata_fd);
 
+    // Written after the files, a file listed in the manifest is known to be complete
+    app_manifest_save(app_path, &new_manifest);
+    app_manifest_free(&new_manifest);
+    install_journal_finish(&journal, app_path);
+
     ESP_LOGI(TAG, "App installed!");
-    render_message("App has been installed!");
-    display_flush();
-    if (wait) wait_for_button();
+    status("App has been installed!", -1, user);
     return true;
 }
@@ -0,0 +1,126 @@
+#include "app_manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+static const char* TAG = "App manifest";
+
+#define SHA256_FILE_CHUNK 4096
+
+static int hex_digit(char c) {
+    if ((c >= '0') && (c <= '9')) return c - '0';
+    if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    return -1;
+}
+
+bool sha256_parse(const char* hex, uint8_t* sha256) {
+    if ((hex == NULL) || (strlen(hex) < APP_MANIFEST_HASH_SIZE * 2)) return false;
+    for (size_t index = 0; index < APP_MANIFEST_HASH_SIZE; index++) {
+        int high = hex_digit(hex[index * 2]);
+        int low  = hex_digit(hex[index * 2 + 1]);
+        if ((high < 0) || (low < 0)) return false;
+        sha256[index] = (high << 4) | low;
+    }
+    return true;
+}
+
+bool sha256_file(const char* path, uint8_t* sha256) {
+    FILE* fd = fopen(path, "rb");
+    if (fd == NULL) return false;
+    uint8_t* buffer = malloc(SHA256_FILE_CHUNK);
+    if (buffer == NULL) {
+        fclose(fd);
+        return false;
+    }
+    mbedtls_sha256_context context;
+    mbedtls_sha256_init(&context);
+    mbedtls_sha256_starts_ret(&context, 0);
+    size_t length;
+    while ((length = fread(buffer, 1, SHA256_FILE_CHUNK, fd)) > 0) {
+        mbedtls_sha256_update_ret(&context, buffer, length);
+    }
+    bool success = (ferror(fd) == 0);
+    mbedtls_sha256_finish_ret(&context, sha256);
+    mbedtls_sha256_free(&context);
+    free(buffer);
+    fclose(fd);
+    return success;
+}
+
+bool app_manifest_load(const char* app_path, app_manifest_t* manifest) {
+    manifest->entries = NULL;
+    manifest->count   = 0;
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", app_path, APP_MANIFEST_FN);
+    FILE* fd = fopen(path, "r");
+    if (fd == NULL) return true;  // Installed before manifests existed, or a new install
+
+    char line[192];
+    while (fgets(line, sizeof(line), fd) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        uint8_t sha256[APP_MANIFEST_HASH_SIZE];
+        // sha256sum format: hash, two spaces, file name
+        if ((strlen(line) < APP_MANIFEST_HASH_SIZE * 2 + 3) || (!sha256_parse(line, sha256))) continue;
+        if (!app_manifest_set(manifest, &line[APP_MANIFEST_HASH_SIZE * 2 + 2], sha256)) {
+            fclose(fd);
+            app_manifest_free(manifest);
+            return false;
+        }
+    }
+    fclose(fd);
+    return true;
+}
+
+bool app_manifest_save(const char* app_path, const app_manifest_t* manifest) {
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", app_path, APP_MANIFEST_FN);
+    FILE* fd = fopen(path, "w");
+    if (fd == NULL) {
+        ESP_LOGE(TAG, "Failed to write %s", path);
+        return false;
+    }
+    for (size_t index = 0; index < manifest->count; index++) {
+        for (size_t byte = 0; byte < APP_MANIFEST_HASH_SIZE; byte++) {
+            fprintf(fd, "%02x", manifest->entries[index].sha256[byte]);
+        }
+        fprintf(fd, "  %s\n", manifest->entries[index].name);
+    }
+    return fclose(fd) == 0;
+}
+
+void app_manifest_free(app_manifest_t* manifest) {
+    for (size_t index = 0; index < manifest->count; index++) {
+        free(manifest->entries[index].name);
+    }
+    free(manifest->entries);
+    manifest->entries = NULL;
+    manifest->count   = 0;
+}
+
+const uint8_t* app_manifest_find(const app_manifest_t* manifest, const char* name) {
+    for (size_t index = 0; index < manifest->count; index++) {
+        if (strcmp(manifest->entries[index].name, name) == 0) return manifest->entries[index].sha256;
+    }
+    return NULL;
+}
+
+bool app_manifest_set(app_manifest_t* manifest, const char* name, const uint8_t* sha256) {
+    uint8_t* existing = (uint8_t*) app_manifest_find(manifest, name);
+    if (existing != NULL) {
+        memcpy(existing, sha256, APP_MANIFEST_HASH_SIZE);
+        return true;
+    }
+    app_manifest_entry_t* entries = realloc(manifest->entries, (manifest->count + 1) * sizeof(app_manifest_entry_t));
+    if (entries == NULL) return false;
+    manifest->entries = entries;
+    char* copy        = strdup(name);
+    if (copy == NULL) return false;
+    entries[manifest->count].name = copy;
+    memcpy(entries[manifest->count].sha256, sha256, APP_MANIFEST_HASH_SIZE);
+    manifest->count++;
+    return true;
+}
@@ -8,6 +8,7 @@
 #include <freertos/queue.h>
 #include <freertos/task.h>
 #include <sdkconfig.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -19,25 +20,32 @@
 #include "gui_element_header.h"
 #include "hardware.h"
 #include "http_download.h"
+#include "http_pool.h"
 #include "launcher.h"
 #include "menu.h"
 #include "metadata.h"
+#include "mirrors.h"
 #include "pax_codecs.h"
 #include "pax_gfx.h"
 #include "rtc_memory.h"
 #include "system_wrapper.h"
+#include "version_check.h"
 #include "wifi_connect.h"
+#include "wifi_session.h"
 
 static const char* TAG = "Updater";
 
 typedef struct _update_apps_callback_args {
-    xQueueHandle button_queue;
-    bool         sdcard;
+    xQueueHandle          button_queue;
+    bool                  sdcard;
+    version_check_item_t* apps;    // Installed apps with complete metadata
+    bool*                 on_sd;   // For each app, whether it is installed on the SD card
+    size_t                count;
+    size_t                capacity;
 } update_apps_callback_args_t;
 
 static bool connect_to_wifi(xQueueHandle button_queue) {
-    if (!wifi_connect_to_stored()) {
-        wifi_disconnect_and_disable();
+    if (!wifi_session_acquire()) {
         render_message("Unable to connect to\nthe WiFi network");
         display_flush();
         wait_for_button();
@@ -52,7 +60,7 @@ static cJSON* json_app_info = NULL;
 
 static bool load_app_info(const char* type_slug, const char* category_slug, const char* app_slug) {
     char url[128];
-    snprintf(url, sizeof(url) - 1, "https://mch2022.badge.team/v2/mch2022/%s/%s/%s", type_slug, category_slug, app_slug);
+    snprintf(url, sizeof(url) - 1, MIRROR_HATCHERY_URL "/%s/%s/%s", type_slug, category_slug, app_slug);
     bool success = download_ram(url, (uint8_t**) &data_app_info, &size_app_info);
     if (!success) return false;
     if (data_app_info == NULL) return false;
@@ -111,11 +119,25 @@ static void terminal_free() {
     }
 }
 
+static void terminal_print(bool error, const char* format, ...) {
+    char    string_buffer[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(string_buffer, sizeof(string_buffer), format, args);
+    va_end(args);
+    if (error) {
+        ESP_LOGW(TAG, "%s", string_buffer);
+    } else {
+        ESP_LOGI(TAG, "%s", string_buffer);
+    }
+    terminal_add(strdup(string_buffer));
+    terminal_render();
+}
+
+// Collect the installed apps, their versions are checked all at once afterwards
 static void callback(const char* path, const char* entity, void* user) {
     update_apps_callback_args_t* args = (update_apps_callback_args_t*) user;
-    char                         string_buffer[128];
-    string_buffer[sizeof(string_buffer) - 1] = '\0';
-    char metadata_path[128];
+    char                         metadata_path[128];
     metadata_path[sizeof(metadata_path) - 1] = '\0';
     snprintf(metadata_path, sizeof(metadata_path) - 1, "%s/%s/metadata.json", path, entity);
 
@@ -128,70 +150,89 @@ static void callback(const char* path, const char* entity, void* user) {
     parse_metadata(metadata_path, &device, &type, &category, &slug, &name, NULL, NULL, &installed_version, NULL);
 
     if ((slug == NULL) || (strcmp(slug, entity) != 0)) {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s/%s: no metadata", path, entity);
-        ESP_LOGW(TAG, "%s", string_buffer);
-        terminal_add(strdup(string_buffer));
-        terminal_render();
+        terminal_print(true, "%s/%s: no metadata", path, entity);
         goto end;
     }
 
     if ((type == NULL) || (category == NULL)) {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: incomplete metadata", slug);
-        ESP_LOGW(TAG, "%s", string_buffer);
-        terminal_add(strdup(string_buffer));
-        terminal_render();
+        terminal_print(true, "%s: incomplete metadata", slug);
         goto end;
     }
 
-    if (!load_app_info(type, category, slug)) {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: fetching metadata failed", slug);
-        ESP_LOGW(TAG, "%s", string_buffer);
-        terminal_add(strdup(string_buffer));
-        terminal_render();
-        goto end;
+    if (args->count >= args->capacity) {
+        size_t                capacity = (args->capacity > 0) ? args->capacity * 2 : 16;
+        version_check_item_t* apps     = realloc(args->apps, capacity * sizeof(version_check_item_t));
+        bool*                 on_sd    = realloc(args->on_sd, capacity * sizeof(bool));
+        if (apps != NULL) args->apps = apps;
+        if (on_sd != NULL) args->on_sd = on_sd;
+        if ((apps == NULL) || (on_sd == NULL)) {
+            terminal_print(true, "%s: out of memory", slug);
+            goto end;
+        }
+        args->capacity = capacity;
     }
 
-    cJSON* version_obj = cJSON_GetObjectItem(json_app_info, "version");
+    version_check_item_t* app = &args->apps[args->count];
+    app->type                 = type;
+    app->category             = category;
+    app->slug                 = slug;
+    app->installed            = installed_version;
+    app->latest               = -1;
+    args->on_sd[args->count]  = args->sdcard;
+    args->count++;
+    type     = NULL;  // Owned by the list of apps now
+    category = NULL;
+    slug     = NULL;
 
-    if (!version_obj) {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: hatchery has no version", slug);
-        ESP_LOGW(TAG, "%s", string_buffer);
-        terminal_add(strdup(string_buffer));
-        terminal_render();
-        goto end;
+end:
+    if (device != NULL) free(device);
+    if (type != NULL) free(type);
+    if (slug != NULL) free(slug);
+    if (category != NULL) free(category);
+    if (name != NULL) free(name);
+}
+
+static void update_app(const version_check_item_t* app, bool sdcard) {
+    if (app->latest < 0) {
+        terminal_print(true, "%s: fetching metadata failed", app->slug);
+        return;
     }
 
-    if (installed_version >= version_obj->valueint) {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: up to date", slug);
-        ESP_LOGW(TAG, "%s", string_buffer);
-        terminal_add(strdup(string_buffer));
-        terminal_render();
-        goto end;
+    if (app->installed >= app->latest) {
+        terminal_print(false, "%s: up to date", app->slug);
+        return;
     }
 
-    snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: r%d to r%d", slug, installed_version, version_obj->valueint);
-    ESP_LOGI(TAG, "%s", string_buffer);
-    terminal_add(strdup(string_buffer));
-    terminal_render();
+    terminal_print(false, "%s: r%d to r%d", app->slug, app->installed, app->latest);
 
-    if (install_app(false, type, args->sdcard, data_app_info, size_app_info, json_app_info)) {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: installed r%d", slug, version_obj->valueint);
-        ESP_LOGI(TAG, "%s", string_buffer);
-    } else {
-        snprintf(string_buffer, sizeof(string_buffer) - 1, "%s: failed to install", slug);
-        ESP_LOGE(TAG, "%s", string_buffer);
+    if (!load_app_info(app->type, app->category, app->slug)) {
+        terminal_print(true, "%s: fetching metadata failed", app->slug);
+        free_app_info();
+        return;
     }
 
-    terminal_add(strdup(string_buffer));
-    terminal_render();
-
-end:
+    cJSON* version_obj = cJSON_GetObjectItem(json_app_info, "version");
+    int    version     = (version_obj != NULL) ? version_obj->valueint : app->latest;
+    if (install_app(false, app->type, sdcard, data_app_info, size_app_info, json_app_info)) {
+        terminal_print(false, "%s: installed r%d", app->slug, version);
+    } else {
+        terminal_print(true, "%s: failed to install", app->slug);
+    }
     free_app_info();
-    if (device != NULL) free(device);
-    if (type != NULL) free(type);
-    if (slug != NULL) free(slug);
-    if (category != NULL) free(category);
-    if (name != NULL) free(name);
+}
+
+static void free_apps(update_apps_callback_args_t* args) {
+    for (size_t index = 0; index < args->count; index++) {
+        free((char*) args->apps[index].type);
+        free((char*) args->apps[index].category);
+        free((char*) args->apps[index].slug);
+    }
+    free(args->apps);
+    free(args->on_sd);
+    args->apps     = NULL;
+    args->on_sd    = NULL;
+    args->count    = 0;
+    args->capacity = 0;
 }
 
 void update_apps(xQueueHandle button_queue) {
@@ -209,9 +250,9 @@ void update_apps(xQueueHandle button_queue) {
     terminal_add(strdup("Connected to WiFi"));
     terminal_render();
 
-    update_apps_callback_args_t args;
-    args.button_queue = button_queue;
-    args.sdcard       = false;
+    update_apps_callback_args_t args = {0};
+    args.button_queue                = button_queue;
+    args.sdcard                      = false;
 
     for_entity_in_path("/internal/apps/esp32", true, &callback, &args);
     for_entity_in_path("/internal/apps/python", true, &callback, &args);
@@ -219,8 +260,17 @@ void update_apps(xQueueHandle button_queue) {
     for_entity_in_path("/sd/apps/esp32", true, &callback, &args);
     for_entity_in_path("/sd/apps/python", true, &callback, &args);
 
+    terminal_print(false, "Checking %u apps for updates...", args.count);
+    version_check(args.apps, args.count);
+
+    for (size_t index = 0; index < args.count; index++) {
+        update_app(&args.apps[index], args.on_sd[index]);
+    }
+
+    free_apps(&args);
     terminal_free();
-    wifi_disconnect_and_disable();
+    http_pool_flush();
+    wifi_session_release();
     size_t ram_after = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
     printf("Leak: %d (%u to %u)\r\n", ram_before - ram_after, ram_before, ram_after);
 }
@@ -0,0 +1,169 @@
+#include "appfs_patch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "appfs.h"
+#include "esp_log.h"
+
+static const char* TAG = "appfs patch";
+
+#define APPFS_PATCH_READ_CHUNK 1024
+
+static uint32_t read_u32(const uint8_t* data) { return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24); }
+
+esp_err_t appfs_patch_begin(appfs_patch_t* patch, const char* name, const char* title, uint16_t version, const char* copy_path) {
+    memset(patch, 0, sizeof(appfs_patch_t));
+    patch->name      = name;
+    patch->title     = title;
+    patch->version   = version;
+    patch->copy_path = copy_path;
+    patch->old       = appfsOpen(name);
+    if (patch->old == APPFS_INVALID_FD) return ESP_ERR_NOT_FOUND;
+    int old_size = 0;
+    appfsEntryInfo(patch->old, NULL, &old_size);
+    patch->old_size = old_size;
+    snprintf(patch->temp_name, sizeof(patch->temp_name), "%.40s.patch", name);
+    patch->buffer = malloc(APPFS_PATCH_READ_CHUNK);
+    if (patch->buffer == NULL) return ESP_ERR_NO_MEM;
+    mbedtls_sha256_init(&patch->sha256);
+    mbedtls_sha256_starts_ret(&patch->sha256, 0);
+    return ESP_OK;
+}
+
+static esp_err_t output(appfs_patch_t* patch, const uint8_t* data, size_t length) {
+    if (patch->produced + length > patch->new_size) {
+        ESP_LOGE(TAG, "Patch produces more than %u bytes", patch->new_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    mbedtls_sha256_update_ret(&patch->sha256, data, length);
+    patch->produced += length;
+    return appfs_sink_write(&patch->sink, data, length);
+}
+
+static esp_err_t parse_header(appfs_patch_t* patch) {
+    if (read_u32(&patch->header[0]) != APPFS_PATCH_MAGIC) {
+        ESP_LOGE(TAG, "Not an AppFS patch");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (read_u32(&patch->header[4]) != patch->old_size) {
+        ESP_LOGE(TAG, "Patch is for an app of %u bytes, installed app is %u bytes", read_u32(&patch->header[4]), patch->old_size);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    patch->new_size = read_u32(&patch->header[8]);
+    memcpy(patch->expected, &patch->header[12], sizeof(patch->expected));
+    esp_err_t res = appfs_sink_begin(&patch->sink, patch->temp_name, patch->title, patch->version, patch->new_size, patch->copy_path);
+    if (res != ESP_OK) return res;
+    patch->started = true;
+    return ESP_OK;
+}
+
+// Add diff data to the old app
+static esp_err_t apply_diff(appfs_patch_t* patch, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = (length < APPFS_PATCH_READ_CHUNK) ? length : APPFS_PATCH_READ_CHUNK;
+        if (patch->old_position + chunk > patch->old_size) {
+            ESP_LOGE(TAG, "Patch reads beyond the end of the installed app");
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t res = appfsRead(patch->old, patch->old_position, patch->buffer, chunk);
+        if (res != ESP_OK) return res;
+        for (size_t index = 0; index < chunk; index++) {
+            patch->buffer[index] += data[index];
+        }
+        res = output(patch, patch->buffer, chunk);
+        if (res != ESP_OK) return res;
+        patch->old_position += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return ESP_OK;
+}
+
+esp_err_t appfs_patch_write(appfs_patch_t* patch, const uint8_t* data, size_t length) {
+    if (patch->buffer == NULL) return ESP_ERR_INVALID_STATE;
+    while (length > 0) {
+        if (!patch->started) {
+            size_t chunk = APPFS_PATCH_HEADER_SIZE - patch->header_received;
+            if (chunk > length) chunk = length;
+            memcpy(&patch->header[patch->header_received], data, chunk);
+            patch->header_received += chunk;
+            data += chunk;
+            length -= chunk;
+            if (patch->header_received < APPFS_PATCH_HEADER_SIZE) continue;
+            patch->header_received = 0;
+            esp_err_t res          = parse_header(patch);
+            if (res != ESP_OK) return res;
+        } else if (patch->diff_left > 0) {
+            size_t    chunk = (patch->diff_left < length) ? patch->diff_left : length;
+            esp_err_t res   = apply_diff(patch, data, chunk);
+            if (res != ESP_OK) return res;
+            patch->diff_left -= chunk;
+            data += chunk;
+            length -= chunk;
+            if (patch->diff_left == 0) patch->old_position += patch->adjustment;
+        } else if (patch->extra_left > 0) {
+            size_t    chunk = (patch->extra_left < length) ? patch->extra_left : length;
+            esp_err_t res   = output(patch, data, chunk);
+            if (res != ESP_OK) return res;
+            patch->extra_left -= chunk;
+            data += chunk;
+            length -= chunk;
+        } else {
+            // Control block
+            size_t chunk = APPFS_PATCH_BLOCK_SIZE - patch->header_received;
+            if (chunk > length) chunk = length;
+            memcpy(&patch->header[patch->header_received], data, chunk);
+            patch->header_received += chunk;
+            data += chunk;
+            length -= chunk;
+            if (patch->header_received < APPFS_PATCH_BLOCK_SIZE) continue;
+            patch->header_received = 0;
+            patch->diff_left       = read_u32(&patch->header[0]);
+            patch->extra_left      = read_u32(&patch->header[4]);
+            patch->adjustment      = (int32_t) read_u32(&patch->header[8]);
+            // bsdiff adjusts the position after the extra data, which is the same as after the diff data since extra data doesn't move it
+            if (patch->diff_left == 0) patch->old_position += patch->adjustment;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t appfs_patch_finish(appfs_patch_t* patch) {
+    if ((!patch->started) || (patch->diff_left > 0) || (patch->extra_left > 0) || (patch->header_received > 0) || (patch->produced != patch->new_size)) {
+        ESP_LOGE(TAG, "Patch is incomplete");
+        appfs_patch_abort(patch);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t hash[32];
+    mbedtls_sha256_finish_ret(&patch->sha256, hash);
+    if (memcmp(hash, patch->expected, sizeof(hash)) != 0) {
+        ESP_LOGE(TAG, "Patched app does not match its hash");
+        appfs_patch_abort(patch);
+        return ESP_ERR_INVALID_CRC;
+    }
+    esp_err_t res  = appfs_sink_finish(&patch->sink);
+    patch->started = false;
+    if (res != ESP_OK) {
+        appfs_patch_abort(patch);
+        return res;
+    }
+    free(patch->buffer);
+    patch->buffer = NULL;
+    mbedtls_sha256_free(&patch->sha256);
+
+    // The old app is only removed once the new app is complete and verified
+    appfsDeleteFile(patch->name);
+    res = appfsRename(patch->temp_name, patch->name);
+    if (res != ESP_OK) ESP_LOGE(TAG, "Failed to rename %s to %s (%d)", patch->temp_name, patch->name, res);
+    return res;
+}
+
+void appfs_patch_abort(appfs_patch_t* patch) {
+    if (patch->started) appfs_sink_abort(&patch->sink);
+    patch->started = false;
+    if (patch->buffer != NULL) mbedtls_sha256_free(&patch->sha256);
+    free(patch->buffer);
+    patch->buffer = NULL;
+}
@@ -108,3 +108,111 @@ esp_err_t appfs_store_in_memory_app(bool wait, const char* name, const char* tit
     ESP_LOGI(TAG, "Application is now stored in AppFS");
     return res;
 }
+
+// Write the sector buffer to flash, erasing the next 64 KB page first when the write reaches it
+static esp_err_t sink_flush(appfs_sink_t* sink) {
+    if (sink->buffered == 0) return ESP_OK;
+    if (sink->written + sink->buffered > sink->size) {
+        ESP_LOGE(TAG, "Received more data than the size of the app (%u bytes)", sink->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (sink->erased < sink->written + sink->buffered) {
+        esp_err_t res = appfsErase(sink->handle, sink->erased, SPI_FLASH_MMU_PAGE_SIZE);
+        if (res != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase file on AppFS (%d)", res);
+            return res;
+        }
+        sink->erased += SPI_FLASH_MMU_PAGE_SIZE;
+    }
+    esp_err_t res = appfsWrite(sink->handle, sink->written, sink->buffer, sink->buffered);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write to file on AppFS (%d)", res);
+        return res;
+    }
+    sink->written += sink->buffered;
+    sink->buffered = 0;
+    return ESP_OK;
+}
+
+esp_err_t appfs_sink_begin(appfs_sink_t* sink, const char* name, const char* title, uint16_t version, size_t size, const char* copy_path) {
+    memset(sink, 0, sizeof(appfs_sink_t));
+    sink->size      = size;
+    sink->copy_path = copy_path;
+    if (size == 0) return ESP_ERR_INVALID_SIZE;
+
+    sink->buffer = malloc(SPI_FLASH_SEC_SIZE);
+    if (sink->buffer == NULL) return ESP_ERR_NO_MEM;
+
+    esp_err_t res = appfsCreateFileExt(name, title, version, size, &sink->handle);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create file on AppFS (%d)", res);
+        free(sink->buffer);
+        sink->buffer = NULL;
+        return res;
+    }
+    sink->name = name;  // Only set once the entry exists, so an abort never removes an existing app
+
+    if (copy_path != NULL) {
+        sink->copy = fopen(copy_path, "wb");
+        if (sink->copy == NULL) {
+            ESP_LOGE(TAG, "Failed to open %s", copy_path);
+            appfs_sink_abort(sink);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t appfs_sink_write(appfs_sink_t* sink, const uint8_t* data, size_t length) {
+    if (sink->buffer == NULL) return ESP_ERR_INVALID_STATE;
+    if ((sink->copy != NULL) && (fwrite(data, 1, length, sink->copy) != length)) {
+        ESP_LOGE(TAG, "Failed to write to %s", sink->copy_path);
+        return ESP_FAIL;
+    }
+    while (length > 0) {
+        size_t chunk = SPI_FLASH_SEC_SIZE - sink->buffered;
+        if (chunk > length) chunk = length;
+        memcpy(&sink->buffer[sink->buffered], data, chunk);
+        sink->buffered += chunk;
+        data += chunk;
+        length -= chunk;
+        if (sink->buffered == SPI_FLASH_SEC_SIZE) {
+            esp_err_t res = sink_flush(sink);
+            if (res != ESP_OK) return res;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t appfs_sink_finish(appfs_sink_t* sink) {
+    if (sink->buffer == NULL) return ESP_ERR_INVALID_STATE;
+    esp_err_t res = sink_flush(sink);
+    if ((res == ESP_OK) && (sink->written != sink->size)) {
+        ESP_LOGE(TAG, "App is incomplete, %u of %u bytes written", sink->written, sink->size);
+        res = ESP_ERR_INVALID_SIZE;
+    }
+    if (res != ESP_OK) {
+        appfs_sink_abort(sink);
+        return res;
+    }
+    free(sink->buffer);
+    sink->buffer = NULL;
+    if (sink->copy != NULL) {
+        fclose(sink->copy);
+        sink->copy = NULL;
+    }
+    ESP_LOGI(TAG, "Application is now stored in AppFS");
+    return ESP_OK;
+}
+
+void appfs_sink_abort(appfs_sink_t* sink) {
+    free(sink->buffer);
+    sink->buffer = NULL;
+    if (sink->copy != NULL) {
+        fclose(sink->copy);
+        sink->copy = NULL;
+        remove(sink->copy_path);
+    }
+    if (sink->name != NULL) appfsDeleteFile(sink->name);
+    sink->name = NULL;
+}
@@ -0,0 +1,96 @@
+#include "boot_stats.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "boot_trace.h"
+#include "gui_element_header.h"
+#include "hardware.h"
+#include "input_latency.h"
+#include "pax_gfx.h"
+
+#define BOOT_STATS_ROWS 8
+
+// Horizontal extent of the timeline, which runs from the start of the app until boot was done
+#define BOOT_STATS_BAR_X     95
+#define BOOT_STATS_BAR_WIDTH 100
+
+static void render_boot_stats(pax_buf_t* pax_buffer, const char* status) {
+    const pax_font_t* font = pax_font_saira_regular;
+    pax_noclip(pax_buffer);
+    pax_background(pax_buffer, 0xFFFFFF);
+    render_header(pax_buffer, 0, 0, pax_buffer->width, 34, 18, 0xFFfec859, 0xFFfa448c, NULL, "Boot timing");
+
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 38, "Stage");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, BOOT_STATS_BAR_X, 38, "Timeline");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 201, 38, "ms");
+
+    boot_trace_stage_t stages[BOOT_TRACE_MAX_STAGES];
+    size_t             amount = boot_trace_get(stages, BOOT_TRACE_MAX_STAGES);
+    int64_t            total  = boot_trace_get_total();
+    if (total <= 0) total = 1;
+    for (size_t index = 0; (index < amount) && (index < BOOT_STATS_ROWS); index++) {
+        const boot_trace_stage_t* stage = &stages[index];
+        float                     y     = 54 + 16 * index;
+        bool                      ok    = (stage->result == ESP_OK);
+        pax_draw_text(pax_buffer, ok ? 0xFF000000 : 0xFFFF0000, font, 14, 5, y, stage->name);
+
+        // Stages that ran concurrently overlap on the timeline
+        float x     = BOOT_STATS_BAR_X + (float) (stage->start_us * BOOT_STATS_BAR_WIDTH) / total;
+        float width = (float) ((stage->end_us - stage->start_us) * BOOT_STATS_BAR_WIDTH) / total;
+        if (width < 1) width = 1;
+        pax_draw_rect(pax_buffer, ok ? 0xFF491d88 : 0xFFFF0000, x, y + 3, width, 10);
+
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u", (unsigned) ((stage->end_us - stage->start_us) / 1000));
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 201, y, buffer);
+    }
+
+    char summary[48];
+    snprintf(summary, sizeof(summary), "Boot took %u ms", (unsigned) (boot_trace_get_total() / 1000));
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 240 - 52, summary);
+
+    if (status != NULL) {
+        pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 240 - 36, status);
+    }
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 18, 5, 240 - 18, "🅰 export  🅱 back");
+}
+
+void show_boot_stats() {
+    pax_buf_t*  pax_buffer = get_pax_buffer();
+    const char* status     = NULL;
+    bool        render     = true;
+    bool        quit       = false;
+
+    input_latency_set_screen("boot stats");
+
+    while (!quit) {
+        if (render) {
+            render_boot_stats(pax_buffer, status);
+            display_flush();
+            render = false;
+        }
+
+        input_message_t button_message = {0};
+        if (input_buffer_receive(&button_message, portMAX_DELAY)) {
+            if (button_message.state) {
+                switch (button_message.input) {
+                    case INPUT_TOUCH0:
+                        quit = true;
+                        break;
+                    case INPUT_TOUCH2:
+                        boot_trace_dump();
+                        status = "Stages written to serial console";
+                        render = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+}
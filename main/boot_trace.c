@@ -0,0 +1,156 @@
+#include "boot_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+
+static const char* TAG = "boot";
+
+// Event groups hold 24 bits
+#define BOOT_TRACE_MAX_STEPS 24
+
+typedef struct _boot_step_context {
+    const boot_step_t* step;
+    size_t             index;
+    EventGroupHandle_t done;    // Bit per step that is done, set after the failed bit
+    EventGroupHandle_t failed;  // Bit per step that failed or was skipped
+    esp_err_t*         result;
+    TaskHandle_t       waiter;  // Notified when the task no longer uses the context and the event groups
+} boot_step_context_t;
+
+static boot_trace_stage_t stages[BOOT_TRACE_MAX_STAGES];
+static size_t             stage_count = 0;
+static int64_t            total_us    = 0;
+static portMUX_TYPE       stage_lock  = portMUX_INITIALIZER_UNLOCKED;
+
+int boot_trace_begin(const char* name) {
+    int64_t now = esp_timer_get_time();
+    int     stage;
+    portENTER_CRITICAL(&stage_lock);
+    stage = (stage_count < BOOT_TRACE_MAX_STAGES) ? stage_count++ : -1;
+    if (stage >= 0) {
+        stages[stage] = (boot_trace_stage_t){.name = name, .start_us = now, .end_us = 0, .core = xPortGetCoreID(), .result = ESP_OK};
+    }
+    portEXIT_CRITICAL(&stage_lock);
+    return stage;
+}
+
+void boot_trace_end(int stage, esp_err_t result) {
+    if ((stage < 0) || (stage >= BOOT_TRACE_MAX_STAGES)) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stage_lock);
+    stages[stage].end_us = now;
+    stages[stage].result = result;
+    portEXIT_CRITICAL(&stage_lock);
+}
+
+static void boot_step_task(void* arg) {
+    boot_step_context_t* context = (boot_step_context_t*) arg;
+    const boot_step_t*   step    = context->step;
+    EventBits_t          bit     = 1 << context->index;
+
+    if (step->depends != 0) xEventGroupWaitBits(context->done, step->depends, pdFALSE, pdTRUE, portMAX_DELAY);
+    esp_err_t res = ESP_ERR_INVALID_STATE;
+    if ((xEventGroupGetBits(context->failed) & step->depends) == 0) {
+        int stage = boot_trace_begin(step->name);
+        res       = step->run();
+        boot_trace_end(stage, res);
+    } else {
+        ESP_LOGE(TAG, "Skipping %s, a step it depends on failed", step->name);
+    }
+    *context->result = res;
+
+    if (res != ESP_OK) xEventGroupSetBits(context->failed, bit);
+    xEventGroupSetBits(context->done, bit);
+    // Last use of the context, which is on the stack of the waiter. It deletes the event groups once every task has notified it
+    xTaskNotifyGive(context->waiter);
+    vTaskDelete(NULL);
+}
+
+static void fill_results(esp_err_t* results, size_t count, esp_err_t result) {
+    for (size_t index = 0; index < count; index++) {
+        results[index] = result;
+    }
+}
+
+bool boot_trace_run(const boot_step_t* steps, size_t count, esp_err_t* results) {
+    if (count > BOOT_TRACE_MAX_STEPS) {
+        ESP_LOGE(TAG, "Too many boot steps: %u", count);
+        fill_results(results, count, ESP_ERR_INVALID_ARG);
+        return false;
+    }
+    boot_step_context_t contexts[BOOT_TRACE_MAX_STEPS];
+    EventGroupHandle_t  done   = xEventGroupCreate();
+    EventGroupHandle_t  failed = xEventGroupCreate();
+    if ((done == NULL) || (failed == NULL)) {
+        if (done != NULL) vEventGroupDelete(done);
+        if (failed != NULL) vEventGroupDelete(failed);
+        fill_results(results, count, ESP_ERR_NO_MEM);
+        return false;
+    }
+
+    UBaseType_t  priority = uxTaskPriorityGet(NULL);
+    BaseType_t   core     = xPortGetCoreID();
+    TaskHandle_t waiter   = xTaskGetCurrentTaskHandle();
+    size_t       started  = 0;
+    for (size_t index = 0; index < count; index++) {
+        contexts[index] =
+            (boot_step_context_t){.step = &steps[index], .index = index, .done = done, .failed = failed, .result = &results[index], .waiter = waiter};
+        if (xTaskCreatePinnedToCore(boot_step_task, steps[index].name, BOOT_TRACE_STACK_SIZE, &contexts[index], priority, NULL,
+                                    steps[index].pinned ? core : tskNO_AFFINITY) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start a task for %s", steps[index].name);
+            results[index] = ESP_ERR_NO_MEM;
+            xEventGroupSetBits(failed, 1 << index);
+            xEventGroupSetBits(done, 1 << index);
+        } else {
+            started++;
+        }
+    }
+
+    // Waiting for the done bits is not enough: a task can still be inside xEventGroupSetBits after the last bit is set.
+    // The notification is the last thing a task does before it deletes itself.
+    for (size_t index = 0; index < started; index++) {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+    EventBits_t all     = (1 << count) - 1;
+    bool        success = (xEventGroupGetBits(failed) & all) == 0;
+    vEventGroupDelete(done);
+    vEventGroupDelete(failed);
+    return success;
+}
+
+void boot_trace_done() {
+    total_us = esp_timer_get_time();
+    boot_trace_stage_t copy[BOOT_TRACE_MAX_STAGES];
+    size_t             count = boot_trace_get(copy, BOOT_TRACE_MAX_STAGES);
+    for (size_t index = 0; index < count; index++) {
+        ESP_LOGI(TAG, "%-16s %5u ms - %5u ms (core %d)%s", copy[index].name, (unsigned) (copy[index].start_us / 1000), (unsigned) (copy[index].end_us / 1000),
+                 copy[index].core, (copy[index].result == ESP_OK) ? "" : " failed");
+    }
+    ESP_LOGI(TAG, BOOT_TRACE_DONE_MESSAGE " %u ms", (unsigned) (total_us / 1000));
+}
+
+int64_t boot_trace_get_total() { return total_us; }
+
+size_t boot_trace_get(boot_trace_stage_t* copy, size_t max) {
+    portENTER_CRITICAL(&stage_lock);
+    size_t count = (stage_count < max) ? stage_count : max;
+    memcpy(copy, stages, sizeof(boot_trace_stage_t) * count);
+    portEXIT_CRITICAL(&stage_lock);
+    return count;
+}
+
+void boot_trace_dump() {
+    boot_trace_stage_t copy[BOOT_TRACE_MAX_STAGES];
+    size_t             count = boot_trace_get(copy, BOOT_TRACE_MAX_STAGES);
+    printf("stage,start_us,end_us,core,result\n");
+    for (size_t index = 0; index < count; index++) {
+        printf("%s,%lld,%lld,%d,%s\n", copy[index].name, copy[index].start_us, copy[index].end_us, copy[index].core, esp_err_to_name(copy[index].result));
+    }
+    printf("total,0,%lld,,\n", total_us);
+}
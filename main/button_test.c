@@ -24,7 +24,7 @@ void test_buttons() {
 
     while (!quit) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             bool value = button_message.state;
             render = true;
             switch (button_message.input) {
@@ -0,0 +1,130 @@
+#include "download_scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_download.h"
+#include "sdkconfig.h"
+
+static const char* TAG = "Download scheduler";
+
+#define DOWNLOAD_WORKER_STACK      8192  // TLS handshakes need a lot of stack
+#define DOWNLOAD_PROGRESS_INTERVAL 250
+
+typedef struct {
+    const download_job_t* jobs;
+    size_t                count;
+    size_t                next;                                   // Index of the next job to start
+    size_t                files_done;                             // Amount of completed jobs
+    size_t                bytes_done;                             // Bytes received for completed jobs
+    size_t                received[CONFIG_DOWNLOAD_CONCURRENCY];  // Bytes received for the job each worker is working on
+    bool                  failed;                                 // A job failed, remaining jobs are not started
+    download_done_cb_t    done;
+    void*                 user;
+    portMUX_TYPE          lock;
+    SemaphoreHandle_t     finished;  // Given by each worker when it exits
+} download_scheduler_t;
+
+typedef struct {
+    download_scheduler_t* scheduler;
+    size_t                worker;
+} download_worker_args_t;
+
+static void download_worker(void* arg) {
+    download_worker_args_t* args      = (download_worker_args_t*) arg;
+    download_scheduler_t*   scheduler = args->scheduler;
+    size_t*                 received  = &scheduler->received[args->worker];
+
+    while (true) {
+        portENTER_CRITICAL(&scheduler->lock);
+        bool   stop  = scheduler->failed || (scheduler->next >= scheduler->count);
+        size_t index = scheduler->next;
+        if (!stop) scheduler->next++;
+        portEXIT_CRITICAL(&scheduler->lock);
+        if (stop) break;
+
+        const download_job_t* job = &scheduler->jobs[index];
+        ESP_LOGI(TAG, "Worker %u downloading %s to %s", args->worker, job->url, job->path);
+        bool success = download_file_progress(job->url, job->path, received);
+        if (success && (scheduler->done != NULL)) success = scheduler->done(index, scheduler->user);
+
+        portENTER_CRITICAL(&scheduler->lock);
+        if (success) {
+            scheduler->files_done++;
+            scheduler->bytes_done += *received;
+        } else {
+            scheduler->failed = true;
+        }
+        *received = 0;
+        portEXIT_CRITICAL(&scheduler->lock);
+
+        if (!success) ESP_LOGE(TAG, "Failed to download %s", job->url);
+    }
+
+    xSemaphoreGive(scheduler->finished);
+    vTaskDelete(NULL);
+}
+
+static void report_progress(download_scheduler_t* scheduler, size_t bytes_total, download_progress_cb_t progress, void* user) {
+    if (progress == NULL) return;
+    portENTER_CRITICAL(&scheduler->lock);
+    size_t files_done = scheduler->files_done;
+    size_t bytes_done = scheduler->bytes_done;
+    for (size_t worker = 0; worker < CONFIG_DOWNLOAD_CONCURRENCY; worker++) {
+        bytes_done += scheduler->received[worker];
+    }
+    portEXIT_CRITICAL(&scheduler->lock);
+    progress(files_done, scheduler->count, bytes_done, bytes_total, user);
+}
+
+bool download_files(const download_job_t* jobs, size_t count, download_progress_cb_t progress, download_done_cb_t done, void* user) {
+    if (count == 0) return true;
+
+    download_scheduler_t scheduler = {0};
+    scheduler.jobs                 = jobs;
+    scheduler.count                = count;
+    scheduler.done                 = done;
+    scheduler.user                 = user;
+    scheduler.lock                 = (portMUX_TYPE) portMUX_INITIALIZER_UNLOCKED;
+    scheduler.finished             = xSemaphoreCreateCounting(CONFIG_DOWNLOAD_CONCURRENCY, 0);
+    if (scheduler.finished == NULL) return false;
+
+    size_t bytes_total = 0;
+    for (size_t index = 0; index < count; index++) {
+        bytes_total += jobs[index].size;
+    }
+
+    download_worker_args_t args[CONFIG_DOWNLOAD_CONCURRENCY];
+    size_t                 workers = 0;
+    for (size_t worker = 0; (worker < CONFIG_DOWNLOAD_CONCURRENCY) && (worker < count); worker++) {
+        args[worker].scheduler = &scheduler;
+        args[worker].worker    = worker;
+        char name[16];
+        snprintf(name, sizeof(name), "download_%u", worker);
+        if (xTaskCreate(download_worker, name, DOWNLOAD_WORKER_STACK, &args[worker], 5, NULL) != pdPASS) {
+            ESP_LOGW(TAG, "Failed to start worker %u", worker);
+            break;
+        }
+        workers++;
+    }
+
+    if (workers == 0) {
+        vSemaphoreDelete(scheduler.finished);
+        return false;
+    }
+
+    size_t finished = 0;
+    while (finished < workers) {
+        if (xSemaphoreTake(scheduler.finished, pdMS_TO_TICKS(DOWNLOAD_PROGRESS_INTERVAL)) == pdTRUE) {
+            finished++;
+        }
+        report_progress(&scheduler, bytes_total, progress, user);
+    }
+
+    vSemaphoreDelete(scheduler.finished);
+    return (!scheduler.failed) && (scheduler.files_done == count);
+}
@@ -0,0 +1,128 @@
+#include "download_writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char* TAG = "Download writer";
+
+#define DOWNLOAD_WRITER_CLUSTER CONFIG_WL_SECTOR_SIZE             // Allocation unit of the internal filesystem
+#define DOWNLOAD_WRITER_BUFFER  (4 * DOWNLOAD_WRITER_CLUSTER)  // Data is written in blocks of up to this size
+
+static void writer_free(download_writer_t* writer) {
+    if (writer->fd != NULL) fclose(writer->fd);
+    free(writer->path);
+    free(writer->temp_path);
+    free(writer->buffer);
+    memset(writer, 0, sizeof(download_writer_t));
+}
+
+bool download_writer_init(download_writer_t* writer, const char* path) {
+    memset(writer, 0, sizeof(download_writer_t));
+    writer->path      = strdup(path);
+    writer->temp_path = malloc(strlen(path) + strlen(".part") + 1);
+    writer->buffer    = malloc(DOWNLOAD_WRITER_BUFFER);
+    if ((writer->path == NULL) || (writer->temp_path == NULL) || (writer->buffer == NULL)) {
+        writer_free(writer);
+        return false;
+    }
+    sprintf(writer->temp_path, "%s.part", path);
+    return true;
+}
+
+bool download_writer_open(download_writer_t* writer, size_t* offset) {
+    writer->fd = (*offset > 0) ? fopen(writer->temp_path, "r+b") : NULL;
+    if ((writer->fd != NULL) && (fseek(writer->fd, *offset, SEEK_SET) != 0)) {
+        fclose(writer->fd);
+        writer->fd = NULL;
+    }
+    if (writer->fd == NULL) {
+        *offset    = 0;
+        writer->fd = fopen(writer->temp_path, "wb");
+    }
+    if (writer->fd == NULL) {
+        ESP_LOGE(TAG, "Failed to open %s", writer->temp_path);
+        return false;
+    }
+    setvbuf(writer->fd, NULL, _IONBF, 0);  // Blocks are already buffered here, don't copy them again
+    writer->position = *offset;
+    writer->buffered = 0;
+    return true;
+}
+
+static bool writer_flush(download_writer_t* writer) {
+    if (writer->buffered == 0) return true;
+    if (fwrite(writer->buffer, 1, writer->buffered, writer->fd) != writer->buffered) {
+        ESP_LOGE(TAG, "Failed to write to %s", writer->temp_path);
+        return false;
+    }
+    writer->position += writer->buffered;
+    writer->buffered  = 0;
+    return true;
+}
+
+bool download_writer_preallocate(download_writer_t* writer, size_t size) {
+    // FatFS allocates the cluster chain when seeking past the end of a file that is open for writing,
+    // f_expand itself can't be reached through the VFS
+    if (!writer_flush(writer)) return false;
+    if (fseek(writer->fd, size, SEEK_SET) != 0) return false;
+    return fseek(writer->fd, writer->position, SEEK_SET) == 0;
+}
+
+bool download_writer_seek(download_writer_t* writer, size_t offset) {
+    if (!writer_flush(writer)) return false;
+    if (fseek(writer->fd, offset, SEEK_SET) != 0) return false;
+    writer->position = offset;
+    return true;
+}
+
+bool download_writer_write(download_writer_t* writer, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        // The block ends on a cluster boundary, also when a resumed download started in the middle of a cluster
+        size_t limit = DOWNLOAD_WRITER_BUFFER - (writer->position % DOWNLOAD_WRITER_CLUSTER);
+        size_t chunk = limit - writer->buffered;
+        if (chunk > length) chunk = length;
+        memcpy(&writer->buffer[writer->buffered], data, chunk);
+        writer->buffered += chunk;
+        data             += chunk;
+        length           -= chunk;
+        if ((writer->buffered == limit) && (!writer_flush(writer))) return false;
+    }
+    return true;
+}
+
+bool download_writer_close(download_writer_t* writer) {
+    if (writer->fd == NULL) return false;
+    bool success = writer_flush(writer);
+    success      = (fclose(writer->fd) == 0) && success;
+    writer->fd   = NULL;
+    return success;
+}
+
+bool download_writer_commit(download_writer_t* writer, size_t size) {
+    // The file can be longer than the download when it was preallocated or when an earlier attempt received a different version
+    bool success = (truncate(writer->temp_path, size) == 0);
+    if (success) {
+        // FAT can't rename onto an existing file, the old file is only removed once the new one is complete
+        remove(writer->path);
+        success = (rename(writer->temp_path, writer->path) == 0);
+    }
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to move %s to %s", writer->temp_path, writer->path);
+        remove(writer->temp_path);
+    }
+    writer_free(writer);
+    return success;
+}
+
+void download_writer_discard(download_writer_t* writer) {
+    if (writer->fd != NULL) {
+        fclose(writer->fd);
+        writer->fd = NULL;
+    }
+    if (writer->temp_path != NULL) remove(writer->temp_path);
+    writer_free(writer);
+}
@@ -14,6 +14,7 @@
 #include "esp_vfs.h"
 #include "esp_vfs_fat.h"
 #include "hardware.h"
+#include "input_latency.h"
 #include "menu.h"
 #include "pax_gfx.h"
 #include "system_wrapper.h"
@@ -233,16 +234,18 @@ void file_browser(xQueueHandle button_queue, const char* initial_path) {
         bool                      exit     = false;
         file_browser_menu_args_t* menuArgs = NULL;
 
+        input_latency_set_screen("file browser");
+
         while (1) {
             input_message_t buttonMessage = {0};
-            if (xQueueReceive(get_input_queue(), &buttonMessage, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+            if (input_buffer_receive(&buttonMessage, 16 / portTICK_PERIOD_MS)) {
                 if (buttonMessage.state) {
                     switch (buttonMessage.input) {
                         case INPUT_TOUCH0:
                             menuArgs = pd_args;
                             break;
                         case INPUT_TOUCH1:
-                            menu_navigate_next(menu);
+                            menu_navigate_next_steps(menu, buttonMessage.count);
                             render = true;
                             break;
                         case INPUT_TOUCH2:
@@ -0,0 +1,197 @@
+#include "gzip_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp32/rom/miniz.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+static const char* TAG = "gzip";
+
+#define GZIP_ID1      0x1F
+#define GZIP_ID2      0x8B
+#define GZIP_DEFLATE  8
+#define GZIP_FHCRC    0x02
+#define GZIP_FEXTRA   0x04
+#define GZIP_FNAME    0x08
+#define GZIP_FCOMMENT 0x10
+
+typedef enum {
+    GZIP_HEADER,         // Fixed 10 byte header
+    GZIP_EXTRA_LENGTH,   // Length of the extra field
+    GZIP_EXTRA,          // Extra field
+    GZIP_NAME,           // Zero terminated file name
+    GZIP_COMMENT,        // Zero terminated comment
+    GZIP_HEADER_CRC,     // CRC16 of the header
+    GZIP_DATA,           // Deflate stream
+    GZIP_TRAILER,        // CRC32 and size of the decompressed data
+    GZIP_DONE,
+    GZIP_ERROR
+} gzip_state_t;
+
+struct _gzip_stream {
+    tinfl_decompressor inflator;
+    uint8_t            dictionary[TINFL_LZ_DICT_SIZE];  // Output is written to this circular buffer
+    size_t             dictionary_offset;
+    gzip_state_t       state;
+    uint8_t            header[10];
+    size_t             position;  // Bytes of the current header or trailer field that have been read
+    size_t             skip;      // Bytes left in the extra field
+    uint8_t            flags;
+    uint32_t           crc;
+    size_t             output_size;
+    download_data_cb_t output;
+    void*              user;
+};
+
+gzip_stream_t* gzip_stream_create(download_data_cb_t output, void* user) {
+    gzip_stream_t* stream = malloc(sizeof(gzip_stream_t));
+    if (stream == NULL) return NULL;
+    tinfl_init(&stream->inflator);
+    stream->dictionary_offset = 0;
+    stream->state             = GZIP_HEADER;
+    stream->position          = 0;
+    stream->skip              = 0;
+    stream->flags             = 0;
+    stream->crc               = 0;
+    stream->output_size       = 0;
+    stream->output            = output;
+    stream->user              = user;
+    return stream;
+}
+
+void gzip_stream_free(gzip_stream_t* stream) { free(stream); }
+
+bool gzip_stream_finished(const gzip_stream_t* stream) { return stream->state == GZIP_DONE; }
+
+size_t gzip_stream_output_size(const gzip_stream_t* stream) { return stream->output_size; }
+
+// Move to the next header field that is present according to the flags
+static void next_header_field(gzip_stream_t* stream, gzip_state_t after) {
+    stream->position = 0;
+    if ((after < GZIP_EXTRA_LENGTH) && (stream->flags & GZIP_FEXTRA)) {
+        stream->state = GZIP_EXTRA_LENGTH;
+    } else if ((after < GZIP_NAME) && (stream->flags & GZIP_FNAME)) {
+        stream->state = GZIP_NAME;
+    } else if ((after < GZIP_COMMENT) && (stream->flags & GZIP_FCOMMENT)) {
+        stream->state = GZIP_COMMENT;
+    } else if ((after < GZIP_HEADER_CRC) && (stream->flags & GZIP_FHCRC)) {
+        stream->state = GZIP_HEADER_CRC;
+    } else {
+        stream->state = GZIP_DATA;
+    }
+}
+
+// Parse a byte of the header or trailer
+static bool parse_byte(gzip_stream_t* stream, uint8_t byte) {
+    switch (stream->state) {
+        case GZIP_HEADER:
+            stream->header[stream->position++] = byte;
+            if (stream->position < sizeof(stream->header)) return true;
+            if ((stream->header[0] != GZIP_ID1) || (stream->header[1] != GZIP_ID2) || (stream->header[2] != GZIP_DEFLATE)) {
+                ESP_LOGE(TAG, "Not a gzip stream");
+                return false;
+            }
+            stream->flags = stream->header[3];
+            next_header_field(stream, GZIP_HEADER);
+            return true;
+        case GZIP_EXTRA_LENGTH:
+            stream->skip |= byte << (8 * stream->position++);
+            if (stream->position < 2) return true;
+            if (stream->skip > 0) {
+                stream->state = GZIP_EXTRA;
+            } else {
+                next_header_field(stream, GZIP_EXTRA);
+            }
+            return true;
+        case GZIP_EXTRA:
+            if (--stream->skip == 0) next_header_field(stream, GZIP_EXTRA);
+            return true;
+        case GZIP_NAME:
+        case GZIP_COMMENT:
+            if (byte == 0) next_header_field(stream, stream->state);
+            return true;
+        case GZIP_HEADER_CRC:
+            if (++stream->position == 2) next_header_field(stream, GZIP_HEADER_CRC);
+            return true;
+        case GZIP_TRAILER:
+            stream->header[stream->position++] = byte;
+            if (stream->position < 8) return true;
+            {
+                uint32_t crc  = stream->header[0] | (stream->header[1] << 8) | (stream->header[2] << 16) | ((uint32_t) stream->header[3] << 24);
+                uint32_t size = stream->header[4] | (stream->header[5] << 8) | (stream->header[6] << 16) | ((uint32_t) stream->header[7] << 24);
+                if ((crc != stream->crc) || (size != (uint32_t) stream->output_size)) {
+                    ESP_LOGE(TAG, "Trailer mismatch, CRC %08x and size %u, expected %08x and %u", crc, size, stream->crc, stream->output_size);
+                    return false;
+                }
+            }
+            stream->state = GZIP_DONE;
+            return true;
+        default:
+            return false;  // Data after the end of the stream
+    }
+}
+
+// Inflate as much of the input as possible, returns the amount of input consumed or -1 on error
+static int inflate_data(gzip_stream_t* stream, const uint8_t* data, size_t length) {
+    size_t consumed = 0;
+    while (true) {
+        size_t       in_size  = length - consumed;
+        size_t       out_size = TINFL_LZ_DICT_SIZE - stream->dictionary_offset;
+        uint8_t*     out      = &stream->dictionary[stream->dictionary_offset];
+        tinfl_status status   = tinfl_decompress(&stream->inflator, &data[consumed], &in_size, stream->dictionary, out, &out_size, TINFL_FLAG_HAS_MORE_INPUT);
+        consumed += in_size;
+
+        if (out_size > 0) {
+            stream->crc = esp_rom_crc32_le(stream->crc, out, out_size);
+            if (!stream->output(out, out_size, stream->output_size, 0, stream->user)) return -1;
+            stream->output_size += out_size;
+            stream->dictionary_offset = (stream->dictionary_offset + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE) {
+            stream->state    = GZIP_TRAILER;
+            stream->position = 0;
+            // The inflater in ROM (miniz 1.15) reads ahead: whole bytes left in its bit buffer belong to the trailer.
+            // They are the last bytes it consumed, earliest in the lowest bits. Those from this call are handed back
+            // by consuming less, those from an earlier call are only in the bit buffer.
+            size_t   lookahead = stream->inflator.m_num_bits >> 3;
+            size_t   handback  = (lookahead < consumed) ? lookahead : consumed;
+            uint32_t bits      = stream->inflator.m_bit_buf >> (stream->inflator.m_num_bits & 7);
+            for (size_t index = 0; index < lookahead - handback; index++) {
+                if (!parse_byte(stream, (bits >> (8 * index)) & 0xFF)) return -1;
+            }
+            stream->inflator.m_num_bits = 0;
+            stream->inflator.m_bit_buf  = 0;
+            return consumed - handback;
+        }
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed (%d)", status);
+            return -1;
+        }
+        // Keep going while the inflater has output left or can make progress with the remaining input
+        if ((status == TINFL_STATUS_NEEDS_MORE_INPUT) && (consumed >= length)) return consumed;
+    }
+}
+
+bool gzip_stream_feed(gzip_stream_t* stream, const uint8_t* data, size_t length) {
+    size_t position = 0;
+    while (position < length) {
+        if (stream->state == GZIP_ERROR) return false;
+        if (stream->state == GZIP_DATA) {
+            int consumed = inflate_data(stream, &data[position], length - position);
+            if (consumed < 0) {
+                stream->state = GZIP_ERROR;
+                return false;
+            }
+            position += consumed;
+        } else {
+            if (!parse_byte(stream, data[position++])) {
+                stream->state = GZIP_ERROR;
+                return false;
+            }
+        }
+    }
+    return stream->state != GZIP_ERROR;
+}
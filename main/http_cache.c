@@ -0,0 +1,318 @@
+#include "http_cache.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char* TAG = "HTTP cache";
+
+#define HTTP_CACHE_MAGIC        0x48434331  // "HCC1"
+#define HTTP_CACHE_REPLAY_CHUNK 1024
+
+// Stored in <hash>.hdr next to the body in <hash>.dat
+typedef struct {
+    uint32_t                magic;
+    uint32_t                size;    // Size of the body
+    uint32_t                access;  // Value of the access counter when the response was last used
+    char                    url[160];
+    http_cache_validators_t validators;
+} http_cache_header_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t size;
+    uint32_t access;
+    int64_t  validated;  // Time at which the response was last confirmed by the server since boot, 0 if it wasn't
+} http_cache_index_t;
+
+static portMUX_TYPE       cache_init_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t  cache_mutex     = NULL;
+static bool               cache_loaded    = false;
+static http_cache_index_t cache_index[HTTP_CACHE_MAX_ENTRIES];
+static size_t             cache_count  = 0;
+static uint32_t           cache_access = 0;  // Increasing counter used to order responses by last use
+static size_t             cache_total  = 0;
+
+static uint32_t url_hash(const char* url) { return esp_rom_crc32_le(0, (const uint8_t*) url, strlen(url)); }
+
+static void cache_path(char* buffer, size_t buffer_size, uint32_t hash, const char* extension) {
+    snprintf(buffer, buffer_size, HTTP_CACHE_PATH "/%08x.%s", hash, extension);
+}
+
+static bool read_header(uint32_t hash, http_cache_header_t* header) {
+    char path[64];
+    cache_path(path, sizeof(path), hash, "hdr");
+    FILE* fd = fopen(path, "rb");
+    if (fd == NULL) return false;
+    bool success = (fread(header, sizeof(http_cache_header_t), 1, fd) == 1) && (header->magic == HTTP_CACHE_MAGIC);
+    fclose(fd);
+    return success;
+}
+
+static bool write_header(uint32_t hash, const http_cache_header_t* header) {
+    char path[64];
+    cache_path(path, sizeof(path), hash, "hdr");
+    FILE* fd = fopen(path, "wb");
+    if (fd == NULL) return false;
+    bool success = (fwrite(header, sizeof(http_cache_header_t), 1, fd) == 1);
+    fclose(fd);
+    return success;
+}
+
+static void remove_files(uint32_t hash) {
+    char path[64];
+    cache_path(path, sizeof(path), hash, "hdr");
+    remove(path);
+    cache_path(path, sizeof(path), hash, "dat");
+    remove(path);
+}
+
+static http_cache_index_t* find_index(uint32_t hash) {
+    for (size_t index = 0; index < cache_count; index++) {
+        if (cache_index[index].hash == hash) return &cache_index[index];
+    }
+    return NULL;
+}
+
+static void remove_index(http_cache_index_t* entry) {
+    remove_files(entry->hash);
+    cache_total -= entry->size;
+    *entry = cache_index[--cache_count];
+}
+
+// Build the in-memory index from the headers on the filesystem, called with the mutex held
+static void load_index() {
+    if (cache_loaded) return;
+    cache_loaded = true;
+    mkdir(HTTP_CACHE_PATH, 0777);
+    DIR* dir = opendir(HTTP_CACHE_PATH);
+    if (dir == NULL) {
+        ESP_LOGE(TAG, "Failed to open cache directory");
+        return;
+    }
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        uint32_t hash;
+        char     extension[4];
+        if (sscanf(ent->d_name, "%08x.%3s", &hash, extension) != 2) continue;
+        if (strcasecmp(extension, "tmp") == 0) {
+            char path[64];
+            cache_path(path, sizeof(path), hash, "tmp");
+            remove(path);  // Left behind by an interrupted download
+            continue;
+        }
+        if (strcasecmp(extension, "hdr") != 0) continue;
+        http_cache_header_t header;
+        if ((!read_header(hash, &header)) || (cache_count >= HTTP_CACHE_MAX_ENTRIES)) {
+            remove_files(hash);
+            continue;
+        }
+        cache_index[cache_count].hash   = hash;
+        cache_index[cache_count].size   = header.size;
+        cache_index[cache_count].access    = header.access;
+        cache_index[cache_count].validated = 0;
+        cache_count++;
+        cache_total += header.size;
+        if (header.access > cache_access) cache_access = header.access;
+    }
+    closedir(dir);
+    ESP_LOGI(TAG, "%u cached responses, %u bytes", cache_count, cache_total);
+}
+
+static void cache_lock() {
+    if (cache_mutex == NULL) {
+        portENTER_CRITICAL(&cache_init_lock);
+        if (cache_mutex == NULL) cache_mutex = xSemaphoreCreateMutex();
+        portEXIT_CRITICAL(&cache_init_lock);
+    }
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    load_index();
+}
+
+static void cache_unlock() { xSemaphoreGive(cache_mutex); }
+
+// Look up the header for `url`, called with the mutex held
+static bool lookup(const char* url, http_cache_header_t* header) {
+    uint32_t            hash  = url_hash(url);
+    http_cache_index_t* entry = find_index(hash);
+    if (entry == NULL) return false;
+    if (!read_header(hash, header)) {
+        remove_index(entry);
+        return false;
+    }
+    return (strncmp(header->url, url, sizeof(header->url)) == 0);
+}
+
+bool http_cache_get_validators(const char* url, http_cache_validators_t* validators) {
+    http_cache_header_t header;
+    cache_lock();
+    bool found = lookup(url, &header);
+    cache_unlock();
+    if (found && (validators != NULL)) memcpy(validators, &header.validators, sizeof(http_cache_validators_t));
+    return found;
+}
+
+bool http_cache_is_fresh(const char* url) {
+    http_cache_header_t header;
+    cache_lock();
+    http_cache_index_t* entry = find_index(url_hash(url));
+    bool                fresh = (entry != NULL) && (entry->validated != 0) && ((esp_timer_get_time() - entry->validated) < (HTTP_CACHE_FRESH_TIME_MS * 1000LL));
+    fresh                     = fresh && lookup(url, &header);
+    cache_unlock();
+    return fresh;
+}
+
+void http_cache_mark_validated(const char* url) {
+    http_cache_header_t header;
+    cache_lock();
+    if (lookup(url, &header)) find_index(url_hash(url))->validated = esp_timer_get_time();
+    cache_unlock();
+}
+
+bool http_cache_load(const char* url, uint8_t** ptr, size_t* size) {
+    http_cache_header_t header;
+    cache_lock();
+    if (!lookup(url, &header)) {
+        cache_unlock();
+        return false;
+    }
+
+    uint32_t hash = url_hash(url);
+    char     path[64];
+    cache_path(path, sizeof(path), hash, "dat");
+    uint8_t* data    = malloc(header.size > 0 ? header.size : 1);
+    FILE*    fd      = fopen(path, "rb");
+    bool     success = (data != NULL) && (fd != NULL) && (fread(data, 1, header.size, fd) == header.size);
+    if (fd != NULL) fclose(fd);
+
+    if (!success) {
+        ESP_LOGW(TAG, "Failed to read cached response for %s", url);
+        free(data);
+        http_cache_index_t* entry = find_index(hash);
+        if ((entry != NULL) && (data != NULL)) remove_index(entry);  // Corrupted, not out of memory
+        cache_unlock();
+        return false;
+    }
+
+    // Mark as most recently used
+    header.access = ++cache_access;
+    write_header(hash, &header);
+    find_index(hash)->access = header.access;
+    cache_unlock();
+
+    *ptr = data;
+    if (size != NULL) *size = header.size;
+    return true;
+}
+
+FILE* http_cache_store_begin(const char* url) {
+    if (strlen(url) >= sizeof(((http_cache_header_t*) 0)->url)) return NULL;
+    char path[64];
+    cache_path(path, sizeof(path), url_hash(url), "tmp");
+    cache_lock();  // Makes sure the cache directory exists
+    cache_unlock();
+    FILE* fd = fopen(path, "wb");
+    if (fd == NULL) ESP_LOGE(TAG, "Failed to open %s", path);
+    return fd;
+}
+
+bool http_cache_store_end(const char* url, FILE* fd, size_t size, const http_cache_validators_t* validators, bool commit) {
+    if (fd == NULL) return false;
+    uint32_t hash = url_hash(url);
+    char     temp_path[64];
+    cache_path(temp_path, sizeof(temp_path), hash, "tmp");
+    bool success = (fclose(fd) == 0) && commit && (size <= HTTP_CACHE_BUDGET);
+    if (!success) {
+        remove(temp_path);
+        return false;
+    }
+
+    cache_lock();
+
+    http_cache_index_t* existing = find_index(hash);
+    if (existing != NULL) remove_index(existing);
+
+    // Evict the least recently used responses until the new one fits
+    while ((cache_count > 0) && ((cache_count >= HTTP_CACHE_MAX_ENTRIES) || (cache_total + size > HTTP_CACHE_BUDGET))) {
+        http_cache_index_t* oldest = &cache_index[0];
+        for (size_t index = 1; index < cache_count; index++) {
+            if (cache_index[index].access < oldest->access) oldest = &cache_index[index];
+        }
+        ESP_LOGD(TAG, "Evicting %08x (%u bytes)", oldest->hash, oldest->size);
+        remove_index(oldest);
+    }
+
+    char path[64];
+    cache_path(path, sizeof(path), hash, "dat");
+    remove(path);
+    success = (rename(temp_path, path) == 0);
+
+    http_cache_header_t header = {0};
+    header.magic               = HTTP_CACHE_MAGIC;
+    header.size                = size;
+    header.access              = ++cache_access;
+    strcpy(header.url, url);
+    if (validators != NULL) memcpy(&header.validators, validators, sizeof(http_cache_validators_t));
+    success = success && write_header(hash, &header);  // The header is written last so a partial body is never used
+
+    if (success) {
+        cache_index[cache_count].hash      = hash;
+        cache_index[cache_count].size      = size;
+        cache_index[cache_count].access    = header.access;
+        cache_index[cache_count].validated = esp_timer_get_time();
+        cache_count++;
+        cache_total += size;
+    } else {
+        ESP_LOGE(TAG, "Failed to store response for %s", url);
+        remove(temp_path);
+        remove_files(hash);
+    }
+    cache_unlock();
+    return success;
+}
+
+bool http_cache_store(const char* url, const uint8_t* data, size_t size, const http_cache_validators_t* validators) {
+    if ((data == NULL) || (size > HTTP_CACHE_BUDGET)) return false;
+    FILE* fd = http_cache_store_begin(url);
+    if (fd == NULL) return false;
+    bool written = (fwrite(data, 1, size, fd) == size);
+    return http_cache_store_end(url, fd, size, validators, written);
+}
+
+bool http_cache_replay(const char* url, download_data_cb_t callback, void* user) {
+    http_cache_header_t header;
+    cache_lock();
+    bool found = lookup(url, &header);
+    cache_unlock();
+    if (!found) return false;
+
+    char path[64];
+    cache_path(path, sizeof(path), url_hash(url), "dat");
+    FILE* fd = fopen(path, "rb");
+    if (fd == NULL) return false;
+    uint8_t* buffer = malloc(HTTP_CACHE_REPLAY_CHUNK);
+    if (buffer == NULL) {
+        fclose(fd);
+        return false;
+    }
+    size_t offset  = 0;
+    bool   success = true;
+    while (success && (offset < header.size)) {
+        size_t length = fread(buffer, 1, HTTP_CACHE_REPLAY_CHUNK, fd);
+        if (length == 0) break;
+        success = callback(buffer, length, offset, header.size, user);
+        offset += length;
+    }
+    free(buffer);
+    fclose(fd);
+    return success && (offset == header.size);
+}
@@ -1,3 +1,4 @@
+#include "download_writer.h"
 #include "esp_event.h"
 #include "esp_http_client.h"
 #include "esp_system.h"
@@ -6,7 +7,12 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
+#include "gzip_stream.h"
 #include "hardware.h"
+#include "http_cache.h"
+#include "http_pool.h"
+#include "http_timing.h"
+#include "mirrors.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "pax_codecs.h"
@@ -15,24 +21,162 @@
 #include "soc/rtc_cntl_reg.h"
 #include "wifi_connect.h"
 #include "wifi_connection.h"
+#include "wifi_session.h"
 
 static const char* TAG = "HTTP download";
 
+#define DOWNLOAD_MAX_FAILURES    3      // Consecutive attempts without progress before giving up
+#define DOWNLOAD_MAX_ATTEMPTS    10     // Attempts in total, also when every attempt makes progress
+#define DOWNLOAD_BACKOFF_BASE_MS 1000   // Delay before the first retry
+#define DOWNLOAD_BACKOFF_MAX_MS  16000  // Upper limit of the delay between retries
+
+// State carried from a failed attempt to the next, to continue where it stopped
+typedef struct {
+    size_t                  offset;      // Amount of data received in earlier attempts
+    size_t                  size;        // Size of the complete body
+    http_cache_validators_t validators;  // ETag and Last-Modified of the partial body
+} download_resume_t;
+
 typedef struct {
-    FILE*     fd;                // For downloading directly to file on filesystem
-    uint8_t** buffer;            // Dynamically allocated buffer for downloading to RAM (malloced in event handler, used if fd is not set)
-    size_t    size;              // File size as indicated by content-length header (set in event handler)
-    size_t    received;          // Amount of data received (set in event handler)
-    bool      error;             // Indication that an error event happened (set in event handler)
-    bool      connected;         // Indication that the HTTP client has connected to the server (set in event handler)
-    bool      finished;          // Indication that the operation has completed (set in event handler)
-    bool      disconnected;      // Indication that the HTTP client has disconnected from the server (set in event handler)
-    bool      out_of_memory;     // Indication that malloc failed
-    bool      out_of_allocated;  // Indication that the server sent more data than indicated with the content-length header
+    download_writer_t*      writer;             // For downloading directly to file on filesystem
+    uint8_t**               buffer;             // Dynamically allocated buffer for downloading to RAM (malloced in event handler, used if fd is not set)
+    size_t                  allocated;          // Size of the buffer
+    size_t                  size;               // Size of the complete body, offset plus the content-length header (set in event handler)
+    size_t                  content_length;     // Value of the content-length header (set in event handler)
+    size_t                  received;           // Amount of data received, including data received in earlier attempts (set in event handler)
+    size_t                  offset;             // Amount of data requested to be skipped with a range header
+    size_t                  range_start;        // Start of the range in the content-range header (set in event handler)
+    size_t                  range_total;        // Complete size in the content-range header (set in event handler)
+    bool                    body_started;       // The first chunk of the body has been received (set in event handler)
+    bool                    gzip;               // The response is gzip encoded, size is not known until the body has been inflated (set in event handler)
+    gzip_stream_t*          inflater;           // Decoder for a gzip encoded body (created in event handler)
+    bool                    error;              // Indication that an error event happened (set in event handler)
+    bool                    aborted;            // The callback or the writer rejected the data, retrying won't help (set in event handler)
+    bool                    offline;            // Not attempted because WiFi is not connected
+    bool                    connected;          // Indication that the HTTP client has connected to the server (set in event handler)
+    bool                    finished;           // Indication that the operation has completed (set in event handler)
+    bool                    disconnected;       // Indication that the HTTP client has disconnected from the server (set in event handler)
+    bool                    out_of_memory;      // Indication that malloc failed
+    bool                    out_of_allocated;   // Indication that the server sent more data than indicated with the content-length header
+    int                     status;             // HTTP status code of the response
+    download_data_cb_t      callback;           // For streaming the response to a callback (used if fd and buffer are not set)
+    void*                   callback_user;      // User data for the callback
+    FILE*                   tee;                // Copy of the streamed response for the cache
+    size_t*                 progress;           // Updated with the amount of data received while downloading, optional
+    http_cache_validators_t validators;         // ETag and Last-Modified headers of the response (set in event handler)
+    const char*             post_data;          // Body of a POST request, the request is a GET request if not set
+    size_t                  post_length;        // Size of the body of the POST request
+    const char*             content_type;       // Content type of the body of the POST request
+    http_timing_t           timing;             // Timestamps of the phases of the request (set in event handler)
 } http_download_info_t;
 
+static bool inflated(const uint8_t* data, size_t length, size_t offset, size_t total, void* user);
+
+// Called for the first chunk of the body, at which point the status code is known
+static bool body_start(http_download_info_t* info, esp_http_client_handle_t client) {
+    info->body_started = true;
+    int status         = esp_http_client_get_status_code(client);
+    if ((status != 200) && (status != 206)) {
+        ESP_LOGW(TAG, "Ignoring body of response with status %d", status);
+        return false;
+    }
+
+    if (info->offset > 0) {
+        bool resumed = (status == 206) && (info->range_start == info->offset);
+        if (!resumed) {
+            // The file changed or the server doesn't support ranges, it sent the complete body instead
+            ESP_LOGW(TAG, "Unable to resume at %u, starting over", info->offset);
+            info->offset   = 0;
+            info->received = 0;
+            if ((info->writer != NULL) && (!download_writer_seek(info->writer, 0))) return false;
+        } else {
+            ESP_LOGI(TAG, "Resuming at %u", info->offset);
+        }
+    } else if (status == 206) {
+        return false;  // Not requested
+    }
+    if (info->gzip && (info->offset > 0)) return false;  // Ranges of an encoded body can't be decoded
+    info->size = info->offset + info->content_length;
+    if ((info->writer != NULL) && (info->content_length > 0) && (!info->gzip)) {
+        download_writer_preallocate(info->writer, info->size);  // Only an optimization, the file is extended while writing otherwise
+    }
+
+    if (info->gzip) {
+        info->inflater = gzip_stream_create(inflated, info);
+        if (info->inflater == NULL) {
+            info->out_of_memory = true;
+            return false;
+        }
+    }
+
+    if ((info->buffer != NULL) && (*info->buffer != NULL) && (info->offset == 0)) {
+        free(*info->buffer);  // Partial body of an earlier attempt
+        *info->buffer   = NULL;
+        info->allocated = 0;
+    }
+    // The size of a gzip encoded body is estimated, the buffer grows while it is inflated
+    size_t size = info->gzip ? (info->content_length * 4) : info->size;
+    if ((info->buffer != NULL) && (size > info->allocated)) {
+        uint8_t* buffer = realloc(*info->buffer, size);
+        printf("BUFFER MALLOC'ED (%u bytes)\r\n", size);
+        if (buffer == NULL) {
+            info->out_of_memory = true;
+            return false;
+        }
+        *info->buffer   = buffer;
+        info->allocated = size;
+    }
+    return true;
+}
+
+// Store a chunk of the (decoded) body
+static bool write_body(http_download_info_t* info, const uint8_t* data, size_t length) {
+    if (info->writer != NULL) {  // Write directly to file on filesystem
+        if (!download_writer_write(info->writer, data, length)) {
+            info->aborted = true;
+            return false;
+        }
+    } else if (info->buffer != NULL) {
+        if ((info->received + length > info->allocated) && info->gzip) {
+            size_t size = (info->allocated > 0) ? info->allocated : 4096;
+            while (info->received + length > size) size *= 2;
+            uint8_t* buffer = realloc(*info->buffer, size);
+            if (buffer == NULL) {
+                info->out_of_memory = true;
+                return false;
+            }
+            *info->buffer   = buffer;
+            info->allocated = size;
+        }
+        if (info->received + length <= info->allocated) {
+            memcpy(&((*info->buffer)[info->received]), data, length);
+        } else {
+            printf("Downloaded too much? %u with %u in content-length header\r\n", info->received + length, info->size);
+            info->out_of_allocated = true;
+            return false;
+        }
+    } else if (info->callback != NULL) {
+        if (info->tee != NULL) fwrite(data, 1, length, info->tee);
+        size_t total = ((info->content_length > 0) && (!info->gzip)) ? info->size : 0;
+        if (!info->callback(data, length, info->received, total, info->callback_user)) {
+            info->aborted = true;
+            return false;
+        }
+    } else {
+        return false;
+    }
+    info->received += length;
+    if (info->progress != NULL) *info->progress = info->received;
+    return true;
+}
+
+static bool inflated(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    return write_body((http_download_info_t*) user, data, length);
+}
+
 static esp_err_t _event_handler(esp_http_client_event_t* evt) {
     http_download_info_t* info = (http_download_info_t*) evt->user_data;
+    http_timing_event(&info->timing, evt);
     switch (evt->event_id) {
         case HTTP_EVENT_ERROR:
             info->error = true;
@@ -48,39 +192,40 @@ static esp_err_t _event_handler(esp_http_client_event_t* evt) {
                 if ((strlen(evt->header_key) == strlen(content_length_key)) &&
                     (strncasecmp(content_length_key, evt->header_key, strlen(content_length_key)) == 0)) {
                     // Header value is content length
-                    info->size = atoi(evt->header_value);
-                    printf("SIZE KNOWN: %u bytes\r\n", info->size);
-                    if ((info->size > 0) && (info->buffer != NULL)) {  // Buffer poiner is set, buffer pointer points to NULL
-                        *info->buffer = malloc(info->size);
-                        printf("BUFFER MALLOC'ED (%u bytes)\r\n", info->size);
-                        if (*info->buffer == NULL) {
-                            info->out_of_memory = true;
-                            return ESP_ERR_NO_MEM;
-                        }
+                    info->content_length = atoi(evt->header_value);
+                    printf("SIZE KNOWN: %u bytes\r\n", info->content_length);
+                } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+                    unsigned int start = 0, end = 0, total = 0;
+                    if (sscanf(evt->header_value, "bytes %u-%u/%u", &start, &end, &total) == 3) {
+                        info->range_start = start;
+                        info->range_total = total;
                     }
+                } else if (strcasecmp(evt->header_key, "Content-Encoding") == 0) {
+                    info->gzip = (strcasecmp(evt->header_value, "gzip") == 0);
+                } else if (strcasecmp(evt->header_key, "ETag") == 0) {
+                    strncpy(info->validators.etag, evt->header_value, sizeof(info->validators.etag) - 1);
+                } else if (strcasecmp(evt->header_key, "Last-Modified") == 0) {
+                    strncpy(info->validators.last_modified, evt->header_value, sizeof(info->validators.last_modified) - 1);
                 } else {
                     // printf("HTTP_EVENT_ON_HEADER, key=%s, value=%s\r\n", evt->header_key, evt->header_value);
                 }
                 break;
             }
         case HTTP_EVENT_ON_DATA:
-            if (info->fd != NULL) {  // Write directly to file on filesystem
-                printf("Writing to FILE @ %p (%u bytes): %u of %u bytes.\r\n", info->fd, evt->data_len, info->received + evt->data_len, info->size);
-                fwrite(evt->data, 1, evt->data_len, info->fd);
-            } else if (info->buffer != NULL && *info->buffer != NULL) {
-                if (info->received + evt->data_len <= info->size) {
-                    uint8_t* dest = &((*info->buffer)[info->received]);
-                    printf("Writing to RAM @ %p (%u bytes): %u of %u bytes.\r\n", dest, evt->data_len, info->received + evt->data_len, info->size);
-                    memcpy(dest, evt->data, evt->data_len);
-                } else {
-                    printf("Downloaded too much? %u with %u in content-length header\r\n", info->received + evt->data_len, info->size);
-                    info->out_of_allocated = true;
-                    return ESP_ERR_NO_MEM;
-                }
-            } else {
+            if (info->error) return ESP_FAIL;
+            if ((!info->body_started) && (!body_start(info, evt->client))) {
+                info->error = true;
                 return ESP_FAIL;
             }
-            info->received += evt->data_len;
+            {
+                bool written = (info->inflater != NULL) ? gzip_stream_feed(info->inflater, evt->data, evt->data_len) : write_body(info, evt->data, evt->data_len);
+                if (!written) {
+                    // The client ignores the result of this event and would read the rest of the body, closing the connection stops it
+                    info->error = true;
+                    esp_http_client_close(evt->client);
+                    return ESP_FAIL;
+                }
+            }
             break;
         case HTTP_EVENT_ON_FINISH:
             info->finished = true;
@@ -93,58 +238,313 @@ static esp_err_t _event_handler(esp_http_client_event_t* evt) {
 }
 
 static bool download_success(esp_err_t err, http_download_info_t* info) {
-    return (err == ESP_OK) && (!(info->error || info->out_of_allocated || info->out_of_memory)) && info->finished && (info->received == info->size);
+    // Streamed responses don't need a content-length header, the size of gzip encoded responses is only known once they are inflated
+    bool complete;
+    if (info->inflater != NULL) {
+        complete = gzip_stream_finished(info->inflater);
+        if (complete) info->size = info->received;
+    } else {
+        complete = (info->received == info->size) || ((info->callback != NULL) && (info->content_length == 0));
+    }
+    return (err == ESP_OK) && (!(info->error || info->out_of_allocated || info->out_of_memory)) && info->finished && complete;
+}
+
+// Wait before retrying, using capped exponential backoff with jitter so that badges that lost their connection at the same time don't retry in lockstep
+static void download_backoff(int failures) {
+    uint32_t delay = DOWNLOAD_BACKOFF_BASE_MS;
+    while ((failures-- > 1) && (delay < DOWNLOAD_BACKOFF_MAX_MS)) delay *= 2;
+    if (delay > DOWNLOAD_BACKOFF_MAX_MS) delay = DOWNLOAD_BACKOFF_MAX_MS;
+    delay = (delay / 2) + (esp_random() % ((delay / 2) + 1));
+    printf("DL waiting %u ms to retry ...\r\n", delay);
+    vTaskDelay(pdMS_TO_TICKS(delay));
+}
+
+// A client error is the answer to the request itself, asking again gives the same answer.
+// Except for a timeout or rate limit, which only say that the server couldn't answer right now.
+static bool client_error(int status) { return (status >= 400) && (status < 500) && (status != 408) && (status != 429); }
+
+// Decide whether a failed attempt should be retried, waiting if needed.
+// Transport errors and server errors are retried, an attempt that fails on a reused connection right away:
+// the server probably closed the connection while it was idle.
+static bool download_retry(const http_download_info_t* info, int* attempts, int* failures, bool reused, bool progressed) {
+    if (info->aborted || info->offline) return false;  // The same data would be rejected again, or there is nothing to retry over
+    if (client_error(info->status)) return false;
+    if (++(*attempts) >= DOWNLOAD_MAX_ATTEMPTS) return false;
+    if (reused && !progressed) return true;
+    *failures = progressed ? 1 : (*failures + 1);
+    if (*failures > DOWNLOAD_MAX_FAILURES) return false;
+    download_backoff(*failures);
+    return true;
 }
 
-static bool _download_file(const char* url, const char* path) {
-    FILE* fd = fopen(path, "w");
-    if (fd == NULL) {
-        ESP_LOGE(TAG, "Failed to open file");
+static bool can_resume(const download_resume_t* resume) {
+    if ((resume == NULL) || (resume->offset == 0)) return false;
+    bool strong_etag = (resume->validators.etag[0] != '\0') && (strncmp(resume->validators.etag, "W/", 2) != 0);
+    return strong_etag || (resume->validators.last_modified[0] != '\0');
+}
+
+static bool perform(const char* url, http_download_info_t* info, const http_cache_validators_t* conditional, download_resume_t* resume, bool* reused) {
+    if (!wifi_is_connected()) {
+        // The network stack is only initialized when WiFi connects, using it before that asserts. Callers fall back on the cache.
+        ESP_LOGW(TAG, "Not connected, not requesting %s", url);
+        info->offline = true;
         return false;
     }
+    // Callers use the canonical server URLs, the request goes to the selected mirror
+    char mirrored_url[256];
+    mirror_rewrite(url, mirrored_url, sizeof(mirrored_url));
+    esp_http_client_handle_t client = http_pool_acquire(mirrored_url, _event_handler, (void*) info, reused);
+    if (client == NULL) return false;
+    if (conditional != NULL) {
+        if (conditional->etag[0] != '\0') esp_http_client_set_header(client, "If-None-Match", conditional->etag);
+        if (conditional->last_modified[0] != '\0') esp_http_client_set_header(client, "If-Modified-Since", conditional->last_modified);
+    }
+    if (info->post_data != NULL) {
+        esp_http_client_set_method(client, HTTP_METHOD_POST);
+        esp_http_client_set_post_field(client, info->post_data, info->post_length);
+        esp_http_client_set_header(client, "Content-Type", info->content_type);
+    }
+    bool ranged = can_resume(resume);
+    if (ranged) {
+        // If-Range makes the server send the complete body instead of a range when the file has changed
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%u-", resume->offset);
+        esp_http_client_set_header(client, "Range", range);
+        bool strong_etag = (resume->validators.etag[0] != '\0') && (strncmp(resume->validators.etag, "W/", 2) != 0);
+        esp_http_client_set_header(client, "If-Range", strong_etag ? resume->validators.etag : resume->validators.last_modified);
+        info->offset   = resume->offset;
+        info->received = resume->offset;
+    } else {
+        // Not for ranges: those would be ranges of the encoded body, while the offset counts decoded data
+        esp_http_client_set_header(client, "Accept-Encoding", "gzip");
+    }
+    wifi_session_transfer_begin();
+    http_timing_begin(&info->timing, mirrored_url, *reused);
+    esp_err_t err     = esp_http_client_perform(client);
+    bool      success = download_success(err, info);
+    wifi_session_transfer_end();
+    info->status      = esp_http_client_get_status_code(client);
+    http_timing_end(&info->timing, success);
+    if ((err != ESP_OK) || (info->status >= 500)) mirror_report_failure(mirrored_url);
+    // Pooled clients are reused, don't leak the headers into the next request
+    if (conditional != NULL) {
+        esp_http_client_delete_header(client, "If-None-Match");
+        esp_http_client_delete_header(client, "If-Modified-Since");
+    }
+    if (ranged) {
+        esp_http_client_delete_header(client, "Range");
+        esp_http_client_delete_header(client, "If-Range");
+    } else {
+        esp_http_client_delete_header(client, "Accept-Encoding");
+    }
+    if (info->post_data != NULL) {
+        esp_http_client_set_method(client, HTTP_METHOD_GET);
+        esp_http_client_set_post_field(client, NULL, 0);
+        esp_http_client_delete_header(client, "Content-Type");
+    }
+    // The body of an error response is still read completely, only a transport error leaves the connection unusable.
+    // A rejected body closed the connection already, the client is kept for its TLS session.
+    http_pool_release(client, err == ESP_OK);
+    *reused = *reused && (err != ESP_OK);  // Only a transport error can be caused by the server closing the idle connection
+    if (info->inflater != NULL) {
+        gzip_stream_free(info->inflater);
+        info->inflater = NULL;
+    }
+    if ((resume != NULL) && (!success)) {
+        // Keep what was received for the next attempt
+        resume->offset = info->body_started ? info->received : info->offset;
+        resume->size   = info->size;
+        if (info->body_started) memcpy(&resume->validators, &info->validators, sizeof(http_cache_validators_t));
+        if (!can_resume(resume)) resume->offset = 0;
+    }
+    return success;
+}
+
+static bool _download_file(const char* url, download_writer_t* writer, http_download_info_t* info, download_resume_t* resume, bool* reused) {
+    if (!can_resume(resume)) resume->offset = 0;
+    if (!download_writer_open(writer, &resume->offset)) return false;
+    if (info->progress != NULL) *info->progress = resume->offset;
+    info->writer = writer;
+
+    bool success = perform(url, info, NULL, resume, reused);
+    success      = download_writer_close(writer) && success;
+    if (success) resume->size = info->size;
+    return success;
+}
+
+bool download_file_progress(const char* url, const char* path, size_t* progress) {
+    download_writer_t writer;
+    if (!download_writer_init(&writer, path)) return false;
+    download_resume_t resume   = {0};
+    int               attempts = 0;
+    int               failures = 0;
+    while (true) {
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        size_t               before = resume.offset;
+        info.progress               = progress;
+        if (_download_file(url, &writer, &info, &resume, &reused)) return download_writer_commit(&writer, resume.size);
+        if (!download_retry(&info, &attempts, &failures, reused, resume.offset > before)) break;
+    }
+    download_writer_discard(&writer);  // The file that was there before is left untouched
+    return false;
+}
 
-    http_download_info_t info = {0};
-    info.fd                   = fd;
+bool download_file(const char* url, const char* path) { return download_file_progress(url, path, NULL); }
 
-    esp_http_client_config_t config = {
-        .url = url, .use_global_ca_store = true, .keep_alive_enable = true, .timeout_ms = 10000, .user_data = (void*) &info, .event_handler = _event_handler};
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_err_t                err    = esp_http_client_perform(client);
-    fclose(fd);
-    esp_http_client_cleanup(client);
-    return download_success(err, &info);
+bool download_ram(const char* url, uint8_t** ptr, size_t* size) {
+    download_resume_t resume   = {0};
+    int               attempts = 0;
+    int               failures = 0;
+    *ptr                       = NULL;
+    while (true) {
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        size_t               before = resume.offset;
+        info.buffer                 = ptr;
+        if (perform(url, &info, NULL, &resume, &reused)) {
+            if (size != NULL) *size = info.size;
+            printf("Buffer: %p -> %p\r\n", ptr, *ptr);
+            return true;
+        }
+        if (!download_retry(&info, &attempts, &failures, reused, resume.offset > before)) break;
+    }
+    free(*ptr);
+    *ptr = NULL;
+    return false;
+}
+
+bool download_ram_post(const char* url, const char* content_type, const char* data, size_t length, uint8_t** ptr, size_t* size) {
+    *ptr = NULL;
+    while (true) {
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        info.buffer                 = ptr;
+        info.post_data              = data;
+        info.post_length            = length;
+        info.content_type           = content_type;
+        if (perform(url, &info, NULL, NULL, &reused)) {
+            if (size != NULL) *size = info.size;
+            return true;
+        }
+        free(*ptr);
+        *ptr = NULL;
+        if (!reused) return false;  // Only retried on a fresh connection, a POST request is not necessarily idempotent
+    }
 }
 
-bool download_file(const char* url, const char* path) {
-    int retry = 3;
+bool download_ram_cached(const char* url, uint8_t** ptr, size_t* size) {
+    if (http_cache_is_fresh(url) && http_cache_load(url, ptr, size)) return true;
+    http_cache_validators_t validators = {0};
+    bool                    cached     = http_cache_get_validators(url, &validators);
+    int                     retry      = cached ? 1 : 3;  // Don't keep the user waiting when there is a cached copy to fall back on
+    int                     failures   = 0;
     while (retry--) {
-        if (_download_file(url, path)) return true;
-        printf("DL waiting to retry ...");
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        info.buffer                 = ptr;
+        bool success                = perform(url, &info, cached ? &validators : NULL, NULL, &reused);
+        if (success && cached && (info.status == 304)) {
+            ESP_LOGI(TAG, "Not modified: %s", url);
+            http_cache_mark_validated(url);
+            if (http_cache_load(url, ptr, size)) return true;
+            cached = false;  // Cached copy is unreadable, download it again
+            retry  = 3;
+            continue;
+        }
+        if (success && (info.status == 200)) {
+            if (size != NULL) *size = info.size;
+            http_cache_store(url, *ptr, info.size, &info.validators);
+            return true;
+        }
+        if (success) ESP_LOGW(TAG, "Unexpected status %d for %s", info.status, url);
+        free(*ptr);
+        *ptr = NULL;
+        if (client_error(info.status) || info.offline) break;
+        if (reused) {
+            retry++;
+            continue;
+        }
+        if (retry > 0) download_backoff(++failures);
+    }
+    if (cached) {
+        ESP_LOGW(TAG, "Server unreachable, using cached copy of %s", url);
+        return http_cache_load(url, ptr, size);
     }
     return false;
 }
 
-static bool _download_ram(const char* url, uint8_t** ptr, size_t* size) {
-    http_download_info_t info       = {0};
-    info.buffer                     = ptr;
-    esp_http_client_config_t config = {
-        .url = url, .use_global_ca_store = true, .keep_alive_enable = true, .timeout_ms = 10000, .user_data = (void*) &info, .event_handler = _event_handler};
-    esp_http_client_handle_t client  = esp_http_client_init(&config);
-    esp_err_t                err     = esp_http_client_perform(client);
-    bool                     success = download_success(err, &info);
-    if (success && (size != NULL)) *size = info.size;
-    printf("Buffer: %p -> %p\r\n", ptr, *ptr);
-    esp_http_client_cleanup(client);
-    return success;
+bool download_stream(const char* url, download_data_cb_t callback, void* user) {
+    download_resume_t resume   = {0};
+    int               attempts = 0;
+    int               failures = 0;
+    while (true) {
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        size_t               before = resume.offset;
+        info.callback               = callback;
+        info.callback_user          = user;
+        if (perform(url, &info, NULL, &resume, &reused)) return true;
+        if (!download_retry(&info, &attempts, &failures, reused, resume.offset > before)) return false;
+    }
 }
 
-bool download_ram(const char* url, uint8_t** ptr, size_t* size) {
-    int retry = 3;
+bool download_stream_cached(const char* url, download_data_cb_t callback, void* user) {
+    if (http_cache_is_fresh(url) && http_cache_replay(url, callback, user)) return true;
+    http_cache_validators_t validators = {0};
+    bool                    cached     = http_cache_get_validators(url, &validators);
+    int                     retry      = cached ? 1 : 3;
+    int                     failures   = 0;
     while (retry--) {
-        if (_download_ram(url, ptr, size)) return true;
-        printf("DL waiting to retry ...");
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        info.callback               = callback;
+        info.callback_user          = user;
+        info.tee                    = http_cache_store_begin(url);
+        bool success                = perform(url, &info, cached ? &validators : NULL, NULL, &reused);
+        http_cache_store_end(url, info.tee, info.received, &info.validators, success && (info.status == 200));
+        if (success && cached && (info.status == 304)) {
+            ESP_LOGI(TAG, "Not modified: %s", url);
+            http_cache_mark_validated(url);
+            if (http_cache_replay(url, callback, user)) return true;
+            cached = false;  // Cached copy is unreadable, download it again
+            retry  = 3;
+            continue;
+        }
+        if (success && (info.status == 200)) return true;
+        if (info.aborted) return false;  // Rejected by the callback, which already saw part of the body
+        if (success) ESP_LOGW(TAG, "Unexpected status %d for %s", info.status, url);
+        if (client_error(info.status) || info.offline) break;
+        if (reused) {
+            retry++;
+            continue;
+        }
+        if (retry > 0) download_backoff(++failures);
+    }
+    if (cached) {
+        ESP_LOGW(TAG, "Server unreachable, using cached copy of %s", url);
+        return http_cache_replay(url, callback, user);
     }
     return false;
 }
+
+bool download_prefetch(const char* url, download_data_cb_t callback, void* user) {
+    if (http_cache_is_fresh(url)) return true;
+    http_cache_validators_t validators = {0};
+    bool                    cached     = http_cache_get_validators(url, &validators);
+    while (true) {
+        http_download_info_t info   = {0};
+        bool                 reused = false;
+        info.callback               = callback;
+        info.callback_user          = user;
+        info.tee                    = http_cache_store_begin(url);
+        bool success                = perform(url, &info, cached ? &validators : NULL, NULL, &reused);
+        http_cache_store_end(url, info.tee, info.received, &info.validators, success && (info.status == 200));
+        if (success && cached && (info.status == 304)) {
+            http_cache_mark_validated(url);
+            return true;
+        }
+        if (success && (info.status == 200)) return true;
+        if (success || info.aborted || (!reused)) return false;
+    }
+}
@@ -0,0 +1,219 @@
+#include "http_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "wifi_cert.h"
+
+static const char* TAG = "HTTP pool";
+
+typedef struct {
+    esp_http_client_handle_t client;         // NULL if the slot is free
+    char                     host[64];       // Host the connection was made to
+    int                      port;           // Port the connection was made to
+    http_event_handle_cb     event_handler;  // Event handler of the current request
+    void*                    user_data;      // User data of the current request
+    bool                     in_use;         // Handed out by http_pool_acquire
+    bool                     open;           // Connection was left open after the last request
+    bool                     connected;      // The client is connected, cleared when it or the server closed the connection (set in event handler)
+    int64_t                  keep_alive;     // Time the server keeps an idle connection open according to its Keep-Alive header, 0 if unknown (microseconds)
+    int64_t                  last_used;      // Time at which the client was released (microseconds)
+} http_pool_entry_t;
+
+static portMUX_TYPE      pool_init_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t pool_mutex     = NULL;
+static http_pool_entry_t pool[HTTP_POOL_SIZE];
+static uint32_t          pool_connections = 0;
+static uint32_t          pool_reuses      = 0;
+
+// Events are passed through the pool so that new connections can be counted,
+// the user data of the client always points to its pool entry.
+static esp_err_t pool_event_handler(esp_http_client_event_t* evt) {
+    http_pool_entry_t* entry = (http_pool_entry_t*) evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED) {
+        pool_connections++;
+        entry->connected  = true;
+        entry->keep_alive = 0;
+    } else if (evt->event_id == HTTP_EVENT_DISCONNECTED) {
+        entry->connected = false;
+    } else if ((evt->event_id == HTTP_EVENT_ON_HEADER) && (strcasecmp(evt->header_key, "Keep-Alive") == 0)) {
+        const char* timeout = strstr(evt->header_value, "timeout=");
+        if (timeout != NULL) entry->keep_alive = atoi(&timeout[8]) * 1000000LL;
+    }
+    if (entry->event_handler == NULL) return ESP_OK;
+    evt->user_data = entry->user_data;
+    esp_err_t res  = entry->event_handler(evt);
+    evt->user_data = entry;
+    return res;
+}
+
+static bool parse_host(const char* url, char* host, size_t host_size, int* port) {
+    const char* start = strstr(url, "://");
+    if (start == NULL) return false;
+    *port = (strncasecmp(url, "https", 5) == 0) ? 443 : 80;
+    start += 3;
+    size_t length = strcspn(start, ":/?#");
+    if ((length == 0) || (length >= host_size)) return false;
+    memcpy(host, start, length);
+    host[length] = '\0';
+    if (start[length] == ':') *port = atoi(&start[length + 1]);
+    return true;
+}
+
+static void pool_lock() {
+    if (pool_mutex == NULL) {
+        portENTER_CRITICAL(&pool_init_lock);
+        if (pool_mutex == NULL) pool_mutex = xSemaphoreCreateMutex();
+        portEXIT_CRITICAL(&pool_init_lock);
+    }
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+}
+
+static void pool_unlock() { xSemaphoreGive(pool_mutex); }
+
+// Check an idle connection before handing it out. A request on a connection the server has closed fails,
+// so connections are given up shortly before the server's keep-alive timeout instead of finding out the hard way.
+static bool connection_alive(const http_pool_entry_t* entry, int64_t now) {
+    if ((!entry->open) || (!entry->connected)) return false;
+    return (entry->keep_alive == 0) || ((now - entry->last_used) < (entry->keep_alive - (int64_t) HTTP_POOL_KEEP_ALIVE_MARGIN_MS * 1000));
+}
+
+static void close_entry(http_pool_entry_t* entry) {
+    ESP_LOGD(TAG, "Closing connection to %s:%d", entry->host, entry->port);
+    esp_http_client_cleanup(entry->client);
+    memset(entry, 0, sizeof(http_pool_entry_t));
+}
+
+// Closing the connection keeps the client and its saved TLS session, the client itself
+// is only destroyed once the session has expired.
+static void close_idle_entries(int64_t max_idle) {
+    int64_t now = esp_timer_get_time();
+    for (size_t index = 0; index < HTTP_POOL_SIZE; index++) {
+        http_pool_entry_t* entry = &pool[index];
+        if ((entry->client == NULL) || entry->in_use) continue;
+        int64_t idle = now - entry->last_used;
+        if (idle >= (int64_t) HTTP_POOL_SESSION_TIMEOUT_MS * 1000) {
+            close_entry(entry);
+        } else if (entry->open && ((idle >= max_idle) || (!connection_alive(entry, now)))) {
+            esp_http_client_close(entry->client);
+            entry->open = false;
+        }
+    }
+}
+
+static http_pool_entry_t* find_free_entry() {
+    http_pool_entry_t* oldest = NULL;
+    for (size_t index = 0; index < HTTP_POOL_SIZE; index++) {
+        http_pool_entry_t* entry = &pool[index];
+        if (entry->client == NULL) return entry;
+        if ((!entry->in_use) && ((oldest == NULL) || (entry->last_used < oldest->last_used))) {
+            oldest = entry;
+        }
+    }
+    if (oldest != NULL) close_entry(oldest);  // Make room by dropping the least recently used idle connection
+    return oldest;
+}
+
+esp_http_client_handle_t http_pool_acquire(const char* url, http_event_handle_cb event_handler, void* user_data, bool* reused) {
+    char host[sizeof(((http_pool_entry_t*) 0)->host)];
+    int  port = 0;
+    if (reused != NULL) *reused = false;
+    if (!parse_host(url, host, sizeof(host), &port)) {
+        ESP_LOGE(TAG, "Failed to parse host from URL %s", url);
+        return NULL;
+    }
+    if (init_ca_store() != ESP_OK) return NULL;
+
+    pool_lock();
+    close_idle_entries((int64_t) HTTP_POOL_IDLE_TIMEOUT_MS * 1000);
+
+    for (size_t index = 0; index < HTTP_POOL_SIZE; index++) {
+        http_pool_entry_t* entry = &pool[index];
+        if ((entry->client == NULL) || entry->in_use || (entry->port != port) || (strcasecmp(entry->host, host) != 0)) continue;
+        if (esp_http_client_set_url(entry->client, url) != ESP_OK) {
+            close_entry(entry);
+            continue;
+        }
+        bool alive = connection_alive(entry, esp_timer_get_time());
+        if (entry->open && (!alive)) esp_http_client_close(entry->client);  // The next request connects again
+        if (alive) pool_reuses++;
+        if (reused != NULL) *reused = alive;
+        entry->in_use        = true;
+        entry->open          = false;
+        entry->event_handler = event_handler;
+        entry->user_data     = user_data;
+        pool_unlock();
+        return entry->client;
+    }
+
+    http_pool_entry_t* entry = find_free_entry();
+    if (entry == NULL) {
+        pool_unlock();
+        ESP_LOGE(TAG, "All %d connections are in use", HTTP_POOL_SIZE);
+        return NULL;
+    }
+
+    esp_http_client_config_t config = {
+        .url                 = url,
+        .use_global_ca_store = true,
+        .keep_alive_enable   = true,
+        .timeout_ms          = 10000,
+        .user_data           = (void*) entry,
+        .event_handler       = pool_event_handler,
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,  // The transport keeps the session ticket for the next connection to this host
+#endif
+    };
+    entry->client = esp_http_client_init(&config);
+    if (entry->client == NULL) {
+        pool_unlock();
+        ESP_LOGE(TAG, "Failed to create client for %s", url);
+        return NULL;
+    }
+    strcpy(entry->host, host);
+    entry->port          = port;
+    entry->in_use        = true;
+    entry->event_handler = event_handler;
+    entry->user_data     = user_data;
+    pool_unlock();
+    return entry->client;
+}
+
+void http_pool_release(esp_http_client_handle_t client, bool healthy) {
+    if (client == NULL) return;
+    pool_lock();
+    for (size_t index = 0; index < HTTP_POOL_SIZE; index++) {
+        http_pool_entry_t* entry = &pool[index];
+        if (entry->client != client) continue;
+        if (healthy) {
+            entry->in_use        = false;
+            entry->open          = entry->connected;  // The server may have asked to close the connection
+            entry->event_handler = NULL;
+            entry->user_data     = NULL;
+            entry->last_used     = esp_timer_get_time();
+        } else {
+            close_entry(entry);
+        }
+        break;
+    }
+    pool_unlock();
+}
+
+void http_pool_flush() {
+    pool_lock();
+    close_idle_entries(0);
+    pool_unlock();
+}
+
+void http_pool_get_stats(uint32_t* connections, uint32_t* reuses) {
+    if (connections != NULL) *connections = pool_connections;
+    if (reuses != NULL) *reuses = pool_reuses;
+}
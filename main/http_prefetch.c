@@ -0,0 +1,131 @@
+#include "http_prefetch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "http_download.h"
+
+static const char* TAG = "HTTP prefetch";
+
+#define HTTP_PREFETCH_STACK    8192  // TLS handshakes need a lot of stack
+#define HTTP_PREFETCH_PRIORITY (tskIDLE_PRIORITY + 1)
+#define HTTP_PREFETCH_POLL_MS  20
+
+static portMUX_TYPE      prefetch_lock       = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t      prefetch_task       = NULL;
+static volatile bool     prefetch_quit       = false;
+static volatile bool     prefetch_urgent     = false;  // The foreground is waiting for the running prefetch
+static volatile uint32_t prefetch_generation = 0;      // Incremented to cancel the running prefetch
+static char              prefetch_pending[160];        // URL waiting to be fetched, empty if there is none
+static char              prefetch_running[160];        // URL being fetched, empty if there is none
+
+typedef struct {
+    uint32_t generation;
+    int64_t  started;
+} http_prefetch_state_t;
+
+static bool prefetch_cancelled(const http_prefetch_state_t* state) { return prefetch_quit || (prefetch_generation != state->generation); }
+
+static bool prefetch_receive(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    http_prefetch_state_t* state = (http_prefetch_state_t*) user;
+    if (prefetch_cancelled(state)) return false;
+    if ((total > HTTP_PREFETCH_MAX_SIZE) || (offset + length > HTTP_PREFETCH_MAX_SIZE)) {
+        ESP_LOGD(TAG, "Response too large to prefetch");
+        return false;
+    }
+    // Throttle by not reading from the connection until the data received so far fits in the bandwidth budget
+    int64_t due = state->started + ((int64_t) (offset + length) * 1000000LL) / HTTP_PREFETCH_RATE;
+    while ((!prefetch_urgent) && (esp_timer_get_time() < due)) {
+        if (prefetch_cancelled(state)) return false;
+        vTaskDelay(pdMS_TO_TICKS(HTTP_PREFETCH_POLL_MS));
+    }
+    return true;
+}
+
+static void prefetch_main(void* arg) {
+    while (!prefetch_quit) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        http_prefetch_state_t state;
+        portENTER_CRITICAL(&prefetch_lock);
+        strcpy(prefetch_running, prefetch_pending);
+        prefetch_pending[0] = '\0';
+        prefetch_urgent     = false;
+        state.generation    = prefetch_generation;
+        portEXIT_CRITICAL(&prefetch_lock);
+        if ((prefetch_running[0] == '\0') || prefetch_quit) continue;
+
+        state.started = esp_timer_get_time();
+        bool success  = download_prefetch(prefetch_running, prefetch_receive, &state);
+        ESP_LOGD(TAG, "Prefetch of %s %s", prefetch_running, success ? "done" : "aborted");
+
+        portENTER_CRITICAL(&prefetch_lock);
+        prefetch_running[0] = '\0';
+        portEXIT_CRITICAL(&prefetch_lock);
+    }
+    prefetch_running[0] = '\0';
+    prefetch_task       = NULL;
+    vTaskDelete(NULL);
+}
+
+bool http_prefetch_start() {
+    if (prefetch_task != NULL) return true;
+    prefetch_quit       = false;
+    prefetch_pending[0] = '\0';
+    prefetch_running[0] = '\0';
+    if (xTaskCreate(prefetch_main, "http_prefetch", HTTP_PREFETCH_STACK, NULL, HTTP_PREFETCH_PRIORITY, &prefetch_task) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to start prefetch task");
+        prefetch_task = NULL;
+        return false;
+    }
+    return true;
+}
+
+void http_prefetch_stop() {
+    if (prefetch_task == NULL) return;
+    prefetch_quit = true;
+    xTaskNotifyGive(prefetch_task);
+    while (prefetch_task != NULL) vTaskDelay(pdMS_TO_TICKS(HTTP_PREFETCH_POLL_MS));
+}
+
+void http_prefetch(const char* url) {
+    if ((prefetch_task == NULL) || (strlen(url) >= sizeof(prefetch_pending))) return;
+    portENTER_CRITICAL(&prefetch_lock);
+    bool running = (strcmp(prefetch_running, url) == 0);
+    if (!running) {
+        strcpy(prefetch_pending, url);
+        prefetch_generation++;
+    }
+    portEXIT_CRITICAL(&prefetch_lock);
+    if (!running) xTaskNotifyGive(prefetch_task);
+}
+
+void http_prefetch_cancel() {
+    portENTER_CRITICAL(&prefetch_lock);
+    prefetch_pending[0] = '\0';
+    prefetch_generation++;
+    portEXIT_CRITICAL(&prefetch_lock);
+}
+
+void http_prefetch_wait(const char* url) {
+    if (prefetch_task == NULL) return;
+    portENTER_CRITICAL(&prefetch_lock);
+    prefetch_pending[0] = '\0';
+    if (strcmp(prefetch_running, url) == 0) {
+        prefetch_urgent = true;
+    } else {
+        prefetch_generation++;
+    }
+    portEXIT_CRITICAL(&prefetch_lock);
+    // Also makes sure the prefetch isn't writing the cache entry the foreground is about to use
+    while (true) {
+        portENTER_CRITICAL(&prefetch_lock);
+        bool idle = (prefetch_running[0] == '\0');
+        portEXIT_CRITICAL(&prefetch_lock);
+        if (idle) break;
+        vTaskDelay(pdMS_TO_TICKS(HTTP_PREFETCH_POLL_MS));
+    }
+}
@@ -0,0 +1,121 @@
+#include "http_stats.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gui_element_header.h"
+#include "hardware.h"
+#include "http_timing.h"
+#include "input_latency.h"
+#include "pax_gfx.h"
+
+#define HTTP_STATS_ROWS 8
+
+static void render_http_stats(pax_buf_t* pax_buffer, http_timing_t* timings, const char* status) {
+    const pax_font_t* font = pax_font_saira_regular;
+    pax_noclip(pax_buffer);
+    pax_background(pax_buffer, 0xFFFFFF);
+    render_header(pax_buffer, 0, 0, pax_buffer->width, 34, 18, 0xFFfec859, 0xFFfa448c, NULL, "Network timing");
+
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 38, "Request");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 127, 38, "Conn");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 164, 38, "Wait");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 201, 38, "Xfer");
+
+    // Totals over the whole history, to see where the time goes
+    uint64_t connect_total  = 0;
+    uint64_t wait_total     = 0;
+    uint64_t transfer_total = 0;
+    size_t   amount         = http_timing_get(timings, HTTP_TIMING_HISTORY);
+    for (size_t index = 0; index < amount; index++) {
+        http_timing_phases_t phases;
+        http_timing_get_phases(&timings[index], &phases);
+        connect_total += phases.connect_us;
+        wait_total += phases.wait_us;
+        transfer_total += phases.transfer_us;
+        if (index >= HTTP_STATS_ROWS) continue;
+
+        float       y      = 54 + 16 * index;
+        const char* url    = timings[index].url;
+        size_t      length = strlen(url);
+        char        buffer[24];
+        // The end of the URL is the most descriptive part
+        snprintf(buffer, sizeof(buffer), "%s%s", timings[index].success ? "" : "! ", (length > 10) ? &url[length - 10] : url);
+        pax_draw_text(pax_buffer, timings[index].success ? 0xFF000000 : 0xFFFF0000, font, 14, 5, y, buffer);
+        if (timings[index].reused) {
+            pax_draw_text(pax_buffer, 0xFF000000, font, 14, 127, y, "reused");
+        } else {
+            snprintf(buffer, sizeof(buffer), "%u", phases.connect_us / 1000);
+            pax_draw_text(pax_buffer, 0xFF000000, font, 14, 127, y, buffer);
+        }
+        snprintf(buffer, sizeof(buffer), "%u", phases.wait_us / 1000);
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 164, y, buffer);
+        snprintf(buffer, sizeof(buffer), "%u", phases.transfer_us / 1000);
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 201, y, buffer);
+    }
+
+    if (amount == 0) {
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 5, 54, "No requests recorded yet");
+    } else {
+        uint64_t total = connect_total + wait_total + transfer_total;
+        if (total == 0) total = 1;
+        char summary[64];
+        snprintf(summary, sizeof(summary), "Conn %u%%  Server %u%%  Xfer %u%%", (unsigned) ((connect_total * 100) / total),
+                 (unsigned) ((wait_total * 100) / total), (unsigned) ((transfer_total * 100) / total));
+        pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 240 - 52, summary);
+    }
+
+    if (status != NULL) {
+        pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 240 - 36, status);
+    }
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 18, 5, 240 - 18, "🅰 export  🅱 back  🅼 reset");
+}
+
+void show_http_stats() {
+    pax_buf_t*     pax_buffer = get_pax_buffer();
+    const char*    status     = NULL;
+    bool           render     = true;
+    bool           quit       = false;
+    http_timing_t* timings    = malloc(sizeof(http_timing_t) * HTTP_TIMING_HISTORY);
+    if (timings == NULL) return;
+
+    input_latency_set_screen("http stats");
+
+    while (!quit) {
+        if (render) {
+            render_http_stats(pax_buffer, timings, status);
+            display_flush();
+            render = false;
+        }
+
+        input_message_t button_message = {0};
+        if (input_buffer_receive(&button_message, portMAX_DELAY)) {
+            if (button_message.state) {
+                switch (button_message.input) {
+                    case INPUT_TOUCH0:
+                        quit = true;
+                        break;
+                    case INPUT_TOUCH1:
+                        http_timing_reset();
+                        status = "History cleared";
+                        render = true;
+                        break;
+                    case INPUT_TOUCH2:
+                        http_timing_dump();
+                        status = "History written to serial console";
+                        render = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    free(timings);
+}
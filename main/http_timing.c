@@ -0,0 +1,104 @@
+#include "http_timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char* TAG = "HTTP timing";
+
+static http_timing_t history[HTTP_TIMING_HISTORY];
+static size_t        history_next  = 0;  // Slot the next request is stored in
+static size_t        history_count = 0;
+static portMUX_TYPE  history_lock  = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t elapsed(const http_timing_t* timing) { return (uint32_t) (esp_timer_get_time() - timing->start); }
+
+void http_timing_begin(http_timing_t* timing, const char* url, bool reused) {
+    memset(timing, 0, sizeof(http_timing_t));
+    size_t length = strlen(url);
+    strlcpy(timing->url, (length < sizeof(timing->url)) ? url : &url[length - (sizeof(timing->url) - 1)], sizeof(timing->url));
+    timing->reused = reused;
+    timing->start  = esp_timer_get_time();
+}
+
+void http_timing_event(http_timing_t* timing, const esp_http_client_event_t* evt) {
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            timing->connected_us = elapsed(timing);
+            break;
+        case HTTP_EVENT_HEADERS_SENT:
+            timing->sent_us = elapsed(timing);
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (timing->first_byte_us == 0) {
+                timing->first_byte_us = elapsed(timing);
+                timing->status        = esp_http_client_get_status_code(evt->client);
+            }
+            break;
+        case HTTP_EVENT_ON_DATA:
+            timing->last_byte_us = elapsed(timing);
+            timing->bytes += evt->data_len;
+            break;
+        default:
+            break;
+    }
+}
+
+void http_timing_end(http_timing_t* timing, bool success) {
+    timing->end_us  = elapsed(timing);
+    timing->success = success;
+
+    http_timing_phases_t phases;
+    http_timing_get_phases(timing, &phases);
+    ESP_LOGI(TAG, "%s: %d, connect %u ms, wait %u ms, transfer %u ms, total %u ms, %u bytes%s", timing->url, timing->status, phases.connect_us / 1000, phases.wait_us / 1000, phases.transfer_us / 1000, timing->end_us / 1000, timing->bytes,
+             timing->reused ? " (reused)" : "");
+
+    portENTER_CRITICAL(&history_lock);
+    history[history_next] = *timing;
+    history_next          = (history_next + 1) % HTTP_TIMING_HISTORY;
+    if (history_count < HTTP_TIMING_HISTORY) history_count++;
+    portEXIT_CRITICAL(&history_lock);
+}
+
+void http_timing_get_phases(const http_timing_t* timing, http_timing_phases_t* phases) {
+    // Phases that were skipped take no time
+    uint32_t connected  = timing->connected_us;
+    uint32_t first_byte = (timing->first_byte_us > connected) ? timing->first_byte_us : connected;
+    uint32_t last_byte  = (timing->last_byte_us > first_byte) ? timing->last_byte_us : first_byte;
+    phases->connect_us  = connected;
+    phases->wait_us     = first_byte - connected;
+    phases->transfer_us = last_byte - first_byte;
+}
+
+size_t http_timing_get(http_timing_t* timings, size_t max) {
+    portENTER_CRITICAL(&history_lock);
+    size_t count = (history_count < max) ? history_count : max;
+    for (size_t index = 0; index < count; index++) {
+        timings[index] = history[(history_next + HTTP_TIMING_HISTORY - 1 - index) % HTTP_TIMING_HISTORY];
+    }
+    portEXIT_CRITICAL(&history_lock);
+    return count;
+}
+
+void http_timing_dump() {
+    http_timing_t* timings = malloc(sizeof(http_timing_t) * HTTP_TIMING_HISTORY);
+    if (timings == NULL) return;
+    size_t count = http_timing_get(timings, HTTP_TIMING_HISTORY);
+    printf("url,status,success,reused,bytes,connected_us,sent_us,first_byte_us,last_byte_us,end_us\n");
+    for (size_t index = count; index > 0; index--) {
+        const http_timing_t* timing = &timings[index - 1];
+        printf("%s,%d,%d,%d,%u,%u,%u,%u,%u,%u\n", timing->url, timing->status, timing->success, timing->reused, timing->bytes, timing->connected_us, timing->sent_us, timing->first_byte_us, timing->last_byte_us, timing->end_us);
+    }
+    free(timings);
+}
+
+void http_timing_reset() {
+    portENTER_CRITICAL(&history_lock);
+    history_next  = 0;
+    history_count = 0;
+    portEXIT_CRITICAL(&history_lock);
+}
@@ -3,5 +3,12 @@
 #include <cJSON.h>
 #include <stdbool.h>
 
+// Receives the status messages of an install. `percent` is the download progress, or -1 for other messages.
+typedef void (*install_status_cb_t)(const char* message, int percent, void* user);
+
 bool create_dir(const char* path);
 bool install_app(bool wait, const char* type_slug, bool to_sd_card, char* data_app_info, size_t size_app_info, cJSON* json_app_info);
+
+// Like install_app, but reports the status to `status` instead of the display, so that it can run in the background.
+bool install_app_status(const char* type_slug, bool to_sd_card, char* data_app_info, size_t size_app_info, cJSON* json_app_info, install_status_cb_t status,
+                        void* user);
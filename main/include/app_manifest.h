@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mbedtls/sha256.h"
+
+// Name of the manifest in the directory of an installed app, lists the SHA-256 of every installed file in sha256sum format.
+#define APP_MANIFEST_FN "manifest.sha256"
+
+#define APP_MANIFEST_HASH_SIZE 32
+
+typedef struct _app_manifest_entry {
+    char*   name;
+    uint8_t sha256[APP_MANIFEST_HASH_SIZE];
+} app_manifest_entry_t;
+
+typedef struct _app_manifest {
+    app_manifest_entry_t* entries;
+    size_t                count;
+} app_manifest_t;
+
+// Load the manifest of the app installed in `app_path`. An app without manifest has an empty manifest.
+bool app_manifest_load(const char* app_path, app_manifest_t* manifest);
+bool app_manifest_save(const char* app_path, const app_manifest_t* manifest);
+void app_manifest_free(app_manifest_t* manifest);
+
+// Get the hash of the file `name`, or NULL if the manifest doesn't list it.
+const uint8_t* app_manifest_find(const app_manifest_t* manifest, const char* name);
+bool           app_manifest_set(app_manifest_t* manifest, const char* name, const uint8_t* sha256);
+
+// Parse a hexadecimal SHA-256 as published in the app info.
+bool sha256_parse(const char* hex, uint8_t* sha256);
+
+// Calculate the SHA-256 of a file.
+bool sha256_file(const char* path, uint8_t* sha256);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "appfs_wrapper.h"
+#include "mbedtls/sha256.h"
+
+#define APPFS_PATCH_MAGIC       0x31445041  // "APD1"
+#define APPFS_PATCH_HEADER_SIZE 44
+#define APPFS_PATCH_BLOCK_SIZE  12
+
+// Applies a binary delta to an AppFS entry while the patch is received in chunks.
+// The patch starts with a header: magic, size of the old app, size of the new app (32 bit little endian) and the SHA-256 of the new app.
+// It continues with the blocks of a bsdiff patch, each a 12 byte control block followed by its data:
+// the length of the diff data, the length of the extra data (32 bit little endian), the adjustment of the position
+// in the old app after the diff data (32 bit signed little endian), the diff data (added to the bytes of the old app) and the extra data (copied).
+// The new app is written to a temporary entry, which only replaces the old app once its hash has been verified.
+typedef struct _appfs_patch {
+    appfs_handle_t         old;                                        // Entry the patch applies to
+    size_t                 old_size;                                   // Size of the entry the patch applies to
+    const char*            name;                                       // Name of the app, not copied
+    const char*            title;                                      // Title of the app, not copied
+    uint16_t               version;                                    // Version of the new app
+    const char*            copy_path;                                  // Optional copy of the new app, not copied
+    char                   temp_name[48];                              // Name of the entry the new app is written to
+    appfs_sink_t           sink;                                       // Writes the new app
+    bool                   started;                                    // The header has been received and the sink is open
+    mbedtls_sha256_context sha256;                                     // Hash of the new app
+    uint8_t                expected[32];                               // Hash of the new app from the header
+    uint8_t                header[APPFS_PATCH_HEADER_SIZE];            // Header or control block being received
+    size_t                 header_received;                            // Amount of the header or control block received
+    size_t                 new_size;                                   // Size of the new app
+    size_t                 produced;                                   // Amount of the new app written
+    size_t                 old_position;                               // Position in the old app
+    size_t                 diff_left;                                  // Diff data left in the current block
+    size_t                 extra_left;                                 // Extra data left in the current block
+    int32_t                adjustment;                                 // Adjustment of the old position at the end of the diff data
+    uint8_t*               buffer;                                     // Data read from the old app
+} appfs_patch_t;
+
+// Prepare to patch the AppFS entry `name`. Fails if there is no such entry.
+esp_err_t appfs_patch_begin(appfs_patch_t* patch, const char* name, const char* title, uint16_t version, const char* copy_path);
+esp_err_t appfs_patch_write(appfs_patch_t* patch, const uint8_t* data, size_t length);
+// Verify the new app and replace the old app with it.
+esp_err_t appfs_patch_finish(appfs_patch_t* patch);
+// Stop patching and remove the temporary entry, the old app is left untouched.
+void      appfs_patch_abort(appfs_patch_t* patch);
@@ -3,11 +3,34 @@
 #include <esp_err.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <stdio.h>
 
 #include "appfs.h"
 
+// Writes an app that is received in chunks to AppFS, without holding the binary in RAM.
+typedef struct _appfs_sink {
+    appfs_handle_t handle;
+    const char*    name;       // Name of the AppFS entry, not copied
+    size_t         size;       // Size of the AppFS entry
+    size_t         written;    // Bytes written to flash
+    size_t         erased;     // Bytes erased ahead of the write position
+    uint8_t*       buffer;     // Sector buffer
+    size_t         buffered;   // Bytes in the sector buffer
+    FILE*          copy;       // Optional copy of the app, for example on the SD card
+    const char*    copy_path;  // Path of the copy, not copied
+} appfs_sink_t;
+
 esp_err_t      appfs_init(void);
 appfs_handle_t appfs_detect_crash();
 void           appfs_boot_app(int fd);
 void           appfs_store_app(bool wait, const char* path, const char* name, const char* title, uint16_t version);
 esp_err_t      appfs_store_in_memory_app(bool wait, const char* name, const char* title, uint16_t version, size_t app_size, uint8_t* app);
+
+// Create an AppFS entry of `size` bytes and prepare for writing it in chunks.
+// If `copy_path` is not NULL the data is also written to that file.
+esp_err_t appfs_sink_begin(appfs_sink_t* sink, const char* name, const char* title, uint16_t version, size_t size, const char* copy_path);
+esp_err_t appfs_sink_write(appfs_sink_t* sink, const uint8_t* data, size_t length);
+// Write the remaining data, fails if less than the size given to appfs_sink_begin was written.
+esp_err_t appfs_sink_finish(appfs_sink_t* sink);
+// Stop writing and remove the incomplete entry and copy.
+void      appfs_sink_abort(appfs_sink_t* sink);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Maximum amount of boot stages recorded.
+#define BOOT_TRACE_MAX_STAGES 16
+
+// Logged when boot is done, followed by the boot time. `make qemu-boot-time` looks for this message.
+#define BOOT_TRACE_DONE_MESSAGE "Boot finished in"
+
+// Stack size of the tasks that run boot steps.
+#define BOOT_TRACE_STACK_SIZE 4096
+
+// Timestamps of a boot stage, in microseconds since the app started.
+typedef struct _boot_trace_stage {
+    const char* name;
+    int64_t     start_us;
+    int64_t     end_us;  // 0 while the stage is running
+    int         core;    // Core the stage ran on
+    esp_err_t   result;
+} boot_trace_stage_t;
+
+// A step of the boot sequence, see boot_trace_run.
+typedef struct _boot_step {
+    const char* name;
+    esp_err_t (*run)();
+    uint32_t depends;  // Bit mask of the indices of the steps that have to be done before this step starts
+    bool     pinned;   // Run on the core of the caller, for steps that install interrupt handlers
+} boot_step_t;
+
+// Start recording a stage. The name is not copied and must remain valid, use a string literal.
+// Returns the stage to pass to boot_trace_end, or -1 if BOOT_TRACE_MAX_STAGES stages have been recorded already.
+int boot_trace_begin(const char* name);
+
+// Finish recording a stage.
+void boot_trace_end(int stage, esp_err_t result);
+
+// Run at most 24 steps, each in its own task, and wait for all of them to finish.
+// A step starts as soon as the steps it depends on are done, dependencies must not form a cycle.
+// Steps that depend on a failed step are skipped. The result of each step is written to `results`,
+// ESP_ERR_INVALID_STATE for skipped steps. When the steps can't be run at all, every result is set to an error.
+// Uses the notification value of the calling task. Returns false if any step failed or was skipped.
+bool boot_trace_run(const boot_step_t* steps, size_t count, esp_err_t* results);
+
+// Mark boot as finished and log the stages on the serial console.
+void boot_trace_done();
+
+// Get the time from the start of the app until boot_trace_done was called in microseconds, 0 if boot is not done yet.
+int64_t boot_trace_get_total();
+
+// Copy at most `max` stages to `stages`, in the order they were started.
+// Returns the amount of stages copied.
+size_t boot_trace_get(boot_trace_stage_t* stages, size_t max);
+
+// Print the stages as CSV on the serial console.
+void boot_trace_dump();
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct _download_job {
+    const char* url;
+    const char* path;
+    size_t      size;  // Expected size in bytes, 0 if not known
+} download_job_t;
+
+// Called from the task that started the downloads while they are running.
+typedef void (*download_progress_cb_t)(size_t files_done, size_t files_total, size_t bytes_done, size_t bytes_total, void* user);
+
+// Called from a download worker when the job at `index` has been downloaded. Return false to fail the job.
+typedef bool (*download_done_cb_t)(size_t index, void* user);
+
+// Download all jobs to their destination, running up to CONFIG_DOWNLOAD_CONCURRENCY downloads at once.
+// Blocks until all downloads are done, or until one of them fails. Returns true if all files were downloaded.
+// `progress` and `done` are optional.
+bool download_files(const download_job_t* jobs, size_t count, download_progress_cb_t progress, download_done_cb_t done, void* user);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Writes a downloaded file in cluster aligned blocks to a temporary file next to the destination,
+// which replaces the destination only once the download is complete.
+typedef struct _download_writer {
+    char*    path;       // Destination
+    char*    temp_path;  // File that is written while downloading
+    FILE*    fd;
+    uint8_t* buffer;     // Data waiting to be written
+    size_t   buffered;   // Amount of data in the buffer
+    size_t   position;   // File offset at which the buffer starts
+} download_writer_t;
+
+// Prepare writing to `path`, the data is written to "<path>.part" until the download is complete.
+bool download_writer_init(download_writer_t* writer, const char* path);
+
+// Open the temporary file for a download attempt. When `offset` is not 0 an earlier attempt is continued at `offset`,
+// `offset` is set to 0 if the partial file can't be used.
+bool download_writer_open(download_writer_t* writer, size_t* offset);
+
+// Allocate the clusters for a file of `size` bytes up front, instead of extending the file for every block.
+bool download_writer_preallocate(download_writer_t* writer, size_t size);
+
+// Continue writing at `offset`, for example at 0 when the server sent the complete file instead of the requested range.
+bool download_writer_seek(download_writer_t* writer, size_t offset);
+
+bool download_writer_write(download_writer_t* writer, const uint8_t* data, size_t length);
+
+// Write the buffered data and close the temporary file at the end of an attempt, it is kept for the next attempt.
+bool download_writer_close(download_writer_t* writer);
+
+// Cut the closed temporary file to `size` bytes and move it to the destination.
+bool download_writer_commit(download_writer_t* writer, size_t size);
+
+// Remove the temporary file and release the writer.
+void download_writer_discard(download_writer_t* writer);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "http_download.h"
+
+// Incremental gzip decoder using the inflater in ROM.
+// Compressed data can be fed in chunks of any size, the decompressed data is passed to the output callback
+// in chunks of at most the size of the 32 KiB dictionary, which is the only large buffer that is used.
+typedef struct _gzip_stream gzip_stream_t;
+
+// Allocate a decoder passing its output to `output`. Returns NULL when out of memory.
+gzip_stream_t* gzip_stream_create(download_data_cb_t output, void* user);
+
+// Decode the next chunk of compressed data. Returns false on corrupt data or when the output callback fails.
+bool gzip_stream_feed(gzip_stream_t* stream, const uint8_t* data, size_t length);
+
+// Check that the complete stream has been decoded and matches the CRC and size in its trailer.
+bool gzip_stream_finished(const gzip_stream_t* stream);
+
+// Amount of decompressed data passed to the output callback.
+size_t gzip_stream_output_size(const gzip_stream_t* stream);
+
+void gzip_stream_free(gzip_stream_t* stream);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "http_download.h"
+
+// Directory on the internal filesystem in which cached responses are stored.
+#define HTTP_CACHE_PATH "/internal/cache"
+
+// Maximum total size of the cached responses in bytes.
+#define HTTP_CACHE_BUDGET (96 * 1024)
+
+// Maximum amount of cached responses.
+#define HTTP_CACHE_MAX_ENTRIES 32
+
+// Responses confirmed by the server less than this long ago are used without asking the server again.
+#define HTTP_CACHE_FRESH_TIME_MS 60000
+
+typedef struct _http_cache_validators {
+    char etag[64];
+    char last_modified[40];
+} http_cache_validators_t;
+
+// Get the ETag and Last-Modified values stored with the cached response for `url`.
+// Returns false if the URL is not cached.
+bool http_cache_get_validators(const char* url, http_cache_validators_t* validators);
+
+// Check whether the cached response for `url` was stored or confirmed by the server less than HTTP_CACHE_FRESH_TIME_MS ago.
+bool http_cache_is_fresh(const char* url);
+
+// Note that the server confirmed that the cached response for `url` is still up to date.
+void http_cache_mark_validated(const char* url);
+
+// Load the cached response for `url` into a newly allocated buffer.
+bool http_cache_load(const char* url, uint8_t** ptr, size_t* size);
+
+// Store a response, evicting the least recently used responses to stay within the budget.
+bool http_cache_store(const char* url, const uint8_t* data, size_t size, const http_cache_validators_t* validators);
+
+// Start storing a response that is received in chunks, the body is written to the returned file.
+// Returns NULL if the response can't be cached.
+FILE* http_cache_store_begin(const char* url);
+
+// Finish storing a response started with http_cache_store_begin, closing `fd`.
+// The response is only added to the cache if `commit` is set, otherwise it is discarded.
+bool http_cache_store_end(const char* url, FILE* fd, size_t size, const http_cache_validators_t* validators, bool commit);
+
+// Pass the cached response for `url` to `callback` in chunks, as if it was being downloaded.
+bool http_cache_replay(const char* url, download_data_cb_t callback, void* user);
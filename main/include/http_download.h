@@ -1,7 +1,35 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Called for every received chunk of a streamed download. `total` is 0 if the size is not known in advance.
+// A chunk with `offset` 0 starts the body, which happens again when a retried download can't be resumed.
+// A retry that resumes an interrupted download continues with the offset at which it stopped.
+// Return false to abort the download.
+typedef bool (*download_data_cb_t)(const uint8_t* data, size_t length, size_t offset, size_t total, void* user);
+
+// Interrupted downloads are resumed with a range request when the server sent an ETag or Last-Modified header,
+// failed attempts are retried with exponential backoff.
 bool download_file(const char* url, const char* path);
+
+// Like download_file, `progress` is updated with the amount of bytes received while the file is being downloaded.
+bool download_file_progress(const char* url, const char* path, size_t* progress);
 bool download_ram(const char* url, uint8_t** ptr, size_t* size);
+
+// Send `data` in a POST request and download the response to RAM. Only fails over to a new connection, there are no retries.
+bool download_ram_post(const char* url, const char* content_type, const char* data, size_t length, uint8_t** ptr, size_t* size);
+
+// Like download_ram, but revalidates against and falls back to a copy cached on the internal filesystem.
+bool download_ram_cached(const char* url, uint8_t** ptr, size_t* size);
+
+// Pass the body of `url` to `callback` while it is being received, without buffering it in RAM.
+bool download_stream(const char* url, download_data_cb_t callback, void* user);
+
+// Like download_stream, the body is also stored in the cache, which is used when the server answers 304 or can't be reached.
+bool download_stream_cached(const char* url, download_data_cb_t callback, void* user);
+
+// Fetch `url` into the cache with a single attempt, to make a later cached download instant.
+// `callback` sees the body while it is received and can abort the download by returning false.
+bool download_prefetch(const char* url, download_data_cb_t callback, void* user);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_http_client.h"
+
+// Maximum amount of clients kept alive at the same time.
+#define HTTP_POOL_SIZE 4
+
+// Idle connections are closed after this amount of time.
+#define HTTP_POOL_IDLE_TIMEOUT_MS 20000
+
+// Idle connections are closed this long before the keep-alive timeout announced by the server, so that a request
+// is never sent over a connection the server is closing at the same time.
+#define HTTP_POOL_KEEP_ALIVE_MARGIN_MS 1000
+
+// Clients keep their TLS session for this amount of time after their connection was closed,
+// so that the next connection to the same server can resume the session instead of doing a full handshake.
+#define HTTP_POOL_SESSION_TIMEOUT_MS 300000
+
+// Get a client for `url`, reusing an idle connection to the same host and port if one is available.
+// Events for this request are passed to `event_handler` with `user_data` as the user data pointer.
+// If `reused` is not NULL it is set to whether an existing connection was handed out.
+// Idle connections that the server closed or is about to close are not reused, the client connects again instead.
+// Returns NULL if no client could be created.
+esp_http_client_handle_t http_pool_acquire(const char* url, http_event_handle_cb event_handler, void* user_data, bool* reused);
+
+// Hand a client back to the pool after a request.
+// Clients that are not healthy are closed instead of kept alive. Only pass false for transport errors, after an error status
+// the connection is still in a known state and can be reused.
+void http_pool_release(esp_http_client_handle_t client, bool healthy);
+
+// Close all idle connections, for example before disabling WiFi.
+// Cached TLS sessions are kept until they expire.
+void http_pool_flush();
+
+// Get the amount of connections opened and the amount of requests that reused a connection.
+void http_pool_get_stats(uint32_t* connections, uint32_t* reuses);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Largest response that is prefetched, larger responses are left for the foreground download.
+#define HTTP_PREFETCH_MAX_SIZE (32 * 1024)
+
+// Bandwidth used for prefetching in bytes per second, unless the foreground is waiting for the response.
+#define HTTP_PREFETCH_RATE (16 * 1024)
+
+// Start the low priority task that fetches responses into the cache in the background.
+bool http_prefetch_start();
+
+// Stop the prefetch task, cancelling the running prefetch.
+void http_prefetch_stop();
+
+// Fetch `url` into the cache in the background, replacing and cancelling earlier requests for other URLs.
+void http_prefetch(const char* url);
+
+// Cancel the pending and running prefetches. The running prefetch closes its connection at its next chunk
+// instead of reading the rest of the response.
+void http_prefetch_cancel();
+
+// Call before downloading `url` in the foreground. Waits for a running prefetch of `url` at full speed,
+// a prefetch of another URL is cancelled so it doesn't compete for bandwidth.
+void http_prefetch_wait(const char* url);
@@ -0,0 +1,3 @@
+#pragma once
+
+void show_http_stats();
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_client.h"
+
+// Amount of completed requests kept in the history.
+#define HTTP_TIMING_HISTORY 32
+
+// Timestamps of a single request, in microseconds since the request was started.
+// Timestamps of phases that did not happen (like the connect on a reused connection) are 0.
+typedef struct _http_timing {
+    char     url[40];        // End of the URL, the start is mostly the same server
+    int64_t  start;          // esp_timer time at which the request was started
+    uint32_t connected_us;   // Host name lookup, TCP connect and TLS handshake done
+    uint32_t sent_us;        // Request headers sent
+    uint32_t first_byte_us;  // First byte of the response received
+    uint32_t last_byte_us;   // Last byte of the response body received
+    uint32_t end_us;         // Request finished
+    uint32_t bytes;          // Amount of response body received
+    int16_t  status;         // HTTP status code, 0 if there was no response
+    bool     reused;         // The request was sent over an idle connection kept alive from an earlier request
+    bool     success;
+} http_timing_t;
+
+// Durations of the phases of a request, in microseconds. Together they add up to the time until the last byte was received.
+typedef struct _http_timing_phases {
+    uint32_t connect_us;   // Host name lookup, TCP connect and TLS handshake
+    uint32_t wait_us;      // Until the first byte of the response, mostly the time the server needs
+    uint32_t transfer_us;  // From the first until the last byte, mostly airtime
+} http_timing_phases_t;
+
+// Start timing a request to `url`.
+// The host name lookup is not timed separately, it is part of connecting. The WiFi benchmark measures it on its own.
+void http_timing_begin(http_timing_t* timing, const char* url, bool reused);
+
+// Record the timestamp of an HTTP client event, call this from the event handler of the request.
+// The status code is taken from the client when the first response header arrives.
+void http_timing_event(http_timing_t* timing, const esp_http_client_event_t* evt);
+
+// Finish timing a request and add it to the history.
+void http_timing_end(http_timing_t* timing, bool success);
+
+// Get the durations of the phases of a finished request.
+void http_timing_get_phases(const http_timing_t* timing, http_timing_phases_t* phases);
+
+// Copy at most `max` requests from the history to `timings`, most recent first.
+// Returns the amount of requests copied.
+size_t http_timing_get(http_timing_t* timings, size_t max);
+
+// Print the history as CSV on the serial console.
+void http_timing_dump();
+
+// Clear the history.
+void http_timing_reset();
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_manifest.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Name of the journal in the directory of an app that is being installed. It lists the files that have been
+// installed completely, in the same format as the manifest, and the AppFS entry that is being written.
+#define INSTALL_JOURNAL_FN "install.journal"
+
+typedef struct _install_journal {
+    FILE*             fd;
+    SemaphoreHandle_t lock;  // Files are recorded by the download workers concurrently
+} install_journal_t;
+
+// Start the journal of an install into `app_path`, replacing the journal of an earlier attempt.
+bool install_journal_begin(install_journal_t* journal, const char* app_path, const char* type_slug, const char* category_slug, const char* app_slug,
+                           bool to_sd_card);
+
+// Record that `name` has been installed completely with hash `sha256`. The record is on flash when this returns.
+bool install_journal_file(install_journal_t* journal, const char* name, const uint8_t* sha256);
+
+// Record all files of `manifest` as installed, like install_journal_file but with a single sync for all of them.
+bool install_journal_manifest(install_journal_t* journal, const app_manifest_t* manifest);
+
+// Record that the AppFS entry `entry` is being written, or that it has been written completely when `done` is set.
+bool install_journal_appfs(install_journal_t* journal, const char* entry, bool done);
+
+// Close the journal after a failed install. It is kept, so the files installed so far are not downloaded again when the app is installed again.
+void install_journal_close(install_journal_t* journal);
+
+// Close and remove the journal of a completed install.
+void install_journal_finish(install_journal_t* journal, const char* app_path);
+
+// Add the files recorded in the journal left in `app_path` by an interrupted install to `manifest`.
+bool install_journal_load(const char* app_path, app_manifest_t* manifest);
+
+// Find installs that were interrupted by a reset. Partially written AppFS entries are removed,
+// and the installs are queued again so that only the files that are missing are downloaded.
+void install_journal_recover();
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Maximum amount of apps in the queue, including apps that have finished installing.
+#define INSTALL_QUEUE_MAX 16
+
+// Apps that have not been installed yet are stored in this file, so that they are installed after a reboot.
+#define INSTALL_QUEUE_JOURNAL "/internal/install_queue.txt"
+
+typedef enum _install_state {
+    INSTALL_QUEUED,
+    INSTALL_RUNNING,
+    INSTALL_DONE,
+    INSTALL_FAILED,
+} install_state_t;
+
+typedef struct _install_queue_entry {
+    char            type_slug[32];
+    char            category_slug[32];
+    char            app_slug[64];
+    bool            to_sd_card;
+    install_state_t state;
+    int             percent;  // Download progress of the running install, -1 if not known
+} install_queue_entry_t;
+
+// Load the journal with the apps that were queued before the reboot. They are installed once install_queue_start is called.
+void install_queue_init();
+
+// Start installing the queued apps. Apps queued before this, by install_journal_recover for example, wait until it is called.
+void install_queue_start();
+
+// Queue an app from the Hatchery to be installed in the background. Queuing an app that is already waiting does nothing.
+bool install_queue_add(const char* type_slug, const char* category_slug, const char* app_slug, bool to_sd_card);
+
+// Get the state of an app in the queue, for the UI to poll. Returns false if the app is not in the queue.
+bool install_queue_get(const char* type_slug, const char* app_slug, install_queue_entry_t* entry);
+
+// Copy up to `max` entries in the order in which they were queued, returns the amount of entries copied.
+size_t install_queue_list(install_queue_entry_t* entries, size_t max);
+
+// Check whether apps are waiting to be installed or being installed.
+bool install_queue_busy();
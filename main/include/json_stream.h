@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Maximum amount of fields extracted from each object.
+#define JSON_STREAM_MAX_FIELDS 4
+
+// Maximum length of an object key that can be matched against the requested fields.
+#define JSON_STREAM_MAX_KEY 32
+
+// Incremental parser for a JSON array of objects (as served by the Hatchery listings).
+// Only the string values of the requested fields of each object are kept, in a single string arena.
+// Input can be fed in chunks of any size, no DOM or copy of the document is built.
+typedef struct _json_stream {
+    const char* const* fields;       // Names of the fields to extract
+    size_t             field_count;  // Amount of fields to extract
+    char*              arena;        // Extracted strings, NUL terminated
+    size_t             arena_size;   // Allocated size of the arena
+    size_t             arena_used;   // Used size of the arena
+    uint32_t*          offsets;      // Arena offsets of the fields, field_count entries per item
+    size_t             item_count;   // Amount of objects found
+    size_t             item_capacity;
+    bool               error;        // Syntax error or out of memory
+
+    // Parser state
+    uint8_t  depth;        // Current nesting depth
+    uint32_t object_mask;  // Bit n is set if the container at depth n + 1 is an object
+    bool     expect_key;   // Next string in the current object is a key
+    bool     in_string;    // Inside a string
+    bool     is_key;       // The current string is a key
+    bool     escape;       // Previous character was a backslash
+    uint8_t  unicode_left; // Hex digits left in an \u escape sequence
+    uint32_t unicode;      // Code point of the current \u escape sequence
+    uint32_t surrogate;    // High surrogate waiting for its low surrogate
+    int      field;        // Field the current value is extracted to, -1 if the value is skipped
+    uint32_t value_start;  // Arena offset of the value being extracted
+    char     key[JSON_STREAM_MAX_KEY];
+    uint8_t  key_length;
+    bool     key_overflow;
+} json_stream_t;
+
+// Prepare a parser extracting `fields` (at most JSON_STREAM_MAX_FIELDS) from each object.
+// The fields array is not copied and must remain valid.
+void json_stream_init(json_stream_t* stream, const char* const* fields, size_t field_count);
+
+// Forget all extracted data and start parsing a new document, keeping the allocated memory.
+void json_stream_reset(json_stream_t* stream);
+
+// Parse the next chunk of the document. Returns false on error.
+bool json_stream_feed(json_stream_t* stream, const char* data, size_t length);
+
+// Check that the complete document has been parsed without errors.
+bool json_stream_finish(json_stream_t* stream);
+
+// Get the extracted value of `field` of the object at `index`, or NULL if the object does not have it.
+const char* json_stream_get(const json_stream_t* stream, size_t index, size_t field);
+
+// Release the memory used by the parser.
+void json_stream_free(json_stream_t* stream);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Canonical base URLs of the servers. Requests are made to these URLs and sent to the selected mirror by http_download.
+#define MIRROR_HATCHERY_URL "https://mch2022.badge.team/v2/mch2022"
+#define MIRROR_OTA_URL      "https://mch2022.ota.bodge.team"
+
+// Maximum amount of mirrors per server, including the canonical server.
+#define MIRROR_MAX 5
+
+// Maximum length of a mirror base URL.
+#define MIRROR_URL_SIZE 96
+
+// Mirrors are probed again after this amount of time, or when all mirrors failed.
+#define MIRROR_PROBE_INTERVAL_MS (10 * 60 * 1000)
+
+// Time a mirror gets to answer a probe.
+#define MIRROR_PROBE_TIMEOUT_MS 2000
+
+// Local mirrors announce themselves with this mDNS service.
+// The TXT record holds the base URLs: "hatchery=https://..." and "ota=https://...".
+#define MIRROR_MDNS_SERVICE "_badge-mirror"
+#define MIRROR_MDNS_PROTO   "_tcp"
+
+// Mirrors found through mDNS are only used if they are HTTPS and their host name ends with one of these domains.
+// Can be changed with the "mirror.trust" NVS key, a space separated list.
+#define MIRROR_TRUSTED_DOMAINS "badge.team bodge.team"
+
+// NVS keys in the "system" namespace:
+// "mirror.hatchery" and "mirror.ota": space separated lists of mirror base URLs, tried next to the canonical server.
+// "mirror.mdns": set to 0 to disable looking for local mirrors.
+// "mirror.trust": trusted domains for mirrors found through mDNS.
+
+typedef enum _mirror_server {
+    MIRROR_HATCHERY,
+    MIRROR_OTA,
+    MIRROR_SERVERS,
+} mirror_server_t;
+
+// Load the mirror configuration from NVS.
+void mirrors_init();
+
+// Copy `url` to `output`, replacing a canonical server URL with the base URL of the fastest healthy mirror.
+// The mirrors of a server are probed in the background on first use and again every MIRROR_PROBE_INTERVAL_MS.
+// Until a probe finishes, the mirror selected by the previous probe is used, or the canonical server before the first one.
+// URLs of other servers are copied as is.
+void mirror_rewrite(const char* url, char* output, size_t size);
+
+// Report that a request to `url` failed because of the server, switching to the next fastest mirror.
+// Does nothing if `url` is not on a mirror.
+void mirror_report_failure(const char* url);
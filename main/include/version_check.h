@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct _version_check_item {
+    const char* type;
+    const char* category;
+    const char* slug;
+    int         installed;  // Installed version
+    int         latest;     // Version available in the Hatchery, -1 if unknown (set by version_check)
+} version_check_item_t;
+
+// Look up the latest version of each of the `items` in the Hatchery with a single batched request.
+// Falls back to fetching the app info, CONFIG_DOWNLOAD_CONCURRENCY apps at a time, for the apps the batched response
+// leaves out, or for all apps when the batched request fails.
+// Returns false if the version of one or more apps could not be determined.
+bool version_check(version_check_item_t* items, size_t count);
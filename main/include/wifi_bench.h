@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Server used when no benchmark server has been configured.
+// A local test server has to serve <url>/test.bin and accept POST requests on <url>/upload.
+#define WIFI_BENCH_DEFAULT_URL "https://mch2022.ota.bodge.team"
+
+// File the results of the last benchmark are written to, as JSON.
+#define WIFI_BENCH_RESULTS_FN "/internal/wifi_bench.json"
+
+// Amount of parallel connections used for the multi stream download test.
+#define WIFI_BENCH_STREAMS 4
+
+// Size of the upload test in bytes.
+#define WIFI_BENCH_UPLOAD_SIZE (256 * 1024)
+
+// Amount of small requests used to measure latency.
+#define WIFI_BENCH_LATENCY_SAMPLES 50
+
+// Ask for the benchmark server, then run the throughput and latency tests against it.
+// The results are shown on the display and stored in WIFI_BENCH_RESULTS_FN.
+void wifi_benchmark();
@@ -2,4 +2,6 @@
 
 #include "esp_err.h"
 
+// Load the root certificates into the global CA store used by HTTP clients with use_global_ca_store.
+// The certificates are loaded on first use, call this before creating such a client. Later calls return right away.
 esp_err_t init_ca_store();
@@ -0,0 +1,95 @@
+#include "input_stats.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#include <stdio.h>
+
+#include "gui_element_header.h"
+#include "hardware.h"
+#include "input_latency.h"
+#include "pax_gfx.h"
+
+static void render_input_stats(pax_buf_t* pax_buffer, const char* status) {
+    const pax_font_t* font = pax_font_saira_regular;
+    pax_noclip(pax_buffer);
+    pax_background(pax_buffer, 0xFFFFFF);
+    render_header(pax_buffer, 0, 0, pax_buffer->width, 34, 18, 0xFFfec859, 0xFFfa448c, NULL, "Input latency");
+
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 38, "Screen");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 110, 38, "n");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 150, 38, "p50");
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 195, 38, "p99");
+
+    size_t amount = input_latency_get_screen_count();
+    for (size_t index = 0; index < amount && index < 8; index++) {
+        input_latency_stats_t stats;
+        if (!input_latency_get_stats(index, &stats)) break;
+        float y = 54 + 16 * index;
+        char  buffer[16];
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 5, y, stats.screen);
+        snprintf(buffer, sizeof(buffer), "%u", stats.count);
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 110, y, buffer);
+        snprintf(buffer, sizeof(buffer), "%ums", stats.p50_ms);
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 150, y, buffer);
+        snprintf(buffer, sizeof(buffer), "%ums", stats.p99_ms);
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 195, y, buffer);
+    }
+
+    if (amount == 0) {
+        pax_draw_text(pax_buffer, 0xFF000000, font, 14, 5, 54, "No input recorded yet");
+    }
+
+    uint32_t dropped   = 0;
+    uint32_t coalesced = 0;
+    input_buffer_get_stats(&dropped, &coalesced);
+    char counters[64];
+    snprintf(counters, sizeof(counters), "Dropped: %u  Merged: %u", dropped, coalesced);
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 240 - 52, counters);
+
+    if (status != NULL) {
+        pax_draw_text(pax_buffer, 0xFF491d88, font, 14, 5, 240 - 36, status);
+    }
+    pax_draw_text(pax_buffer, 0xFF491d88, font, 18, 5, 240 - 18, "🅰 export  🅱 back  🅼 reset");
+}
+
+void show_input_stats() {
+    pax_buf_t*  pax_buffer = get_pax_buffer();
+    const char* status     = NULL;
+    bool        render     = true;
+    bool        quit       = false;
+
+    input_latency_set_screen("input stats");
+
+    while (!quit) {
+        if (render) {
+            render_input_stats(pax_buffer, status);
+            display_flush();
+            render = false;
+        }
+
+        input_message_t button_message = {0};
+        if (input_buffer_receive(&button_message, portMAX_DELAY)) {
+            if (button_message.state) {
+                switch (button_message.input) {
+                    case INPUT_TOUCH0:
+                        quit = true;
+                        break;
+                    case INPUT_TOUCH1:
+                        input_latency_reset();
+                        status = "Statistics cleared";
+                        render = true;
+                        break;
+                    case INPUT_TOUCH2:
+                        input_latency_dump();
+                        status = "Histogram written to serial console";
+                        render = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include "install_journal.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "appfs.h"
+#include "esp_log.h"
+#include "install_queue.h"
+
+static const char* TAG = "Install journal";
+
+// Line with the identity of the app, used to queue the install again after a reset
+#define JOURNAL_APP "app"
+
+// Lines with the state of an AppFS entry
+#define JOURNAL_APPFS_BEGIN "appfs-begin"
+#define JOURNAL_APPFS_END   "appfs-end"
+
+// Line written when an install failed without a reset, such installs are not continued automatically
+#define JOURNAL_STOPPED "stopped"
+
+// Make sure the lines written so far are on flash, called with the lock held
+static bool journal_sync(install_journal_t* journal) { return (fflush(journal->fd) == 0) && (fsync(fileno(journal->fd)) == 0); }
+
+// Write a line and make sure it is on flash before continuing
+static bool journal_write(install_journal_t* journal, const char* line) {
+    if (journal->fd == NULL) return false;
+    xSemaphoreTake(journal->lock, portMAX_DELAY);
+    bool success = (fputs(line, journal->fd) >= 0) && journal_sync(journal);
+    xSemaphoreGive(journal->lock);
+    if (!success) ESP_LOGE(TAG, "Failed to write to the journal");
+    return success;
+}
+
+// Format the line that records the file `name` with hash `sha256`, in the format of the manifest
+static void format_file(char* line, size_t size, const char* name, const uint8_t* sha256) {
+    for (size_t index = 0; index < APP_MANIFEST_HASH_SIZE; index++) {
+        sprintf(&line[index * 2], "%02x", sha256[index]);
+    }
+    snprintf(&line[APP_MANIFEST_HASH_SIZE * 2], size - APP_MANIFEST_HASH_SIZE * 2, "  %s\n", name);
+}
+
+static void journal_release(install_journal_t* journal) {
+    if (journal->fd != NULL) fclose(journal->fd);
+    if (journal->lock != NULL) vSemaphoreDelete(journal->lock);
+    journal->fd   = NULL;
+    journal->lock = NULL;
+}
+
+bool install_journal_begin(install_journal_t* journal, const char* app_path, const char* type_slug, const char* category_slug, const char* app_slug,
+                           bool to_sd_card) {
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", app_path, INSTALL_JOURNAL_FN);
+    journal->lock = xSemaphoreCreateMutex();
+    journal->fd   = (journal->lock != NULL) ? fopen(path, "w") : NULL;
+    if (journal->fd == NULL) {
+        ESP_LOGE(TAG, "Failed to create %s", path);
+        journal_release(journal);
+        return false;
+    }
+    char line[160];
+    snprintf(line, sizeof(line), JOURNAL_APP " %s %s %s %d\n", type_slug, ((category_slug != NULL) && (category_slug[0] != '\0')) ? category_slug : "-", app_slug,
+             to_sd_card ? 1 : 0);
+    if (journal_write(journal, line)) return true;
+    journal_release(journal);
+    return false;
+}
+
+bool install_journal_file(install_journal_t* journal, const char* name, const uint8_t* sha256) {
+    char line[APP_MANIFEST_HASH_SIZE * 2 + 160];
+    format_file(line, sizeof(line), name, sha256);
+    return journal_write(journal, line);
+}
+
+bool install_journal_manifest(install_journal_t* journal, const app_manifest_t* manifest) {
+    if (journal->fd == NULL) return false;
+    if (manifest->count == 0) return true;
+    xSemaphoreTake(journal->lock, portMAX_DELAY);
+    bool success = true;
+    for (size_t index = 0; success && (index < manifest->count); index++) {
+        char line[APP_MANIFEST_HASH_SIZE * 2 + 160];
+        format_file(line, sizeof(line), manifest->entries[index].name, manifest->entries[index].sha256);
+        success = (fputs(line, journal->fd) >= 0);
+    }
+    success = success && journal_sync(journal);
+    xSemaphoreGive(journal->lock);
+    if (!success) ESP_LOGE(TAG, "Failed to write the manifest to the journal");
+    return success;
+}
+
+bool install_journal_appfs(install_journal_t* journal, const char* entry, bool done) {
+    char line[80];
+    snprintf(line, sizeof(line), "%s %s\n", done ? JOURNAL_APPFS_END : JOURNAL_APPFS_BEGIN, entry);
+    return journal_write(journal, line);
+}
+
+void install_journal_close(install_journal_t* journal) {
+    if (journal->fd != NULL) journal_write(journal, JOURNAL_STOPPED "\n");
+    journal_release(journal);
+}
+
+void install_journal_finish(install_journal_t* journal, const char* app_path) {
+    journal_release(journal);
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", app_path, INSTALL_JOURNAL_FN);
+    remove(path);
+}
+
+bool install_journal_load(const char* app_path, app_manifest_t* manifest) {
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", app_path, INSTALL_JOURNAL_FN);
+    FILE* fd = fopen(path, "r");
+    if (fd == NULL) return true;
+    ESP_LOGI(TAG, "Continuing the interrupted install in %s", app_path);
+    char line[APP_MANIFEST_HASH_SIZE * 2 + 160];
+    bool success = true;
+    while (success && (fgets(line, sizeof(line), fd) != NULL)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        uint8_t sha256[APP_MANIFEST_HASH_SIZE];
+        // A line cut short by a reset fails to parse and is ignored
+        if ((strlen(line) > APP_MANIFEST_HASH_SIZE * 2 + 2) && (strncmp(&line[APP_MANIFEST_HASH_SIZE * 2], "  ", 2) == 0) && sha256_parse(line, sha256)) {
+            success = app_manifest_set(manifest, &line[APP_MANIFEST_HASH_SIZE * 2 + 2], sha256);
+        }
+    }
+    fclose(fd);
+    return success;
+}
+
+// Roll back the AppFS entry of an interrupted install and queue the install again
+static void recover(const char* app_path) {
+    char path[160];
+    snprintf(path, sizeof(path), "%s/%s", app_path, INSTALL_JOURNAL_FN);
+    FILE* fd = fopen(path, "r");
+    if (fd == NULL) return;
+
+    char type_slug[32]     = {0};
+    char category_slug[32] = {0};
+    char app_slug[64]      = {0};
+    int  to_sd_card        = 0;
+    char writing[48]       = {0};  // AppFS entry that was being written
+    bool stopped           = false;
+    char line[APP_MANIFEST_HASH_SIZE * 2 + 160];
+    while (fgets(line, sizeof(line), fd) != NULL) {
+        char entry[48];
+        if (strncmp(line, JOURNAL_APP " ", strlen(JOURNAL_APP " ")) == 0) {
+            if (sscanf(line, JOURNAL_APP " %31s %31s %63s %d", type_slug, category_slug, app_slug, &to_sd_card) != 4) app_slug[0] = '\0';
+        } else if (sscanf(line, JOURNAL_APPFS_BEGIN " %47s", entry) == 1) {
+            strcpy(writing, entry);
+        } else if ((sscanf(line, JOURNAL_APPFS_END " %47s", entry) == 1) && (strcmp(writing, entry) == 0)) {
+            writing[0] = '\0';
+        } else if (strncmp(line, JOURNAL_STOPPED, strlen(JOURNAL_STOPPED)) == 0) {
+            stopped = true;
+        }
+    }
+    fclose(fd);
+
+    if ((writing[0] != '\0') && appfsExists(writing)) {
+        ESP_LOGW(TAG, "Removing the incomplete AppFS entry %s", writing);
+        appfsDeleteFile(writing);
+    }
+
+    if (stopped) return;  // Continued when the user installs the app again
+
+    if ((app_slug[0] == '\0') || (strcmp(category_slug, "-") == 0) || (!install_queue_add(type_slug, category_slug, app_slug, to_sd_card != 0))) {
+        // Can't be continued, the files that were installed completely are still found through their hashes when the app is installed again
+        ESP_LOGW(TAG, "Unable to continue the install in %s", app_path);
+        return;
+    }
+    ESP_LOGI(TAG, "Queued the interrupted install of %s", app_slug);
+}
+
+// Apps are installed in <root>/apps/<type>/<slug>
+static void recover_root(const char* root) {
+    char apps_path[32];
+    snprintf(apps_path, sizeof(apps_path), "%s/apps", root);
+    DIR* apps_dir = opendir(apps_path);
+    if (apps_dir == NULL) return;
+    struct dirent* type_ent;
+    while ((type_ent = readdir(apps_dir)) != NULL) {
+        if (type_ent->d_type != DT_DIR) continue;
+        char type_path[96];
+        snprintf(type_path, sizeof(type_path), "%s/%s", apps_path, type_ent->d_name);
+        DIR* type_dir = opendir(type_path);
+        if (type_dir == NULL) continue;
+        struct dirent* app_ent;
+        while ((app_ent = readdir(type_dir)) != NULL) {
+            if (app_ent->d_type != DT_DIR) continue;
+            char app_path[160];
+            snprintf(app_path, sizeof(app_path), "%s/%s", type_path, app_ent->d_name);
+            recover(app_path);
+        }
+        closedir(type_dir);
+    }
+    closedir(apps_dir);
+}
+
+void install_journal_recover() {
+    recover_root("/internal");
+    recover_root("/sd");
+}
@@ -0,0 +1,274 @@
+#include "install_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_management.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_download.h"
+#include "http_pool.h"
+#include "mirrors.h"
+#include "wifi_session.h"
+
+static const char* TAG = "Install queue";
+
+#define INSTALL_QUEUE_STACK    12288  // Installing does TLS handshakes and parses the app info
+#define INSTALL_QUEUE_PRIORITY (tskIDLE_PRIORITY + 1)
+
+typedef struct {
+    install_queue_entry_t entry;
+    bool                  used;
+    uint32_t              sequence;  // Order in which the entries were queued
+} install_slot_t;
+
+static portMUX_TYPE      queue_lock     = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t journal_mutex  = NULL;  // The journal is written by the worker and by the UI
+static install_slot_t    queue_slots[INSTALL_QUEUE_MAX];
+static uint32_t          queue_sequence = 0;
+static bool              queue_running  = false;  // The worker task exists
+static bool              queue_started  = false;  // install_queue_start was called, until then entries are only queued
+
+// Rewrite the journal with the entries that still have to be installed, called without holding the lock
+static void journal_save() {
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    install_queue_entry_t entries[INSTALL_QUEUE_MAX];
+    size_t                count = install_queue_list(entries, INSTALL_QUEUE_MAX);
+
+    FILE* fd = fopen(INSTALL_QUEUE_JOURNAL ".tmp", "w");
+    if (fd == NULL) {
+        ESP_LOGE(TAG, "Failed to write the journal");
+        xSemaphoreGive(journal_mutex);
+        return;
+    }
+    size_t pending = 0;
+    for (size_t index = 0; index < count; index++) {
+        if ((entries[index].state != INSTALL_QUEUED) && (entries[index].state != INSTALL_RUNNING)) continue;
+        fprintf(fd, "%s %s %s %d\n", entries[index].type_slug, entries[index].category_slug, entries[index].app_slug, entries[index].to_sd_card ? 1 : 0);
+        pending++;
+    }
+    fclose(fd);
+    remove(INSTALL_QUEUE_JOURNAL);
+    if (pending == 0) {
+        remove(INSTALL_QUEUE_JOURNAL ".tmp");
+    } else if (rename(INSTALL_QUEUE_JOURNAL ".tmp", INSTALL_QUEUE_JOURNAL) != 0) {
+        ESP_LOGE(TAG, "Failed to replace the journal");
+    }
+    xSemaphoreGive(journal_mutex);
+}
+
+static void set_state(size_t slot, install_state_t state, int percent) {
+    portENTER_CRITICAL(&queue_lock);
+    queue_slots[slot].entry.state   = state;
+    queue_slots[slot].entry.percent = percent;
+    portEXIT_CRITICAL(&queue_lock);
+}
+
+static void install_status(const char* message, int percent, void* user) {
+    ESP_LOGI(TAG, "%s", message);
+    if (percent >= 0) set_state((size_t) user, INSTALL_RUNNING, percent);
+}
+
+static bool install_entry(size_t slot, const install_queue_entry_t* entry) {
+    char url[192];
+    snprintf(url, sizeof(url), MIRROR_HATCHERY_URL "/%s/%s/%s", entry->type_slug, entry->category_slug, entry->app_slug);
+    char*  data_app_info = NULL;
+    size_t size_app_info = 0;
+    if (!download_ram_cached(url, (uint8_t**) &data_app_info, &size_app_info)) {
+        ESP_LOGE(TAG, "Failed to download the app info of %s", entry->app_slug);
+        return false;
+    }
+    cJSON* json_app_info = cJSON_ParseWithLength(data_app_info, size_app_info);
+    bool   success       = false;
+    if (json_app_info != NULL) {
+        success = install_app_status(entry->type_slug, entry->to_sd_card, data_app_info, size_app_info, json_app_info, install_status, (void*) slot);
+        cJSON_Delete(json_app_info);
+    }
+    free(data_app_info);
+    return success;
+}
+
+// Take the entry that was queued first, returns false if there is none
+static bool next_entry(size_t* slot, install_queue_entry_t* entry) {
+    bool found = false;
+    portENTER_CRITICAL(&queue_lock);
+    for (size_t index = 0; index < INSTALL_QUEUE_MAX; index++) {
+        if ((!queue_slots[index].used) || (queue_slots[index].entry.state != INSTALL_QUEUED)) continue;
+        if (found && (queue_slots[index].sequence >= queue_slots[*slot].sequence)) continue;
+        *slot = index;
+        found = true;
+    }
+    if (found) {
+        queue_slots[*slot].entry.state   = INSTALL_RUNNING;
+        queue_slots[*slot].entry.percent = -1;
+        memcpy(entry, &queue_slots[*slot].entry, sizeof(install_queue_entry_t));
+    } else {
+        queue_running = false;  // Checked under the same lock by start_worker, entries added from now on get a new worker
+    }
+    portEXIT_CRITICAL(&queue_lock);
+    return found;
+}
+
+static void install_queue_worker(void* arg) {
+    bool                  connected = false;
+    size_t                slot;
+    install_queue_entry_t entry;
+    while (next_entry(&slot, &entry)) {
+        if (!connected) connected = wifi_session_acquire();
+        if (!connected) {
+            // Without a connection this entry and the remaining ones would fail as well, they stay in the journal for the next boot
+            ESP_LOGW(TAG, "No connection, installing %s later", entry.app_slug);
+            portENTER_CRITICAL(&queue_lock);
+            queue_slots[slot].entry.state = INSTALL_QUEUED;
+            queue_running                 = false;
+            portEXIT_CRITICAL(&queue_lock);
+            break;
+        }
+        bool success = install_entry(slot, &entry);
+        ESP_LOGI(TAG, "%s %s", success ? "Installed" : "Failed to install", entry.app_slug);
+        set_state(slot, success ? INSTALL_DONE : INSTALL_FAILED, -1);
+        journal_save();
+    }
+
+    if (connected) {
+        http_pool_flush();
+        wifi_session_release();
+    }
+    vTaskDelete(NULL);
+}
+
+static void start_worker() {
+    portENTER_CRITICAL(&queue_lock);
+    bool start    = queue_started && (!queue_running);
+    queue_running = queue_running || start;
+    portEXIT_CRITICAL(&queue_lock);
+    if (!start) return;
+    if (xTaskCreate(install_queue_worker, "install_queue", INSTALL_QUEUE_STACK, NULL, INSTALL_QUEUE_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the worker");
+        portENTER_CRITICAL(&queue_lock);
+        queue_running = false;
+        portEXIT_CRITICAL(&queue_lock);
+    }
+}
+
+// Called with the lock held, returns the slot of the new entry or -1 if the queue is full
+static int add_entry(const char* type_slug, const char* category_slug, const char* app_slug, bool to_sd_card) {
+    int slot = -1;
+    for (size_t index = 0; index < INSTALL_QUEUE_MAX; index++) {
+        install_slot_t* candidate = &queue_slots[index];
+        if (candidate->used && (strcmp(candidate->entry.type_slug, type_slug) == 0) && (strcmp(candidate->entry.app_slug, app_slug) == 0)) {
+            if (candidate->entry.state == INSTALL_QUEUED) return index;
+            if (candidate->entry.state == INSTALL_RUNNING) continue;  // Queued again, for example after an update was published
+            slot = index;
+            break;
+        }
+        if ((slot < 0) && ((!candidate->used) || (candidate->entry.state == INSTALL_DONE) || (candidate->entry.state == INSTALL_FAILED))) slot = index;
+    }
+    if (slot < 0) return -1;
+
+    install_slot_t* target = &queue_slots[slot];
+    memset(target, 0, sizeof(install_slot_t));
+    strncpy(target->entry.type_slug, type_slug, sizeof(target->entry.type_slug) - 1);
+    strncpy(target->entry.category_slug, category_slug, sizeof(target->entry.category_slug) - 1);
+    strncpy(target->entry.app_slug, app_slug, sizeof(target->entry.app_slug) - 1);
+    target->entry.to_sd_card = to_sd_card;
+    target->entry.state      = INSTALL_QUEUED;
+    target->entry.percent    = -1;
+    target->used             = true;
+    target->sequence         = queue_sequence++;
+    return slot;
+}
+
+void install_queue_init() {
+    journal_mutex = xSemaphoreCreateMutex();
+    FILE* fd      = fopen(INSTALL_QUEUE_JOURNAL, "r");
+    // journal_save removes the old journal before renaming the new one, a reset in between leaves only the new one
+    if (fd == NULL) fd = fopen(INSTALL_QUEUE_JOURNAL ".tmp", "r");
+    if (fd == NULL) return;
+    char   type_slug[32];
+    char   category_slug[32];
+    char   app_slug[64];
+    int    to_sd_card;
+    size_t count = 0;
+    while (fscanf(fd, "%31s %31s %63s %d", type_slug, category_slug, app_slug, &to_sd_card) == 4) {
+        portENTER_CRITICAL(&queue_lock);
+        if (add_entry(type_slug, category_slug, app_slug, to_sd_card != 0) >= 0) count++;
+        portEXIT_CRITICAL(&queue_lock);
+    }
+    fclose(fd);
+    ESP_LOGI(TAG, "Resuming %u queued installs", count);
+}
+
+void install_queue_start() {
+    bool queued = false;
+    portENTER_CRITICAL(&queue_lock);
+    queue_started = true;
+    for (size_t index = 0; index < INSTALL_QUEUE_MAX; index++) {
+        if (queue_slots[index].used && (queue_slots[index].entry.state == INSTALL_QUEUED)) queued = true;
+    }
+    portEXIT_CRITICAL(&queue_lock);
+    if (queued) start_worker();
+}
+
+bool install_queue_add(const char* type_slug, const char* category_slug, const char* app_slug, bool to_sd_card) {
+    install_queue_entry_t* fields = &queue_slots[0].entry;
+    if ((strlen(type_slug) >= sizeof(fields->type_slug)) || (strlen(category_slug) >= sizeof(fields->category_slug)) ||
+        (strlen(app_slug) >= sizeof(fields->app_slug))) {
+        return false;  // Would not be recognized when truncated
+    }
+    portENTER_CRITICAL(&queue_lock);
+    int slot = add_entry(type_slug, category_slug, app_slug, to_sd_card);
+    portEXIT_CRITICAL(&queue_lock);
+    if (slot < 0) return false;
+    journal_save();
+    start_worker();
+    return true;
+}
+
+bool install_queue_get(const char* type_slug, const char* app_slug, install_queue_entry_t* entry) {
+    bool     found    = false;
+    uint32_t sequence = 0;
+    portENTER_CRITICAL(&queue_lock);
+    for (size_t index = 0; index < INSTALL_QUEUE_MAX; index++) {
+        install_slot_t* slot = &queue_slots[index];
+        if ((!slot->used) || (strcmp(slot->entry.type_slug, type_slug) != 0) || (strcmp(slot->entry.app_slug, app_slug) != 0)) continue;
+        if (found && (slot->sequence < sequence)) continue;  // Report the most recent entry
+        memcpy(entry, &slot->entry, sizeof(install_queue_entry_t));
+        sequence = slot->sequence;
+        found    = true;
+    }
+    portEXIT_CRITICAL(&queue_lock);
+    return found;
+}
+
+size_t install_queue_list(install_queue_entry_t* entries, size_t max) {
+    uint32_t sequences[INSTALL_QUEUE_MAX];
+    size_t   count = 0;
+    portENTER_CRITICAL(&queue_lock);
+    for (size_t index = 0; index < INSTALL_QUEUE_MAX; index++) {
+        if (!queue_slots[index].used) continue;
+        // Insertion sort on the sequence number, the queue is small
+        size_t position = count;
+        while ((position > 0) && (sequences[position - 1] > queue_slots[index].sequence)) position--;
+        if (position >= max) continue;
+        size_t last = (count < max) ? count : (max - 1);
+        memmove(&entries[position + 1], &entries[position], (last - position) * sizeof(install_queue_entry_t));
+        memmove(&sequences[position + 1], &sequences[position], (last - position) * sizeof(uint32_t));
+        memcpy(&entries[position], &queue_slots[index].entry, sizeof(install_queue_entry_t));
+        sequences[position] = queue_slots[index].sequence;
+        if (count < max) count++;
+    }
+    portEXIT_CRITICAL(&queue_lock);
+    return count;
+}
+
+bool install_queue_busy() {
+    portENTER_CRITICAL(&queue_lock);
+    bool busy = queue_running;
+    portEXIT_CRITICAL(&queue_lock);
+    return busy;
+}
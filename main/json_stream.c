@@ -0,0 +1,262 @@
+#include "json_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_STREAM_MISSING UINT32_MAX
+#define JSON_STREAM_MAX_DEPTH 32
+
+void json_stream_init(json_stream_t* stream, const char* const* fields, size_t field_count) {
+    memset(stream, 0, sizeof(json_stream_t));
+    stream->fields      = fields;
+    stream->field_count = (field_count <= JSON_STREAM_MAX_FIELDS) ? field_count : JSON_STREAM_MAX_FIELDS;
+    stream->field       = -1;
+}
+
+void json_stream_reset(json_stream_t* stream) {
+    const char* const* fields        = stream->fields;
+    size_t             field_count   = stream->field_count;
+    char*              arena         = stream->arena;
+    size_t             arena_size    = stream->arena_size;
+    uint32_t*          offsets       = stream->offsets;
+    size_t             item_capacity = stream->item_capacity;
+    json_stream_init(stream, fields, field_count);
+    stream->arena         = arena;
+    stream->arena_size    = arena_size;
+    stream->offsets       = offsets;
+    stream->item_capacity = item_capacity;
+}
+
+void json_stream_free(json_stream_t* stream) {
+    free(stream->arena);
+    free(stream->offsets);
+    json_stream_init(stream, stream->fields, stream->field_count);
+}
+
+static bool arena_append(json_stream_t* stream, const char* data, size_t length) {
+    if (stream->arena_used + length > stream->arena_size) {
+        size_t new_size = (stream->arena_size > 0) ? stream->arena_size : 256;
+        while (stream->arena_used + length > new_size) new_size *= 2;
+        char* arena = realloc(stream->arena, new_size);
+        if (arena == NULL) return false;
+        stream->arena      = arena;
+        stream->arena_size = new_size;
+    }
+    memcpy(&stream->arena[stream->arena_used], data, length);
+    stream->arena_used += length;
+    return true;
+}
+
+static bool append_code_point(json_stream_t* stream, uint32_t code_point) {
+    char   utf8[4];
+    size_t length;
+    if (code_point < 0x80) {
+        utf8[0] = code_point;
+        length  = 1;
+    } else if (code_point < 0x800) {
+        utf8[0] = 0xC0 | (code_point >> 6);
+        utf8[1] = 0x80 | (code_point & 0x3F);
+        length  = 2;
+    } else if (code_point < 0x10000) {
+        utf8[0] = 0xE0 | (code_point >> 12);
+        utf8[1] = 0x80 | ((code_point >> 6) & 0x3F);
+        utf8[2] = 0x80 | (code_point & 0x3F);
+        length  = 3;
+    } else {
+        utf8[0] = 0xF0 | (code_point >> 18);
+        utf8[1] = 0x80 | ((code_point >> 12) & 0x3F);
+        utf8[2] = 0x80 | ((code_point >> 6) & 0x3F);
+        utf8[3] = 0x80 | (code_point & 0x3F);
+        length  = 4;
+    }
+    return arena_append(stream, utf8, length);
+}
+
+static bool start_item(json_stream_t* stream) {
+    if (stream->item_count >= stream->item_capacity) {
+        size_t    capacity = (stream->item_capacity > 0) ? stream->item_capacity * 2 : 16;
+        uint32_t* offsets  = realloc(stream->offsets, capacity * stream->field_count * sizeof(uint32_t));
+        if (offsets == NULL) return false;
+        stream->offsets       = offsets;
+        stream->item_capacity = capacity;
+    }
+    for (size_t field = 0; field < stream->field_count; field++) {
+        stream->offsets[stream->item_count * stream->field_count + field] = JSON_STREAM_MISSING;
+    }
+    stream->item_count++;
+    return true;
+}
+
+static bool in_object(const json_stream_t* stream) { return (stream->depth > 0) && (stream->object_mask & (1UL << (stream->depth - 1))); }
+
+// Objects directly inside the top level array are the items
+static bool in_item(const json_stream_t* stream) { return (stream->depth == 2) && ((stream->object_mask & 0x3) == 0x2); }
+
+static int match_field(const json_stream_t* stream) {
+    if (stream->key_overflow) return -1;
+    for (size_t field = 0; field < stream->field_count; field++) {
+        if ((strlen(stream->fields[field]) == stream->key_length) && (memcmp(stream->fields[field], stream->key, stream->key_length) == 0)) return field;
+    }
+    return -1;
+}
+
+// Add a character of the current string to the key buffer or the arena
+static bool string_char(json_stream_t* stream, uint32_t code_point) {
+    if (stream->is_key) {
+        if ((code_point >= 0x80) || (stream->key_length >= JSON_STREAM_MAX_KEY)) {
+            stream->key_overflow = true;
+        } else {
+            stream->key[stream->key_length++] = code_point;
+        }
+        return true;
+    }
+    if (stream->field < 0) return true;
+    return append_code_point(stream, code_point);
+}
+
+static bool string_end(json_stream_t* stream) {
+    stream->in_string = false;
+    if (stream->is_key) {
+        stream->field = in_item(stream) ? match_field(stream) : -1;
+        return true;
+    }
+    if (stream->field >= 0) {
+        if (!arena_append(stream, "", 1)) return false;
+        stream->offsets[(stream->item_count - 1) * stream->field_count + stream->field] = stream->value_start;
+        stream->field = -1;
+    }
+    return true;
+}
+
+static bool string_start(json_stream_t* stream) {
+    stream->in_string = true;
+    stream->is_key    = in_object(stream) && stream->expect_key;
+    if (stream->is_key) {
+        stream->key_length   = 0;
+        stream->key_overflow = false;
+    } else if (!in_item(stream)) {
+        stream->field = -1;  // Only string values directly inside an item are extracted
+    }
+    stream->value_start = stream->arena_used;
+    return true;
+}
+
+static bool parse_escape(json_stream_t* stream, char c) {
+    stream->escape = false;
+    switch (c) {
+        case 'b':
+            return string_char(stream, '\b');
+        case 'f':
+            return string_char(stream, '\f');
+        case 'n':
+            return string_char(stream, '\n');
+        case 'r':
+            return string_char(stream, '\r');
+        case 't':
+            return string_char(stream, '\t');
+        case 'u':
+            stream->unicode_left = 4;
+            stream->unicode      = 0;
+            return true;
+        default:
+            return string_char(stream, (uint8_t) c);
+    }
+}
+
+static bool parse_unicode(json_stream_t* stream, char c) {
+    uint32_t digit;
+    if ((c >= '0') && (c <= '9')) {
+        digit = c - '0';
+    } else if ((c >= 'a') && (c <= 'f')) {
+        digit = c - 'a' + 10;
+    } else if ((c >= 'A') && (c <= 'F')) {
+        digit = c - 'A' + 10;
+    } else {
+        return false;
+    }
+    stream->unicode = (stream->unicode << 4) | digit;
+    if (--stream->unicode_left > 0) return true;
+
+    uint32_t code_point = stream->unicode;
+    if ((code_point >= 0xD800) && (code_point < 0xDC00)) {
+        stream->surrogate = code_point;  // Wait for the low surrogate
+        return true;
+    }
+    if ((code_point >= 0xDC00) && (code_point < 0xE000)) {
+        if (stream->surrogate == 0) return string_char(stream, '?');
+        code_point        = 0x10000 + ((stream->surrogate - 0xD800) << 10) + (code_point - 0xDC00);
+        stream->surrogate = 0;
+    }
+    return string_char(stream, code_point);
+}
+
+static bool parse_char(json_stream_t* stream, char c) {
+    if (stream->in_string) {
+        if (stream->unicode_left > 0) return parse_unicode(stream, c);
+        if (stream->escape) return parse_escape(stream, c);
+        if (c == '\\') {
+            stream->escape = true;
+            return true;
+        }
+        if (c == '"') return string_end(stream);
+        return string_char(stream, (uint8_t) c);
+    }
+
+    switch (c) {
+        case '{':
+        case '[':
+            if (stream->depth >= JSON_STREAM_MAX_DEPTH) return false;
+            if (c == '{') {
+                stream->object_mask |= (1UL << stream->depth);
+            } else {
+                stream->object_mask &= ~(1UL << stream->depth);
+            }
+            stream->depth++;
+            stream->expect_key = (c == '{');
+            if (in_item(stream)) {
+                stream->field = -1;
+                return start_item(stream);
+            }
+            return true;
+        case '}':
+        case ']':
+            if (stream->depth == 0) return false;
+            if (in_object(stream) != (c == '}')) return false;
+            stream->depth--;
+            stream->expect_key = false;
+            stream->field      = -1;
+            return true;
+        case '"':
+            return string_start(stream);
+        case ':':
+            stream->expect_key = false;
+            return true;
+        case ',':
+            stream->expect_key = in_object(stream);
+            stream->field      = -1;
+            return true;
+        default:
+            // Whitespace, numbers, true, false and null are skipped
+            return true;
+    }
+}
+
+bool json_stream_feed(json_stream_t* stream, const char* data, size_t length) {
+    if (stream->error) return false;
+    for (size_t position = 0; position < length; position++) {
+        if (!parse_char(stream, data[position])) {
+            stream->error = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool json_stream_finish(json_stream_t* stream) { return (!stream->error) && (!stream->in_string) && (stream->depth == 0); }
+
+const char* json_stream_get(const json_stream_t* stream, size_t index, size_t field) {
+    if ((index >= stream->item_count) || (field >= stream->field_count)) return NULL;
+    uint32_t offset = stream->offsets[index * stream->field_count + field];
+    if (offset == JSON_STREAM_MISSING) return NULL;
+    return &stream->arena[offset];
+}
@@ -13,6 +13,7 @@
 
 #include "appfs.h"
 #include "appfs_wrapper.h"
+#include "boot_trace.h"
 #include "bootscreen.h"
 #include "driver/uart.h"
 #include "efuse.h"
@@ -25,15 +26,17 @@
 #include "graphics_wrapper.h"
 #include "gui_element_header.h"
 #include "hardware.h"
+#include "install_journal.h"
+#include "install_queue.h"
 #include "managed_i2c.h"
 #include "menu.h"
 #include "menus/start.h"
+#include "mirrors.h"
 #include "pax_gfx.h"
 #include "rtc_memory.h"
 #include "sao_eeprom.h"
 #include "settings.h"
 #include "system_wrapper.h"
-#include "wifi_cert.h"
 #include "wifi_connection.h"
 #include "wifi_defaults.h"
 #include "wifi_ota.h"
@@ -81,6 +84,50 @@ void stop() {
 const char* fatal_error_str = "A fatal error occured";
 const char* reset_board_str = "Reset the board to try again";
 
+static esp_err_t boot_nvs() { return nvs_init(); }
+
+static esp_err_t boot_appfs() { return appfs_init(); }
+
+static esp_err_t boot_leds() {
+    ws2812_init(GPIO_LED_DATA);
+    const uint8_t led_off[15] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    ws2812_send_data(led_off, sizeof(led_off));
+    return ESP_OK;
+}
+
+static esp_err_t boot_screen() {
+    display_boot_screen("Starting...");
+    return ESP_OK;
+}
+
+typedef enum _boot_step_id {
+    BOOT_BSP,
+    BOOT_NVS,
+    BOOT_APPFS,
+    BOOT_INTERNAL_FS,
+    BOOT_LEDS,
+    BOOT_SCREEN,
+    BOOT_STEPS,
+} boot_step_id_t;
+
+// The flash is set up while the display resets, which takes 100 ms
+static const boot_step_t boot_steps[BOOT_STEPS] = {
+    [BOOT_BSP]         = {.name = "BSP", .run = bsp_init, .pinned = true},
+    [BOOT_NVS]         = {.name = "NVS", .run = boot_nvs},
+    [BOOT_APPFS]       = {.name = "AppFS", .run = boot_appfs},
+    [BOOT_INTERNAL_FS] = {.name = "Internal FS", .run = mount_internal_filesystem},
+    [BOOT_LEDS]        = {.name = "LEDs", .run = boot_leds, .pinned = true},
+    [BOOT_SCREEN]      = {.name = "Boot screen", .run = boot_screen, .depends = 1 << BOOT_BSP},
+};
+
+static const char* boot_errors[BOOT_STEPS] = {
+    [BOOT_NVS]         = "NVS failed to initialize",
+    [BOOT_APPFS]       = "Failed to initialize AppFS",
+    [BOOT_INTERNAL_FS] = "Failed to initialize flash FS",
+    [BOOT_LEDS]        = "Failed to initialize LEDs",
+    [BOOT_SCREEN]      = "Failed to show boot screen",
+};
+
 void app_main(void) {
     esp_err_t res;
 
@@ -88,21 +135,24 @@ void app_main(void) {
     ESP_LOGI(TAG, "App version: %s", app_description->version);
     // ESP_LOGI(TAG, "Project name: %s", app_description->project_name);
 
-    /* Initialize hardware */
+    /* Initialize hardware and storage, concurrently where possible */
 
+    int stage = boot_trace_begin("eFuse");
     efuse_protect();
+    boot_trace_end(stage, ESP_OK);
 
-    if (bsp_init() != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize basic board support functions");
-        esp_restart();
-    }
-
-    /* Start NVS */
-    res = nvs_init();
-    if (res != ESP_OK) {
-        ESP_LOGE(TAG, "NVS init failed: %d", res);
-        display_fatal_error(fatal_error_str, "NVS failed to initialize", "Flash may be corrupted", NULL);
-        stop();
+    esp_err_t boot_results[BOOT_STEPS];
+    if (!boot_trace_run(boot_steps, BOOT_STEPS, boot_results)) {
+        if (boot_results[BOOT_BSP] != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to initialize basic board support functions");
+            esp_restart();
+        }
+        for (size_t index = 0; index < BOOT_STEPS; index++) {
+            if (boot_results[index] == ESP_OK) continue;
+            ESP_LOGE(TAG, "%s init failed: %d", boot_steps[index].name, boot_results[index]);
+            display_fatal_error(fatal_error_str, boot_errors[index], "Flash may be corrupted", reset_board_str);
+            stop();
+        }
     }
 
     nvs_handle_t handle;
@@ -115,35 +165,13 @@ void app_main(void) {
 
     pax_buf_t* pax_buffer = get_pax_buffer();
 
-    display_boot_screen("Starting...");
-
-    /* Start AppFS */
-    res = appfs_init();
-    if (res != ESP_OK) {
-        ESP_LOGE(TAG, "AppFS init failed: %d", res);
-        display_fatal_error(fatal_error_str, "Failed to initialize AppFS", "Flash may be corrupted", reset_board_str);
-        stop();
-    }
-
-    /* Start internal filesystem */
-    if (mount_internal_filesystem() != ESP_OK) {
-        display_fatal_error(fatal_error_str, "Failed to initialize flash FS", "Flash may be corrupted", reset_board_str);
-        stop();
-    }
-
     /* Start SD card filesystem */
     bool sdcard_mounted = (mount_sdcard_filesystem() == ESP_OK);
     if (sdcard_mounted) {
         ESP_LOGI(TAG, "SD card filesystem mounted");
     }
 
-    ws2812_init(GPIO_LED_DATA);
-    const uint8_t led_off[15] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    ws2812_send_data(led_off, sizeof(led_off));
-
-    /* Start WiFi */
-    wifi_init();
-
+    /* The WiFi stack and the TLS certificates are initialized on first use, most boots never need them */
     if (!wifi_check_configured()) {
         if (wifi_set_defaults()) {
             const pax_font_t* font = pax_font_saira_regular;
@@ -158,15 +186,21 @@ void app_main(void) {
         }
     }
 
-    res = init_ca_store();
-    if (res != ESP_OK) {
-        display_fatal_error(fatal_error_str, "Failed to initialize", "TLS certificate storage", reset_board_str);
-        stop();
-    }
+    /* Load the download mirror configuration, the servers are probed on first use */
+    mirrors_init();
+
+    /* Continue installing apps queued before the last reboot, and installs that were interrupted by a reset (recovered before the worker starts) */
+    stage = boot_trace_begin("Install queue");
+    install_queue_init();
+    install_journal_recover();
+    install_queue_start();
+    boot_trace_end(stage, ESP_OK);
 
     /* Clear RTC memory */
     rtc_memory_clear();
 
+    boot_trace_done();
+
     /* Launcher menu */
     while (true) {
         menu_start(app_description->version);
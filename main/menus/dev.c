@@ -11,9 +11,13 @@
 #include <string.h>
 
 #include "appfs.h"
+#include "boot_stats.h"
 #include "button_test.h"
 #include "file_browser.h"
 #include "hardware.h"
+#include "http_stats.h"
+#include "input_latency.h"
+#include "input_stats.h"
 #include "menu.h"
 #include "pax_codecs.h"
 #include "pax_gfx.h"
@@ -30,6 +34,9 @@ typedef enum action {
     ACTION_FILE_BROWSER_INT,
     ACTION_BUTTON_TEST,
     ACTION_SAO,
+    ACTION_INPUT_STATS,
+    ACTION_HTTP_STATS,
+    ACTION_BOOT_STATS,
 } menu_dev_action_t;
 
 static void render_help(pax_buf_t* pax_buffer) {
@@ -62,22 +69,26 @@ void menu_dev(xQueueHandle button_queue) {
     menu_insert_item(menu, "File browser (internal)", NULL, (void*) ACTION_FILE_BROWSER_INT, -1);
     menu_insert_item(menu, "Button test", NULL, (void*) ACTION_BUTTON_TEST, -1);
     menu_insert_item(menu, "SAO EEPROM tool", NULL, (void*) ACTION_SAO, -1);
+    menu_insert_item(menu, "Input latency", NULL, (void*) ACTION_INPUT_STATS, -1);
+    menu_insert_item(menu, "Network timing", NULL, (void*) ACTION_HTTP_STATS, -1);
+    menu_insert_item(menu, "Boot timing", NULL, (void*) ACTION_BOOT_STATS, -1);
 
     bool              render = true;
     menu_dev_action_t action = ACTION_NONE;
 
     render_help(pax_buffer);
+    input_latency_set_screen("tools");
 
     while (1) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
                         action = ACTION_BACK;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, button_message.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
@@ -104,12 +115,19 @@ void menu_dev(xQueueHandle button_queue) {
                 test_buttons(button_queue);
             } else if (action == ACTION_SAO) {
                 menu_sao(button_queue);
+            } else if (action == ACTION_INPUT_STATS) {
+                show_input_stats();
+            } else if (action == ACTION_HTTP_STATS) {
+                show_http_stats();
+            } else if (action == ACTION_BOOT_STATS) {
+                show_boot_stats();
             } else if (action == ACTION_BACK) {
                 break;
             }
             action = ACTION_NONE;
             render = true;
             render_help(pax_buffer);
+            input_latency_set_screen("tools");
         }
     }
 
@@ -18,12 +18,19 @@
 #include "gui_element_header.h"
 #include "hardware.h"
 #include "http_download.h"
+#include "http_pool.h"
+#include "http_prefetch.h"
+#include "input_latency.h"
+#include "install_queue.h"
+#include "json_stream.h"
 #include "menu.h"
 #include "metadata.h"
+#include "mirrors.h"
 #include "pax_codecs.h"
 #include "pax_gfx.h"
 #include "system_wrapper.h"
 #include "wifi_connect.h"
+#include "wifi_session.h"
 
 extern const uint8_t hatchery_png_start[] asm("_binary_hatchery_png_start");
 extern const uint8_t hatchery_png_end[] asm("_binary_hatchery_png_end");
@@ -31,6 +38,9 @@ extern const uint8_t hatchery_png_end[] asm("_binary_hatchery_png_end");
 static const char* esp32_type   = "esp32";
 static const char* esp32_bin_fn = "main.bin";
 
+#define HATCHERY_PREFETCH_DELAY_MS 400  // Time the highlight has to rest on an entry before its contents are prefetched
+#define HATCHERY_QUEUE_POLL_MS     500  // Interval at which the state of a queued install is redrawn
+
 static menu_t* hatchery_menu_create(const char* title) {
     menu_t* menu             = menu_alloc(title, 34, 18);
     menu->fgColor            = 0xFF000000;
@@ -56,22 +66,26 @@ static void hatchery_menu_destroy(menu_t* menu) {
     menu_free(menu);
 }
 
-int wait_for_button_press(TickType_t timeout) {
+int wait_for_button_press(TickType_t timeout, uint16_t* count) {
     int button = -1;
     while (true) {
         input_message_t message;
-        xQueueReceive(get_input_queue(), &message, portMAX_DELAY);
+        if (!input_buffer_receive(&message, timeout)) return -1;
         button = message.input;
+        if (count != NULL) *count = message.count;
         if (message.state) break;
     }
     return button;
 }
 
-static void* hatchery_menu_show(menu_t* menu, const char* prompt, bool* back_btn) {
+// The URL of the contents of the highlighted entry is `prefetch_prefix` followed by its slug and `prefetch_suffix`
+static void* hatchery_menu_show(menu_t* menu, const char* prompt, bool* back_btn, const char* prefetch_prefix, const char* prefetch_suffix) {
     pax_buf_t* pax_buffer   = get_pax_buffer();
     bool       quit         = false;
     bool       render       = true;
+    bool       prefetched   = false;
     void*      return_value = NULL;
+    input_latency_set_screen("hatchery");
     while (!quit) {
         if (render) {
             pax_background(pax_buffer, 0xFFFFFF);
@@ -81,16 +95,29 @@ static void* hatchery_menu_show(menu_t* menu, const char* prompt, bool* back_btn
             render = false;
         }
 
-        int button   = wait_for_button_press(portMAX_DELAY);
-        return_value = menu_get_callback_args(menu, menu_get_position(menu));
+        uint16_t count  = 1;
+        int      button = wait_for_button_press(prefetched ? portMAX_DELAY : pdMS_TO_TICKS(HATCHERY_PREFETCH_DELAY_MS), &count);
+        return_value    = menu_get_callback_args(menu, menu_get_position(menu));
+        if (button < 0) {
+            // The highlight rests on this entry, fetch its contents in the background
+            if (return_value != NULL) {
+                char url[128];
+                snprintf(url, sizeof(url), "%s%s%s", prefetch_prefix, (const char*) return_value, prefetch_suffix);
+                http_prefetch(url);
+            }
+            prefetched = true;
+            continue;
+        }
         switch (button) {
             case INPUT_TOUCH0:
                 quit = true;
                 if (back_btn) *back_btn = true;
                 break;
             case INPUT_TOUCH1:
-                menu_navigate_next(menu);
-                render = true;
+                menu_navigate_next_steps(menu, count);
+                http_prefetch_cancel();
+                prefetched = false;
+                render     = true;
                 break;
             case INPUT_TOUCH2:
                 quit = true;
@@ -103,71 +130,30 @@ static void* hatchery_menu_show(menu_t* menu, const char* prompt, bool* back_btn
     return return_value;
 }
 
-static char*  data_types = NULL;
-static size_t size_types = 0;
-static cJSON* json_types = NULL;
-
-static char*  data_categories = NULL;
-static size_t size_categories = 0;
-static cJSON* json_categories = NULL;
+// Only the fields shown in the menus are extracted from the listings
+static const char* const listing_fields[] = {"slug", "name"};
+#define LISTING_SLUG 0
+#define LISTING_NAME 1
 
-static char*  data_apps = NULL;
-static size_t size_apps = 0;
-static cJSON* json_apps = NULL;
+static json_stream_t listing_types      = {0};
+static json_stream_t listing_categories = {0};
+static json_stream_t listing_apps       = {0};
 
 static char*  data_app_info = NULL;
 static size_t size_app_info = 0;
 static cJSON* json_app_info = NULL;
 
-static bool connect_to_wifi() {
-    if (!wifi_connect_to_stored()) {
-        wifi_disconnect_and_disable();
-        render_message("Unable to connect to\nthe WiFi network");
-        display_flush();
-        wait_for_button();
-        return false;
-    }
-    return true;
-}
-
-static void hatchery_free_types() {
-    if (json_types != NULL) {
-        cJSON_Delete(json_types);
-        json_types = NULL;
-    }
-
-    if (data_types != NULL) {
-        free(data_types);
-        data_types = NULL;
-        size_types = 0;
-    }
+static void show_wifi_error() {
+    render_message("Unable to connect to\nthe WiFi network");
+    display_flush();
+    wait_for_button();
 }
 
-static void hatchery_free_categories() {
-    if (json_categories != NULL) {
-        cJSON_Delete(json_categories);
-        json_categories = NULL;
-    }
+static void hatchery_free_types() { json_stream_free(&listing_types); }
 
-    if (data_categories != NULL) {
-        free(data_categories);
-        data_categories = NULL;
-        size_categories = 0;
-    }
-}
+static void hatchery_free_categories() { json_stream_free(&listing_categories); }
 
-static void hatchery_free_apps() {
-    if (json_apps != NULL) {
-        cJSON_Delete(json_apps);
-        json_apps = NULL;
-    }
-
-    if (data_apps != NULL) {
-        free(data_apps);
-        data_apps = NULL;
-        size_apps = 0;
-    }
-}
+static void hatchery_free_apps() { json_stream_free(&listing_apps); }
 
 static void hatchery_free_app_info() {
     if (json_app_info != NULL) {
@@ -195,43 +181,53 @@ static void show_communication_error() {
     wait_for_button();
 }
 
-static bool load_types() {
-    if (data_types == NULL) {
-        bool success = download_ram("https://mch2022.badge.team/v2/mch2022/types", (uint8_t**) &data_types, &size_types);
-        if (!success) return false;
+static bool listing_receive(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    json_stream_t* listing = (json_stream_t*) user;
+    if (offset == 0) json_stream_reset(listing);  // Start of a (retried) download
+    return json_stream_feed(listing, (const char*) data, length);
+}
+
+static bool load_listing(const char* url, json_stream_t* listing) {
+    http_prefetch_wait(url);
+    json_stream_init(listing, listing_fields, sizeof(listing_fields) / sizeof(listing_fields[0]));
+    if ((!download_stream_cached(url, listing_receive, listing)) || (!json_stream_finish(listing))) {
+        json_stream_free(listing);
+        return false;
     }
-    if (data_types == NULL) return false;
-    json_types = cJSON_ParseWithLength(data_types, size_types);
-    if (json_types == NULL) return false;
     return true;
 }
 
+static void listing_to_menu(const json_stream_t* listing, menu_t* menu) {
+    for (size_t index = 0; index < listing->item_count; index++) {
+        const char* slug = json_stream_get(listing, index, LISTING_SLUG);
+        const char* name = json_stream_get(listing, index, LISTING_NAME);
+        if (slug == NULL) continue;
+        menu_insert_item(menu, (name != NULL) ? name : slug, NULL, (void*) slug, -1);
+    }
+}
+
+static bool load_types() {
+    if (listing_types.item_count > 0) return true;
+    return load_listing(MIRROR_HATCHERY_URL "/types", &listing_types);
+}
+
 static bool load_categories(const char* type_slug) {
     char url[128];
-    snprintf(url, sizeof(url) - 1, "https://mch2022.badge.team/v2/mch2022/%s/categories", type_slug);
-    bool success = download_ram(url, (uint8_t**) &data_categories, &size_categories);
-    if (!success) return false;
-    if (data_categories == NULL) return false;
-    json_categories = cJSON_ParseWithLength(data_categories, size_categories);
-    if (json_categories == NULL) return false;
-    return true;
+    snprintf(url, sizeof(url) - 1, MIRROR_HATCHERY_URL "/%s/categories", type_slug);
+    return load_listing(url, &listing_categories);
 }
 
 static bool load_apps(const char* type_slug, const char* category_slug) {
     char url[128];
-    snprintf(url, sizeof(url) - 1, "https://mch2022.badge.team/v2/mch2022/%s/%s", type_slug, category_slug);
-    bool success = download_ram(url, (uint8_t**) &data_apps, &size_apps);
-    if (!success) return false;
-    if (data_apps == NULL) return false;
-    json_apps = cJSON_ParseWithLength(data_apps, size_apps);
-    if (json_apps == NULL) return false;
-    return true;
+    snprintf(url, sizeof(url) - 1, MIRROR_HATCHERY_URL "/%s/%s", type_slug, category_slug);
+    return load_listing(url, &listing_apps);
 }
 
 static bool load_app_info(const char* type_slug, const char* category_slug, const char* app_slug) {
     char url[128];
-    snprintf(url, sizeof(url) - 1, "https://mch2022.badge.team/v2/mch2022/%s/%s/%s", type_slug, category_slug, app_slug);
-    bool success = download_ram(url, (uint8_t**) &data_app_info, &size_app_info);
+    snprintf(url, sizeof(url) - 1, MIRROR_HATCHERY_URL "/%s/%s/%s", type_slug, category_slug, app_slug);
+    http_prefetch_wait(url);
+    bool success = download_ram_cached(url, (uint8_t**) &data_app_info, &size_app_info);
     if (!success) return false;
     if (data_app_info == NULL) return false;
     json_app_info = cJSON_ParseWithLength(data_app_info, size_app_info);
@@ -239,11 +235,15 @@ static bool load_app_info(const char* type_slug, const char* category_slug, cons
     return true;
 }
 
-bool menu_hatchery_install_app_execute(const char* type_slug, bool to_sd_card) {
-    return install_app(true, type_slug, to_sd_card, data_app_info, size_app_info, json_app_info);
+static bool queue_install(const char* type_slug, const char* category_slug, const char* app_slug, bool to_sd_card) {
+    if (install_queue_add(type_slug, category_slug, app_slug, to_sd_card)) return true;
+    render_message("Can not install app\nThe install queue is full");
+    display_flush();
+    wait_for_button();
+    return false;
 }
 
-bool menu_hatchery_install_app(const char* type_slug) {
+bool menu_hatchery_install_app(const char* type_slug, const char* category_slug, const char* app_slug) {
     pax_buf_t* pax_buffer  = get_pax_buffer();
     cJSON*     name_obj    = cJSON_GetObjectItem(json_app_info, "name");
     cJSON*     author_obj  = cJSON_GetObjectItem(json_app_info, "author");
@@ -324,10 +324,11 @@ bool menu_hatchery_install_app(const char* type_slug) {
             render = false;
         }
 
-        int button = wait_for_button_press(portMAX_DELAY);
+        uint16_t count  = 1;
+        int      button = wait_for_button_press(portMAX_DELAY, &count);
         switch (button) {
             case INPUT_TOUCH1:
-                menu_navigate_next(menu);
+                menu_navigate_next_steps(menu, count);
                 render = true;
                 break;
             case INPUT_TOUCH2:
@@ -335,10 +336,10 @@ bool menu_hatchery_install_app(const char* type_slug) {
                     int action = (int) menu_get_callback_args(menu, menu_get_position(menu));
                     switch (action) {
                         case 0:
-                            result = menu_hatchery_install_app_execute(type_slug, false);
+                            result = queue_install(type_slug, category_slug, app_slug, false);
                             break;
                         case 1:
-                            result = menu_hatchery_install_app_execute(type_slug, true);
+                            result = queue_install(type_slug, category_slug, app_slug, true);
                             break;
                         case 2:
                         default:
@@ -374,8 +375,12 @@ bool menu_hatchery_app_info(const char* type_slug, const char* category_slug, co
     cJSON* description_obj = cJSON_GetObjectItem(json_app_info, "description");
     cJSON* version_obj     = cJSON_GetObjectItem(json_app_info, "version");
 
-    bool render = true;
-    bool quit   = false;
+    input_latency_set_screen("hatchery");
+
+    bool                  render = true;
+    bool                  quit   = false;
+    install_queue_entry_t queued;
+    bool                  in_queue = install_queue_get(type_slug, app_slug, &queued);
     while (!quit) {
         if (render) {
             pax_background(pax_buffer, 0xFFFFFF);
@@ -388,12 +393,41 @@ bool menu_hatchery_app_info(const char* type_slug, const char* category_slug, co
             snprintf(buffer, sizeof(buffer) - 1, "Version: %u", version_obj->valueint);
             pax_draw_text(pax_buffer, 0xFF491d88, pax_font_saira_regular, 18, 5, 52 + 20 * 2, buffer);
             pax_draw_text(pax_buffer, 0xFF491d88, pax_font_saira_regular, 18, 5, 52 + 20 * 3, description_obj->valuestring);
+            if (in_queue) {
+                switch (queued.state) {
+                    case INSTALL_QUEUED:
+                        snprintf(buffer, sizeof(buffer) - 1, "Waiting to be installed");
+                        break;
+                    case INSTALL_RUNNING:
+                        if (queued.percent >= 0) {
+                            snprintf(buffer, sizeof(buffer) - 1, "Installing... %d%%", queued.percent);
+                        } else {
+                            snprintf(buffer, sizeof(buffer) - 1, "Installing...");
+                        }
+                        break;
+                    case INSTALL_DONE:
+                        snprintf(buffer, sizeof(buffer) - 1, "Installed");
+                        break;
+                    case INSTALL_FAILED:
+                    default:
+                        snprintf(buffer, sizeof(buffer) - 1, "Failed to install");
+                        break;
+                }
+                pax_draw_text(pax_buffer, 0xFFfa448c, pax_font_saira_regular, 18, 5, pax_buffer->height - 18 - 20, buffer);
+            }
             pax_draw_text(pax_buffer, 0xFF491d88, pax_font_saira_regular, 18, 5, pax_buffer->height - 18, "🅰 install app  🅱 back");
             display_flush();
             render = false;
         }
 
-        int button = wait_for_button_press(portMAX_DELAY);
+        // Poll the install queue while this app is in it
+        bool polling = in_queue && ((queued.state == INSTALL_QUEUED) || (queued.state == INSTALL_RUNNING));
+        int  button  = wait_for_button_press(polling ? pdMS_TO_TICKS(HATCHERY_QUEUE_POLL_MS) : portMAX_DELAY, NULL);
+        if (polling) {
+            install_queue_entry_t previous = queued;
+            in_queue                       = install_queue_get(type_slug, app_slug, &queued);
+            render                         = (previous.state != queued.state) || (previous.percent != queued.percent);
+        }
         switch (button) {
             case INPUT_TOUCH0:
                 quit = true;
@@ -403,7 +437,8 @@ bool menu_hatchery_app_info(const char* type_slug, const char* category_slug, co
                 break;
             case INPUT_TOUCH2:
                 render = true;
-                menu_hatchery_install_app(type_slug);
+                menu_hatchery_install_app(type_slug, category_slug, app_slug);
+                in_queue = install_queue_get(type_slug, app_slug, &queued);
                 break;
             default:
                 break;
@@ -427,16 +462,14 @@ bool menu_hatchery_apps(const char* type_slug, const char* category_slug) {
 
     menu_t* menu = hatchery_menu_create("Apps");
 
-    cJSON* app_obj;
-    cJSON_ArrayForEach(app_obj, json_apps) {
-        cJSON* slug_obj = cJSON_GetObjectItem(app_obj, "slug");
-        cJSON* name_obj = cJSON_GetObjectItem(app_obj, "name");
-        menu_insert_item(menu, name_obj->valuestring, NULL, (void*) slug_obj->valuestring, -1);
-    }
+    listing_to_menu(&listing_apps, menu);
+
+    char prefetch_prefix[128];
+    snprintf(prefetch_prefix, sizeof(prefetch_prefix), MIRROR_HATCHERY_URL "/%s/%s/", type_slug, category_slug);
 
     bool quit = false;
     while (!quit) {
-        const char* app_slug = (const char*) hatchery_menu_show(menu, "🅰 select app  🅱 back", &quit);
+        const char* app_slug = (const char*) hatchery_menu_show(menu, "🅰 select app  🅱 back", &quit, prefetch_prefix, "");
         if (quit) break;
         quit = !menu_hatchery_app_info(type_slug, category_slug, app_slug);
     }
@@ -459,16 +492,14 @@ bool menu_hatchery_categories(const char* type_slug) {
 
     menu_t* menu = hatchery_menu_create("Categories");
 
-    cJSON* category_obj;
-    cJSON_ArrayForEach(category_obj, json_categories) {
-        cJSON* slug_obj = cJSON_GetObjectItem(category_obj, "slug");
-        cJSON* name_obj = cJSON_GetObjectItem(category_obj, "name");
-        menu_insert_item(menu, name_obj->valuestring, NULL, (void*) slug_obj->valuestring, -1);
-    }
+    listing_to_menu(&listing_categories, menu);
+
+    char prefetch_prefix[128];
+    snprintf(prefetch_prefix, sizeof(prefetch_prefix), MIRROR_HATCHERY_URL "/%s/", type_slug);
 
     bool quit = false;
     while (!quit) {
-        const char* category_slug = (const char*) hatchery_menu_show(menu, "🅰 select category  🅱 back", &quit);
+        const char* category_slug = (const char*) hatchery_menu_show(menu, "🅰 select category  🅱 back", &quit, prefetch_prefix, "");
         if (quit) break;
         quit = !menu_hatchery_apps(type_slug, category_slug);
     }
@@ -485,33 +516,37 @@ void menu_hatchery() {
     size_t ram_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
     display_busy();
 
-    if (!connect_to_wifi()) return;
+    // Without WiFi the listings that are in the HTTP cache can still be browsed
+    bool online = wifi_session_acquire();
 
     if (!load_types()) {
-        wifi_disconnect_and_disable();
+        http_pool_flush();
+        if (online) wifi_session_release();
         hatchery_free();
-        show_communication_error();
+        if (online) {
+            show_communication_error();
+        } else {
+            show_wifi_error();
+        }
         return;
     }
 
     menu_t* menu = hatchery_menu_create("Hatchery");
 
-    cJSON* type_obj;
-    cJSON_ArrayForEach(type_obj, json_types) {
-        cJSON* slug_obj = cJSON_GetObjectItem(type_obj, "slug");
-        cJSON* name_obj = cJSON_GetObjectItem(type_obj, "name");
-        menu_insert_item(menu, name_obj->valuestring, NULL, (void*) slug_obj->valuestring, -1);
-    }
+    listing_to_menu(&listing_types, menu);
+    if (online) http_prefetch_start();
 
     bool quit = false;
     while (!quit) {
-        const char* type_slug = (const char*) hatchery_menu_show(menu, "🅰 select type  🅱 back", &quit);
+        const char* type_slug = (const char*) hatchery_menu_show(menu, "🅰 select type  🅱 back", &quit, MIRROR_HATCHERY_URL "/", "/categories");
         if (quit) break;
         quit = !menu_hatchery_categories(type_slug);
     }
 
     hatchery_menu_destroy(menu);
-    wifi_disconnect_and_disable();
+    http_prefetch_stop();
+    http_pool_flush();
+    if (online) wifi_session_release();
     hatchery_free();
     size_t ram_after = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
     printf("Leak (hatchery): %d (%u to %u)\r\n", ram_before - ram_after, ram_before, ram_after);
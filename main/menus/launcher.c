@@ -19,6 +19,7 @@
 #include "graphics_wrapper.h"
 #include "gui_element_header.h"
 #include "hardware.h"
+#include "input_latency.h"
 #include "menu.h"
 #include "metadata.h"
 #include "pax_codecs.h"
@@ -193,7 +194,7 @@ static bool show_app_details(xQueueHandle button_queue, launcher_app_t* app) {
             render = false;
         }
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, portMAX_DELAY) == pdTRUE) {
+        if (input_buffer_receive(&button_message, portMAX_DELAY)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
@@ -246,6 +247,8 @@ void menu_launcher(xQueueHandle button_queue) {
 
         bool empty = !populate_menu(menu);
 
+        input_latency_set_screen("launcher");
+
         launcher_app_t* app_to_start = NULL;
         bool            render       = true;
         bool            quit         = false;
@@ -262,14 +265,14 @@ void menu_launcher(xQueueHandle button_queue) {
             }
 
             input_message_t button_message = {0};
-            if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+            if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
                 if (button_message.state) {
                     switch (button_message.input) {
                         case INPUT_TOUCH0:
                             quit = true;
                             break;
                         case INPUT_TOUCH1:
-                            menu_navigate_next(menu);
+                            menu_navigate_next_steps(menu, button_message.count);
                             render = true;
                             break;
                         case INPUT_TOUCH2:
@@ -282,6 +285,7 @@ void menu_launcher(xQueueHandle button_queue) {
                                     } else {
                                         render = true;
                                     }
+                                    input_latency_set_screen("launcher");
                                 }
                                 break;
                             }
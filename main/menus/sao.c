@@ -86,7 +86,7 @@ void menu_sao(xQueueHandle button_queue) {
     bool       exit       = false;
     while (!exit) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 200 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 200 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
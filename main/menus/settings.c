@@ -15,6 +15,7 @@
 #include "filesystems.h"
 #include "graphics_wrapper.h"
 #include "hardware.h"
+#include "input_latency.h"
 #include "menu.h"
 #include "nametag.h"
 #include "pax_codecs.h"
@@ -75,17 +76,18 @@ void menu_settings(xQueueHandle button_queue) {
     menu_settings_action_t action = ACTION_NONE;
 
     render_settings_help(pax_buffer);
+    input_latency_set_screen("settings");
 
     while (1) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
                         action = ACTION_BACK;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, button_message.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
@@ -125,6 +127,7 @@ void menu_settings(xQueueHandle button_queue) {
             render = true;
             action = ACTION_NONE;
             render_settings_help(pax_buffer);
+            input_latency_set_screen("settings");
         }
     }
 
@@ -13,6 +13,7 @@
 #include "dev.h"
 #include "hardware.h"
 #include "hatchery.h"
+#include "input_latency.h"
 #include "launcher.h"
 #include "math.h"
 #include "menu.h"
@@ -122,16 +123,18 @@ void menu_start(const char* version) {
     bool                render = true;
     menu_start_action_t action = ACTION_NONE;
 
+    input_latency_set_screen("start");
+
     while (1) {
         input_message_t buttonMessage = {0};
-        if (xQueueReceive(get_input_queue(), &buttonMessage, 100 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&buttonMessage, 100 / portTICK_PERIOD_MS)) {
             if (buttonMessage.state) {
                 switch (buttonMessage.input) {
                     case INPUT_TOUCH0:
                         render = true;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, buttonMessage.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
@@ -170,6 +173,7 @@ void menu_start(const char* version) {
             }
             action = ACTION_NONE;
             render = true;
+            input_latency_set_screen("start");
         }
     }
 
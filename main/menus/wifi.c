@@ -16,9 +16,11 @@
 #include "esp_wpa2.h"
 #include "graphics_wrapper.h"
 #include "hardware.h"
+#include "input_latency.h"
 #include "menu.h"
 #include "pax_gfx.h"
 #include "system_wrapper.h"
+#include "wifi_bench.h"
 #include "wifi_connect.h"
 #include "wifi_connection.h"
 #include "wifi_defaults.h"
@@ -41,6 +43,8 @@ typedef enum action {
     ACTION_MANUAL,
     // Reset WiFi settings to default.
     ACTION_DEFAULTS,
+    // Measure throughput and latency against a benchmark server.
+    ACTION_BENCHMARK,
 
     /* ==== AUTH MODES ==== */
     ACTION_AUTH_OPEN,
@@ -70,7 +74,7 @@ void render_wifi_help(pax_buf_t* pax_buffer) {
 
 void              wifi_show();
 void              wifi_setup(bool scan);
-wifi_ap_record_t* wifi_scan_results(size_t num_aps, wifi_ap_record_t* aps);
+bool              wifi_scan_results(wifi_ap_record_t* picked);
 int               wifi_auth_menu(wifi_auth_mode_t default_mode);
 int               wifi_phase2_menu(esp_eap_ttls_phase2_types default_mode);
 
@@ -81,22 +85,24 @@ void menu_wifi() {
     menu_insert_item(menu, "Scan for networks", NULL, (void*) ACTION_SCAN, -1);
     menu_insert_item(menu, "Configure manually", NULL, (void*) ACTION_MANUAL, -1);
     menu_insert_item(menu, "Reset to default settings", NULL, (void*) ACTION_DEFAULTS, -1);
+    menu_insert_item(menu, "Run benchmark", NULL, (void*) ACTION_BENCHMARK, -1);
 
     bool               render = true;
     menu_wifi_action_t action = ACTION_NONE;
 
     render_wifi_help(pax_buffer);
+    input_latency_set_screen("wifi");
 
     while (1) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
                         action = ACTION_BACK;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, button_message.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
@@ -129,46 +135,95 @@ void menu_wifi() {
                 wifi_set_defaults();
                 display_boot_screen("WiFi reset to default!");
                 vTaskDelay(pdMS_TO_TICKS(750));
+            } else if (action == ACTION_BENCHMARK) {
+                wifi_benchmark();
             } else if (action == ACTION_BACK) {
                 break;
             }
             render = true;
             action = ACTION_NONE;
             render_wifi_help(pax_buffer);
+            input_latency_set_screen("wifi");
         }
     }
 
     menu_free(menu);
 }
 
-wifi_ap_record_t* wifi_scan_results(size_t num_aps, wifi_ap_record_t* aps) {
-    pax_buf_t*        pax_buffer = get_pax_buffer();
-    menu_t*           menu       = menu_alloc("Select network", 20, 18);
-    wifi_ap_record_t* picked     = NULL;
+static void render_wifi_scan_help(pax_buf_t* pax_buffer, bool scanning) {
+    const pax_font_t* font = pax_font_saira_regular;
+    pax_background(pax_buffer, 0xFFFFFF);
+    pax_noclip(pax_buffer);
+    pax_draw_text(pax_buffer, 0xFF000000, font, 18, 5, 240 - 18, scanning ? "🅰 accept  🅱 back  Scanning..." : "🅰 accept  🅱 back");
+}
 
-    render_wifi_help(pax_buffer);
+// Replace the items of the network menu with the current scan results, keeping the selected network selected.
+static void wifi_scan_update_menu(menu_t* menu, wifi_ap_record_t* aps) {
+    char   selected[33] = {0};
+    size_t position     = menu_get_position(menu);
+    if (position < menu_get_length(menu)) {
+        memcpy(selected, aps[(size_t) menu_get_callback_args(menu, position) - 1].ssid, sizeof(selected));
+    }
+
+    size_t num_aps = wifi_scan_async_get(aps, WIFI_SCAN_MAX_NETWORKS);
 
+    while (menu_get_length(menu) > 0) {
+        menu_remove_item(menu, 0);
+    }
+    position = 0;
     for (size_t i = 0; i < num_aps; i++) {
         menu_insert_item(menu, (const char*) aps[i].ssid, NULL, (void*) (i + 1), -1);
+        if (!strcmp((const char*) aps[i].ssid, selected)) position = i;
+    }
+    if (num_aps > 0) menu_navigate_to(menu, position);
+}
+
+// Show the networks found by the asynchronous scan while it runs, strongest first.
+// Returns whether a network was picked.
+bool wifi_scan_results(wifi_ap_record_t* picked) {
+    pax_buf_t*        pax_buffer = get_pax_buffer();
+    menu_t*           menu       = menu_alloc("Select network", 20, 18);
+    wifi_ap_record_t* aps        = malloc(sizeof(wifi_ap_record_t) * WIFI_SCAN_MAX_NETWORKS);
+    bool              accepted   = false;
+    if (aps == NULL) {
+        menu_free(menu);
+        return false;
     }
 
+    uint32_t generation = 0;
+    bool     scanning   = true;
+    render_wifi_scan_help(pax_buffer, scanning);
+
     bool   render    = true;
     size_t selection = 0;
     while (1) {
+        // Show the networks found on each channel as soon as it has been scanned.
+        uint32_t current = wifi_scan_async_generation();
+        if (current != generation) {
+            generation = current;
+            wifi_scan_update_menu(menu, aps);
+            render = true;
+        }
+        if (scanning && !wifi_scan_async_busy()) {
+            scanning = false;
+            render_wifi_scan_help(pax_buffer, scanning);
+            render = true;
+        }
+
         input_message_t button_message = {0};
         selection                      = -1;
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
                         selection = 0;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, button_message.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
-                        selection = (size_t) menu_get_callback_args(menu, menu_get_position(menu));
+                        if (menu_get_length(menu) > 0) selection = (size_t) menu_get_callback_args(menu, menu_get_position(menu));
                         break;
                     default:
                         break;
@@ -187,17 +242,16 @@ wifi_ap_record_t* wifi_scan_results(size_t num_aps, wifi_ap_record_t* aps) {
                 break;
             } else {
                 // You picked one, yay!
-                picked = &aps[selection - 1];
+                *picked  = aps[selection - 1];
+                accepted = true;
                 break;
             }
-            render    = true;
-            selection = -1;
-            render_wifi_help(pax_buffer);
         }
     }
 
+    free(aps);
     menu_free(menu);
-    return picked;
+    return accepted;
 }
 
 int wifi_auth_menu(wifi_auth_mode_t default_mode) {
@@ -228,14 +282,14 @@ int wifi_auth_menu(wifi_auth_mode_t default_mode) {
 
     while (1) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
                         action = ACTION_BACK;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, button_message.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
@@ -295,14 +349,14 @@ int wifi_phase2_menu(esp_eap_ttls_phase2_types default_mode) {
 
     while (1) {
         input_message_t button_message = {0};
-        if (xQueueReceive(get_input_queue(), &button_message, 16 / portTICK_PERIOD_MS) == pdTRUE) {
+        if (input_buffer_receive(&button_message, 16 / portTICK_PERIOD_MS)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
                         action = ACTION_BACK;
                         break;
                     case INPUT_TOUCH1:
-                        menu_navigate_next(menu);
+                        menu_navigate_next_steps(menu, button_message.count);
                         render = true;
                         break;
                     case INPUT_TOUCH2:
@@ -337,13 +391,6 @@ int wifi_phase2_menu(esp_eap_ttls_phase2_types default_mode) {
     return pick;
 }
 
-// Sorts WiFi APs by RSSI (best RSSI first in the list).
-static int wifi_ap_sorter(const void* a0, const void* b0) {
-    const wifi_ap_record_t* a = a0;
-    const wifi_ap_record_t* b = b0;
-    return b->rssi - a->rssi;
-}
-
 void wifi_setup(bool scan) {
     pax_buf_t*   pax_buffer   = get_pax_buffer();
     char         ssid[33]     = {0};
@@ -357,42 +404,25 @@ void wifi_setup(bool scan) {
 
     /* ==== scanning phase ==== */
     if (scan) {
-        // Show a little bit of text.
-        display_boot_screen("Scanning WiFi networks...");
-
-        // Scan for networks.
-        wifi_ap_record_t* aps;
-        size_t            n_aps = wifi_scan(&aps);
-
-        // Sort them by RSSI.
-        qsort(aps, n_aps, sizeof(wifi_ap_record_t), wifi_ap_sorter);
-
-        // Make a de-duplicated list.
-        wifi_ap_record_t* dedup   = malloc(sizeof(wifi_ap_record_t) * n_aps);
-        size_t            n_dedup = 0;
-        for (size_t i = 0; i < n_aps;) {
-            for (size_t x = 0; x < n_dedup; x++) {
-                if (!strcmp((const char*) aps[i].ssid, (const char*) dedup[x].ssid)) goto cont;
-            }
-            dedup[n_dedup] = aps[i];
-            n_dedup++;
-        cont:
-            i++;
+        // Scan in the background, the picker shows networks as they are found.
+        if (!wifi_scan_async_start()) {
+            display_boot_screen("Failed to scan for WiFi networks");
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            nvs_close(handle);
+            return;
         }
 
         // Open a little menu for picking a network.
-        wifi_ap_record_t* pick = wifi_scan_results(n_dedup, dedup);
-        if (!pick) {
+        wifi_ap_record_t pick;
+        bool             picked = wifi_scan_results(&pick);
+        wifi_scan_async_stop();
+        if (!picked) {
             nvs_close(handle);
             return;
         }
         // Copy the SSID in.
-        memcpy(ssid, pick->ssid, sizeof(ssid));
-        authmode = pick->authmode;
-
-        // Free memories.
-        free(aps);
-        free(dedup);
+        memcpy(ssid, pick.ssid, sizeof(ssid));
+        authmode = pick.authmode;
     } else {
         size_t    requiredSize;
         esp_err_t res = nvs_get_str(handle, "wifi.ssid", NULL, &requiredSize);
@@ -0,0 +1,281 @@
+#include "mirrors.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mdns.h"
+#include "nvs.h"
+#include "wifi_cert.h"
+#include "wifi_connection.h"
+
+static const char* TAG = "Mirrors";
+
+#define MIRROR_MDNS_TIMEOUT_MS 1000
+#define MIRROR_PROBE_STACK     8192  // The probes do TLS handshakes
+
+typedef struct {
+    char     base[MIRROR_URL_SIZE];
+    uint32_t latency_ms;  // Duration of the last probe
+    bool     healthy;
+} mirror_t;
+
+typedef struct {
+    mirror_t mirrors[MIRROR_MAX];  // The canonical server is always the first mirror
+    size_t   count;
+    size_t   current;  // Mirror requests are sent to
+    int64_t  probed;   // esp_timer time of the last probe, 0 to probe on the next request
+    bool     probing;  // A probe task is running, the current mirror is used until it finishes
+} mirror_list_t;
+
+static const char* canonical_urls[MIRROR_SERVERS] = {MIRROR_HATCHERY_URL, MIRROR_OTA_URL};
+static const char* probe_paths[MIRROR_SERVERS]    = {"/types", "/mch2022.bin"};  // Small requests every mirror can answer
+static const char* nvs_keys[MIRROR_SERVERS]       = {"mirror.hatchery", "mirror.ota"};
+static const char* mdns_keys[MIRROR_SERVERS]      = {"hatchery", "ota"};
+
+static SemaphoreHandle_t mirror_mutex = NULL;  // Protects the mirror lists, only held briefly
+static SemaphoreHandle_t probe_mutex  = NULL;  // Held by the probe tasks, so mDNS is only used by one at a time
+static mirror_list_t     mirror_lists[MIRROR_SERVERS];
+static char*             configured[MIRROR_SERVERS];  // Space separated mirror URLs from NVS
+static char*             trusted_domains = NULL;
+static bool              mdns_enabled    = true;
+static bool              mdns_started    = false;
+
+static char* load_string(nvs_handle_t handle, const char* key) {
+    size_t size = 0;
+    if (nvs_get_str(handle, key, NULL, &size) != ESP_OK) return NULL;
+    char* value = malloc(size);
+    if (value == NULL) return NULL;
+    if (nvs_get_str(handle, key, value, &size) != ESP_OK) {
+        free(value);
+        return NULL;
+    }
+    return value;
+}
+
+void mirrors_init() {
+    mirror_mutex = xSemaphoreCreateMutex();
+    probe_mutex  = xSemaphoreCreateMutex();
+
+    nvs_handle_t handle;
+    if (nvs_open("system", NVS_READONLY, &handle) == ESP_OK) {
+        for (size_t server = 0; server < MIRROR_SERVERS; server++) {
+            configured[server] = load_string(handle, nvs_keys[server]);
+        }
+        trusted_domains = load_string(handle, "mirror.trust");
+        uint8_t mdns    = 1;
+        if (nvs_get_u8(handle, "mirror.mdns", &mdns) == ESP_OK) mdns_enabled = (mdns != 0);
+        nvs_close(handle);
+    }
+}
+
+static void add_mirror(mirror_list_t* list, const char* base, size_t length) {
+    while ((length > 0) && (base[length - 1] == '/')) length--;
+    if ((length == 0) || (length >= MIRROR_URL_SIZE) || (list->count >= MIRROR_MAX)) return;
+    for (size_t index = 0; index < list->count; index++) {
+        if ((strlen(list->mirrors[index].base) == length) && (strncmp(list->mirrors[index].base, base, length) == 0)) return;
+    }
+    mirror_t* mirror = &list->mirrors[list->count++];
+    memcpy(mirror->base, base, length);
+    mirror->base[length] = '\0';
+    mirror->latency_ms   = 0;
+    mirror->healthy      = false;
+}
+
+static void add_configured(mirror_list_t* list, const char* urls) {
+    while ((urls != NULL) && (*urls != '\0')) {
+        size_t length = strcspn(urls, " ");
+        add_mirror(list, urls, length);
+        urls += length;
+        urls += strspn(urls, " ");
+    }
+}
+
+// Mirrors announced on the local network are only used if their certificate proves they belong to a trusted domain.
+static bool is_trusted(const char* url) {
+    if (strncmp(url, "https://", 8) != 0) return false;
+    const char* host        = &url[8];
+    size_t      host_length = strcspn(host, ":/");
+    const char* domains     = (trusted_domains != NULL) ? trusted_domains : MIRROR_TRUSTED_DOMAINS;
+    while (*domains != '\0') {
+        size_t length = strcspn(domains, " ");
+        if ((length > 0) && (host_length >= length) && (strncmp(&host[host_length - length], domains, length) == 0) &&
+            ((host_length == length) || (host[host_length - length - 1] == '.'))) {
+            return true;
+        }
+        domains += length;
+        domains += strspn(domains, " ");
+    }
+    return false;
+}
+
+static void discover(mirror_server_t server, mirror_list_t* list) {
+    if (!mdns_enabled) return;
+    if (!mdns_started) {
+        if (mdns_init() != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to start mDNS, not looking for local mirrors");
+            mdns_enabled = false;
+            return;
+        }
+        mdns_started = true;
+    }
+
+    mdns_result_t* results = NULL;
+    if ((mdns_query_ptr(MIRROR_MDNS_SERVICE, MIRROR_MDNS_PROTO, MIRROR_MDNS_TIMEOUT_MS, MIRROR_MAX, &results) != ESP_OK) || (results == NULL)) return;
+    for (mdns_result_t* result = results; result != NULL; result = result->next) {
+        for (size_t index = 0; index < result->txt_count; index++) {
+            const mdns_txt_item_t* item = &result->txt[index];
+            if ((item->key == NULL) || (item->value == NULL) || (strcmp(item->key, mdns_keys[server]) != 0)) continue;
+            if (!is_trusted(item->value)) {
+                ESP_LOGW(TAG, "Ignoring untrusted local mirror %s", item->value);
+                continue;
+            }
+            ESP_LOGI(TAG, "Found local mirror %s", item->value);
+            add_mirror(list, item->value, strlen(item->value));
+        }
+    }
+    mdns_query_results_free(results);
+}
+
+static void probe(mirror_server_t server, mirror_t* mirror) {
+    char url[MIRROR_URL_SIZE + 32];
+    snprintf(url, sizeof(url), "%s%s", mirror->base, probe_paths[server]);
+    esp_http_client_config_t config = {
+        .url                 = url,
+        .method              = HTTP_METHOD_HEAD,
+        .use_global_ca_store = true,
+        .timeout_ms          = MIRROR_PROBE_TIMEOUT_MS,
+    };
+    esp_http_client_handle_t client = (init_ca_store() == ESP_OK) ? esp_http_client_init(&config) : NULL;
+    if (client == NULL) {
+        mirror->healthy = false;
+        return;
+    }
+    int64_t   start   = esp_timer_get_time();
+    esp_err_t err     = esp_http_client_perform(client);
+    int64_t   latency = esp_timer_get_time() - start;
+    int       status  = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+
+    mirror->latency_ms = latency / 1000;
+    mirror->healthy    = (err == ESP_OK) && (status >= 200) && (status < 400);
+    ESP_LOGI(TAG, "%s: %s, %u ms", mirror->base, mirror->healthy ? "healthy" : "failed", mirror->latency_ms);
+}
+
+// Pick the healthy mirror with the lowest latency, the canonical server if none is healthy.
+// Returns false if none of the mirrors is healthy.
+static bool select_fastest(mirror_list_t* list) {
+    bool found    = false;
+    list->current = 0;
+    for (size_t index = 0; index < list->count; index++) {
+        const mirror_t* mirror = &list->mirrors[index];
+        if (!mirror->healthy) continue;
+        if ((!found) || (mirror->latency_ms < list->mirrors[list->current].latency_ms)) list->current = index;
+        found = true;
+    }
+    return found;
+}
+
+// Find and probe the mirrors of `server` in `list`, without holding the mirror mutex
+static void probe_all(mirror_server_t server, mirror_list_t* list) {
+    list->count = 0;
+    add_mirror(list, canonical_urls[server], strlen(canonical_urls[server]));
+    add_configured(list, configured[server]);
+    discover(server, list);
+
+    // Skip probing when there is nothing to choose from
+    if (list->count > 1) {
+        for (size_t index = 0; index < list->count; index++) {
+            probe(server, &list->mirrors[index]);
+        }
+        select_fastest(list);
+    } else {
+        list->mirrors[0].healthy = true;
+        list->current            = 0;
+    }
+}
+
+static void probe_task(void* arg) {
+    mirror_server_t server = (mirror_server_t) (uintptr_t) arg;
+    mirror_list_t*  probed = malloc(sizeof(mirror_list_t));
+    if (probed != NULL) {
+        xSemaphoreTake(probe_mutex, portMAX_DELAY);
+        probe_all(server, probed);
+        xSemaphoreGive(probe_mutex);
+    }
+
+    xSemaphoreTake(mirror_mutex, portMAX_DELAY);
+    mirror_list_t* list = &mirror_lists[server];
+    if (probed != NULL) {
+        memcpy(list->mirrors, probed->mirrors, sizeof(list->mirrors));
+        list->count   = probed->count;
+        list->current = probed->current;
+        if (list->current != 0) ESP_LOGI(TAG, "Using mirror %s", list->mirrors[list->current].base);
+    }
+    list->probed  = esp_timer_get_time();  // Without memory for the probe it is tried again after the interval
+    list->probing = false;
+    xSemaphoreGive(mirror_mutex);
+    free(probed);
+    vTaskDelete(NULL);
+}
+
+// Start probing the mirrors of `server` in the background when it is due, called with the mirror mutex held
+static void probe_if_due(mirror_server_t server) {
+    mirror_list_t* list = &mirror_lists[server];
+    if (list->count == 0) {
+        // Until the first probe finishes requests go to the canonical server
+        add_mirror(list, canonical_urls[server], strlen(canonical_urls[server]));
+        list->mirrors[0].healthy = true;
+        list->current            = 0;
+    }
+    if (list->probing || (!wifi_is_connected())) return;  // mDNS and the probes need the network stack, which is only initialized by connecting
+    if ((list->probed != 0) && ((esp_timer_get_time() - list->probed) <= (MIRROR_PROBE_INTERVAL_MS * 1000LL))) return;
+    list->probing = (xTaskCreate(probe_task, "mirror_probe", MIRROR_PROBE_STACK, (void*) (uintptr_t) server, 5, NULL) == pdPASS);
+    if (!list->probing) {
+        ESP_LOGW(TAG, "Failed to start probing the mirrors");
+        list->probed = esp_timer_get_time();
+    }
+}
+
+void mirror_rewrite(const char* url, char* output, size_t size) {
+    for (size_t server = 0; (mirror_mutex != NULL) && (probe_mutex != NULL) && (server < MIRROR_SERVERS); server++) {
+        size_t length = strlen(canonical_urls[server]);
+        if (strncmp(url, canonical_urls[server], length) != 0) continue;
+
+        xSemaphoreTake(mirror_mutex, portMAX_DELAY);
+        probe_if_due(server);
+        mirror_list_t* list = &mirror_lists[server];
+        snprintf(output, size, "%s%s", list->mirrors[list->current].base, &url[length]);
+        xSemaphoreGive(mirror_mutex);
+        return;
+    }
+    strlcpy(output, url, size);
+}
+
+void mirror_report_failure(const char* url) {
+    if (mirror_mutex == NULL) return;
+    xSemaphoreTake(mirror_mutex, portMAX_DELAY);
+    for (size_t server = 0; server < MIRROR_SERVERS; server++) {
+        mirror_list_t* list = &mirror_lists[server];
+        for (size_t index = 0; index < list->count; index++) {
+            mirror_t* mirror = &list->mirrors[index];
+            size_t    length = strlen(mirror->base);
+            if ((strncmp(url, mirror->base, length) != 0) || ((url[length] != '/') && (url[length] != '\0'))) continue;
+            mirror->healthy = false;
+            if (index != list->current) continue;
+            if (!select_fastest(list)) {
+                // Everything failed, look again on the next request
+                list->probed = 0;
+            }
+            if (list->current != index) ESP_LOGW(TAG, "Mirror %s failed, switching to %s", mirror->base, list->mirrors[list->current].base);
+        }
+    }
+    xSemaphoreGive(mirror_mutex);
+}
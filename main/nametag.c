@@ -16,6 +16,7 @@
 #include "freertos/task.h"
 #include "graphics_wrapper.h"
 #include "hardware.h"
+#include "input_latency.h"
 #include "nvs.h"
 #include "pax_gfx.h"
 #include "sdkconfig.h"
@@ -182,6 +183,7 @@ void show_nametag() {
     }
     input_message_t msg;
     bool                   quit = false;
+    input_latency_set_screen("nametag");
     while (!quit) {
         if (esp_timer_get_time() / 1000 > sleep_time) {
             if (theme != NICKNAME_THEME_GAMER) {
@@ -193,7 +195,7 @@ void show_nametag() {
             }
         }
         show_name(buffer, theme, true);
-        if (xQueueReceive(get_input_queue(), &msg, pdMS_TO_TICKS(SLEEP_DELAY + 10))) {
+        if (input_buffer_receive(&msg, pdMS_TO_TICKS(SLEEP_DELAY + 10))) {
             if (msg.state) {
                 switch (msg.input) {
                     case INPUT_TOUCH0:
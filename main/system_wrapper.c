@@ -19,7 +19,7 @@ void restart() {
 bool wait_for_button() {
     while (1) {
         input_message_t buttonMessage = {0};
-        if (xQueueReceive(get_input_queue(), &buttonMessage, portMAX_DELAY) == pdTRUE) {
+        if (input_buffer_receive(&buttonMessage, portMAX_DELAY)) {
             if (buttonMessage.state) {
                 switch (buttonMessage.input) {
                     case INPUT_TOUCH0:
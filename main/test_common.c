@@ -16,7 +16,7 @@ bool test_wait_for_response(uint32_t *rc) {
     input_message_t button_message = {0};
     if (rc != NULL) *rc = 0;
     while (1) {
-        if (xQueueReceive(get_input_queue(), &button_message, portMAX_DELAY) == pdTRUE) {
+        if (input_buffer_receive(&button_message, portMAX_DELAY)) {
             if (button_message.state) {
                 switch (button_message.input) {
                     case INPUT_TOUCH0:
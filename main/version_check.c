@@ -0,0 +1,171 @@
+#include "version_check.h"
+
+#include <cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http_download.h"
+#include "mirrors.h"
+#include "sdkconfig.h"
+
+static const char* TAG = "Version check";
+
+#define VERSION_CHECK_URL          MIRROR_HATCHERY_URL "/versions"
+#define VERSION_CHECK_WORKER_STACK 8192
+
+// The request is a list of installed apps, the response lists the same apps with the latest versions:
+// [{"type": "esp32", "category": "games", "slug": "snake", "version": 3}, ...]
+static char* build_request(const version_check_item_t* items, size_t count) {
+    cJSON* request = cJSON_CreateArray();
+    if (request == NULL) return NULL;
+    for (size_t index = 0; index < count; index++) {
+        cJSON* app = cJSON_CreateObject();
+        if (app == NULL) break;
+        cJSON_AddStringToObject(app, "type", items[index].type);
+        cJSON_AddStringToObject(app, "category", items[index].category);
+        cJSON_AddStringToObject(app, "slug", items[index].slug);
+        cJSON_AddNumberToObject(app, "version", items[index].installed);
+        cJSON_AddItemToArray(request, app);
+    }
+    char* data = cJSON_PrintUnformatted(request);
+    cJSON_Delete(request);
+    return data;
+}
+
+static bool matches(const cJSON* app, const char* key, const char* value) {
+    const cJSON* field = cJSON_GetObjectItem(app, key);
+    return cJSON_IsString(field) && (strcmp(field->valuestring, value) == 0);
+}
+
+static bool check_batched(version_check_item_t* items, size_t count) {
+    char* request = build_request(items, count);
+    if (request == NULL) return false;
+
+    char*  data    = NULL;
+    size_t size    = 0;
+    bool   success = download_ram_post(VERSION_CHECK_URL, "application/json", request, strlen(request), (uint8_t**) &data, &size);
+    free(request);
+    if (!success) return false;
+
+    cJSON* response = cJSON_ParseWithLength(data, size);
+    free(data);
+    if (!cJSON_IsArray(response)) {
+        cJSON_Delete(response);
+        return false;
+    }
+
+    const cJSON* app;
+    cJSON_ArrayForEach(app, response) {
+        const cJSON* version = cJSON_GetObjectItem(app, "version");
+        if (!cJSON_IsNumber(version)) continue;
+        for (size_t index = 0; index < count; index++) {
+            version_check_item_t* item = &items[index];
+            if (matches(app, "slug", item->slug) && matches(app, "type", item->type) && matches(app, "category", item->category)) {
+                item->latest = version->valueint;
+            }
+        }
+    }
+    cJSON_Delete(response);
+    return true;
+}
+
+static int fetch_version(const version_check_item_t* item) {
+    char url[128];
+    snprintf(url, sizeof(url) - 1, MIRROR_HATCHERY_URL "/%s/%s/%s", item->type, item->category, item->slug);
+    char*  data = NULL;
+    size_t size = 0;
+    if (!download_ram(url, (uint8_t**) &data, &size)) return -1;
+    cJSON* json = cJSON_ParseWithLength(data, size);
+    free(data);
+    const cJSON* version_obj = cJSON_GetObjectItem(json, "version");
+    int          version     = cJSON_IsNumber(version_obj) ? version_obj->valueint : -1;
+    cJSON_Delete(json);
+    return version;
+}
+
+typedef struct {
+    version_check_item_t* items;
+    size_t                count;
+    size_t                next;  // Index of the next app to check
+    portMUX_TYPE          lock;
+    SemaphoreHandle_t     finished;  // Given by each worker when it exits
+} version_check_pool_t;
+
+static void version_check_worker(void* arg) {
+    version_check_pool_t* pool = (version_check_pool_t*) arg;
+    while (true) {
+        portENTER_CRITICAL(&pool->lock);
+        size_t index = pool->next;
+        if (index < pool->count) pool->next++;
+        portEXIT_CRITICAL(&pool->lock);
+        if (index >= pool->count) break;
+        if (pool->items[index].latest < 0) pool->items[index].latest = fetch_version(&pool->items[index]);
+    }
+    xSemaphoreGive(pool->finished);
+    vTaskDelete(NULL);
+}
+
+// Fetch the app info of the apps whose version is still unknown, `missing` of the `count` items
+static void check_individually(version_check_item_t* items, size_t count, size_t missing) {
+    version_check_pool_t pool = {0};
+    pool.items                = items;
+    pool.count                = count;
+    pool.lock                 = (portMUX_TYPE) portMUX_INITIALIZER_UNLOCKED;
+    pool.finished             = xSemaphoreCreateCounting(CONFIG_DOWNLOAD_CONCURRENCY, 0);
+
+    size_t workers = 0;
+    if (pool.finished != NULL) {
+        for (size_t worker = 0; (worker < CONFIG_DOWNLOAD_CONCURRENCY) && (worker < missing); worker++) {
+            char name[16];
+            snprintf(name, sizeof(name), "version_%u", worker);
+            if (xTaskCreate(version_check_worker, name, VERSION_CHECK_WORKER_STACK, &pool, 5, NULL) != pdPASS) break;
+            workers++;
+        }
+    }
+
+    if (workers == 0) {
+        // Not enough memory for the workers, check the apps one by one
+        for (size_t index = 0; index < count; index++) {
+            if (items[index].latest < 0) items[index].latest = fetch_version(&items[index]);
+        }
+    } else {
+        for (size_t worker = 0; worker < workers; worker++) {
+            xSemaphoreTake(pool.finished, portMAX_DELAY);
+        }
+    }
+    if (pool.finished != NULL) vSemaphoreDelete(pool.finished);
+}
+
+static size_t count_missing(const version_check_item_t* items, size_t count) {
+    size_t missing = 0;
+    for (size_t index = 0; index < count; index++) {
+        if (items[index].latest < 0) missing++;
+    }
+    return missing;
+}
+
+bool version_check(version_check_item_t* items, size_t count) {
+    if (count == 0) return true;
+    for (size_t index = 0; index < count; index++) {
+        items[index].latest = -1;
+    }
+
+    if (check_batched(items, count)) {
+        ESP_LOGI(TAG, "Checked %u apps with a batched request", count);
+    } else {
+        ESP_LOGW(TAG, "Batched version check failed, checking %u apps individually", count);
+    }
+
+    // Apps the batched response left out, or all of them if it failed, are checked through their app info
+    size_t missing = count_missing(items, count);
+    if (missing > 0) {
+        if (missing < count) ESP_LOGW(TAG, "Batched response is missing %u apps, checking them individually", missing);
+        check_individually(items, count, missing);
+    }
+    return count_missing(items, count) == 0;
+}
@@ -0,0 +1,438 @@
+#include "wifi_bench.h"
+
+#include <cJSON.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "graphics_wrapper.h"
+#include "hardware.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#include "nvs.h"
+#include "pax_gfx.h"
+#include "system_wrapper.h"
+#include "wifi_cert.h"
+#include "wifi_session.h"
+
+static const char* TAG = "WiFi benchmark";
+
+#define BENCH_URL_SIZE      128
+#define BENCH_CHUNK_SIZE    4096
+#define BENCH_STREAM_STACK  8192  // TLS handshakes need a lot of stack
+#define BENCH_TIMEOUT_MS    10000
+#define BENCH_RESULT_LENGTH 512
+
+// Timestamps and size of a single request, filled in by the HTTP client event handler.
+typedef struct {
+    int64_t start;       // Request started
+    int64_t connected;   // Connection (including the TLS handshake) established, 0 if an existing connection was reused
+    int64_t first_byte;  // First response header received
+    int64_t end;         // Response completely received
+    size_t  bytes;       // Size of the response body
+} bench_request_t;
+
+typedef struct {
+    char              url[BENCH_URL_SIZE];
+    bench_request_t   request;
+    bool              success;
+    SemaphoreHandle_t finished;
+} bench_stream_t;
+
+static esp_err_t bench_event_handler(esp_http_client_event_t* evt) {
+    bench_request_t* request = (bench_request_t*) evt->user_data;
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            request->connected = esp_timer_get_time();
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            if (request->first_byte == 0) request->first_byte = esp_timer_get_time();
+            break;
+        case HTTP_EVENT_ON_DATA:
+            request->bytes += evt->data_len;
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+static esp_http_client_handle_t bench_client(const char* url, esp_http_client_method_t method, bench_request_t* request) {
+    if (init_ca_store() != ESP_OK) return NULL;
+    esp_http_client_config_t config = {
+        .url                 = url,
+        .method              = method,
+        .use_global_ca_store = true,
+        .keep_alive_enable   = true,
+        .timeout_ms          = BENCH_TIMEOUT_MS,
+        .event_handler       = bench_event_handler,
+        .user_data           = request,
+    };
+    return esp_http_client_init(&config);
+}
+
+// Run a request on `client`, which may reuse the connection of the previous request.
+static bool bench_perform(esp_http_client_handle_t client, bench_request_t* request) {
+    memset(request, 0, sizeof(bench_request_t));
+    request->start = esp_timer_get_time();
+    esp_err_t err  = esp_http_client_perform(client);
+    request->end   = esp_timer_get_time();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Request failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    int status = esp_http_client_get_status_code(client);
+    if ((status != 200) && (status != 206)) {
+        ESP_LOGE(TAG, "Request failed with status %d", status);
+        return false;
+    }
+    return true;
+}
+
+// Download `url` once over a new connection, discarding the body.
+static bool bench_download(const char* url, bench_request_t* request) {
+    esp_http_client_handle_t client = bench_client(url, HTTP_METHOD_GET, request);
+    if (client == NULL) return false;
+    bool success = bench_perform(client, request);
+    esp_http_client_cleanup(client);
+    return success;
+}
+
+static void bench_stream_task(void* arg) {
+    bench_stream_t* stream = (bench_stream_t*) arg;
+    stream->success        = bench_download(stream->url, &stream->request);
+    xSemaphoreGive(stream->finished);
+    vTaskDelete(NULL);
+}
+
+// Throughput in megabit per second, 0 when no time has passed (a request that failed right away)
+static float bench_mbps(size_t bytes, int64_t microseconds) { return (microseconds > 0) ? (bytes * 8.0) / microseconds : 0; }
+
+// Download `url` over `count` connections at the same time, returns the combined throughput in megabit per second.
+static float bench_download_streams(const char* url, size_t count, cJSON* result) {
+    bench_stream_t streams[WIFI_BENCH_STREAMS] = {0};
+    if (count > WIFI_BENCH_STREAMS) count = WIFI_BENCH_STREAMS;
+
+    SemaphoreHandle_t finished = xSemaphoreCreateCounting(count, 0);
+    if (finished == NULL) return 0;
+
+    int64_t start   = esp_timer_get_time();
+    size_t  started = 0;
+    for (size_t index = 0; index < count; index++) {
+        strlcpy(streams[index].url, url, sizeof(streams[index].url));
+        streams[index].finished = finished;
+        if (xTaskCreate(bench_stream_task, "bench_stream", BENCH_STREAM_STACK, &streams[index], 5, NULL) != pdPASS) {
+            ESP_LOGW(TAG, "Failed to start stream %u", index);
+            break;
+        }
+        started++;
+    }
+    for (size_t index = 0; index < started; index++) {
+        xSemaphoreTake(finished, portMAX_DELAY);
+    }
+    int64_t end = esp_timer_get_time();
+    vSemaphoreDelete(finished);
+
+    size_t bytes   = 0;
+    bool   success = (started == count);
+    for (size_t index = 0; index < started; index++) {
+        bytes += streams[index].request.bytes;
+        success &= streams[index].success;
+    }
+    float seconds = (end - start) / 1000000.0;
+    float mbps    = bench_mbps(bytes, end - start);
+
+    cJSON_AddNumberToObject(result, "streams", count);
+    cJSON_AddBoolToObject(result, "success", success);
+    cJSON_AddNumberToObject(result, "bytes", bytes);
+    cJSON_AddNumberToObject(result, "seconds", seconds);
+    cJSON_AddNumberToObject(result, "mbps", mbps);
+    if (started > 0) {
+        bench_request_t* request = &streams[0].request;
+        cJSON_AddNumberToObject(result, "connect_ms", (request->connected - request->start) / 1000.0);
+        cJSON_AddNumberToObject(result, "ttfb_ms", (request->first_byte - request->connected) / 1000.0);
+    }
+    return success ? mbps : 0;
+}
+
+// Upload WIFI_BENCH_UPLOAD_SIZE bytes to `url`, returns the throughput in megabit per second.
+static float bench_upload(const char* url, cJSON* result) {
+    bench_request_t          request = {0};
+    esp_http_client_handle_t client  = bench_client(url, HTTP_METHOD_POST, &request);
+    if (client == NULL) return 0;
+    char* chunk = malloc(BENCH_CHUNK_SIZE);
+    if (chunk == NULL) {
+        esp_http_client_cleanup(client);
+        return 0;
+    }
+    memset(chunk, 0x55, BENCH_CHUNK_SIZE);
+    esp_http_client_set_header(client, "Content-Type", "application/octet-stream");
+
+    bool   success = false;
+    size_t sent    = 0;
+    request.start  = esp_timer_get_time();
+    if (esp_http_client_open(client, WIFI_BENCH_UPLOAD_SIZE) == ESP_OK) {
+        while (sent < WIFI_BENCH_UPLOAD_SIZE) {
+            size_t length  = WIFI_BENCH_UPLOAD_SIZE - sent;
+            int    written = esp_http_client_write(client, chunk, (length < BENCH_CHUNK_SIZE) ? length : BENCH_CHUNK_SIZE);
+            if (written <= 0) break;
+            sent += written;
+        }
+        if ((sent == WIFI_BENCH_UPLOAD_SIZE) && (esp_http_client_fetch_headers(client) >= 0)) {
+            int status = esp_http_client_get_status_code(client);
+            success    = (status >= 200) && (status < 300);
+            if (!success) ESP_LOGE(TAG, "Upload failed with status %d", status);
+        }
+    }
+    request.end = esp_timer_get_time();
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    free(chunk);
+
+    float seconds = (request.end - request.start) / 1000000.0;
+    float mbps    = bench_mbps(sent, request.end - request.start);
+    cJSON_AddBoolToObject(result, "success", success);
+    cJSON_AddNumberToObject(result, "bytes", sent);
+    cJSON_AddNumberToObject(result, "seconds", seconds);
+    cJSON_AddNumberToObject(result, "mbps", mbps);
+    return success ? mbps : 0;
+}
+
+static int bench_compare(const void* a, const void* b) {
+    int64_t left  = *(const int64_t*) a;
+    int64_t right = *(const int64_t*) b;
+    return (left > right) - (left < right);
+}
+
+// Parse the host and port out of `url`.
+static bool bench_parse_url(const char* url, char* host, size_t host_size, char* port, size_t port_size, bool* tls) {
+    const char* start = strstr(url, "://");
+    if (start == NULL) return false;
+    *tls = (strncmp(url, "https", 5) == 0);
+    start += 3;
+    size_t host_length = strcspn(start, ":/");
+    if ((host_length == 0) || (host_length >= host_size)) return false;
+    memcpy(host, start, host_length);
+    host[host_length] = '\0';
+    if (start[host_length] == ':') {
+        size_t port_length = strcspn(&start[host_length + 1], "/");
+        if ((port_length == 0) || (port_length >= port_size)) return false;
+        memcpy(port, &start[host_length + 1], port_length);
+        port[port_length] = '\0';
+    } else {
+        strlcpy(port, *tls ? "443" : "80", port_size);
+    }
+    return true;
+}
+
+// Time the DNS lookup and a bare TCP connect to the server, the HTTP client does not report these separately.
+static bool bench_tcp_phases(const char* url, int64_t* dns_us, int64_t* tcp_us, bool* tls) {
+    char host[64];
+    char port[8];
+    if (!bench_parse_url(url, host, sizeof(host), port, sizeof(port), tls)) return false;
+
+    struct addrinfo  hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo* addr  = NULL;
+    int64_t          start = esp_timer_get_time();
+    if ((getaddrinfo(host, port, &hints, &addr) != 0) || (addr == NULL)) {
+        ESP_LOGE(TAG, "Failed to resolve %s", host);
+        return false;
+    }
+    *dns_us = esp_timer_get_time() - start;
+
+    bool success = false;
+    int  sock    = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (sock >= 0) {
+        start   = esp_timer_get_time();
+        success = (connect(sock, addr->ai_addr, addr->ai_addrlen) == 0);
+        *tcp_us = esp_timer_get_time() - start;
+        close(sock);
+    }
+    freeaddrinfo(addr);
+    if (!success) ESP_LOGE(TAG, "Failed to connect to %s:%s", host, port);
+    return success;
+}
+
+// Measure small request latency over a kept alive connection.
+// The first request opens the connection and is used for the breakdown of the connection phases.
+static bool bench_latency(const char* url, cJSON* result) {
+    int64_t dns_us = 0, tcp_us = 0;
+    bool    tls    = false;
+    if (!bench_tcp_phases(url, &dns_us, &tcp_us, &tls)) return false;
+
+    int64_t* samples = malloc(sizeof(int64_t) * WIFI_BENCH_LATENCY_SAMPLES);
+    if (samples == NULL) return false;
+
+    bench_request_t          request = {0};
+    esp_http_client_handle_t client  = bench_client(url, HTTP_METHOD_GET, &request);
+    if (client == NULL) {
+        free(samples);
+        return false;
+    }
+    esp_http_client_set_header(client, "Range", "bytes=0-0");
+
+    // Cold request: DNS is cached by now, so the connect time is the TCP connect plus the TLS handshake.
+    bool success = bench_perform(client, &request);
+    if (success) {
+        int64_t connect_us = request.connected - request.start;
+        int64_t tls_us     = (tls && (connect_us > tcp_us)) ? (connect_us - tcp_us) : 0;
+        cJSON*  phases     = cJSON_AddObjectToObject(result, "phases");
+        cJSON_AddNumberToObject(phases, "dns_ms", dns_us / 1000.0);
+        cJSON_AddNumberToObject(phases, "tcp_ms", tcp_us / 1000.0);
+        cJSON_AddNumberToObject(phases, "tls_ms", tls_us / 1000.0);
+        cJSON_AddNumberToObject(phases, "ttfb_ms", (request.first_byte - request.connected) / 1000.0);
+        cJSON_AddNumberToObject(phases, "total_ms", (request.end - request.start) / 1000.0);
+    }
+
+    size_t count = 0;
+    while (success && (count < WIFI_BENCH_LATENCY_SAMPLES)) {
+        success = bench_perform(client, &request);
+        if (success) samples[count++] = request.end - request.start;
+    }
+    esp_http_client_cleanup(client);
+
+    if (count > 0) {
+        qsort(samples, count, sizeof(int64_t), bench_compare);
+        cJSON* latency = cJSON_AddObjectToObject(result, "latency");
+        cJSON_AddNumberToObject(latency, "samples", count);
+        cJSON_AddNumberToObject(latency, "min_ms", samples[0] / 1000.0);
+        cJSON_AddNumberToObject(latency, "p50_ms", samples[(count * 50) / 100] / 1000.0);
+        cJSON_AddNumberToObject(latency, "p99_ms", samples[(count * 99) / 100] / 1000.0);
+        cJSON_AddNumberToObject(latency, "max_ms", samples[count - 1] / 1000.0);
+    }
+    free(samples);
+    return success;
+}
+
+static void display_bench_state(const char* results, const char* status, bool buttons) {
+    pax_buf_t*        pax_buffer = get_pax_buffer();
+    const pax_font_t* font       = pax_font_saira_regular;
+    pax_noclip(pax_buffer);
+    pax_background(pax_buffer, 0xFFFFFF);
+    pax_draw_text(pax_buffer, 0xFF000000, font, 18, 5, 5, "WiFi benchmark");
+    pax_draw_text(pax_buffer, 0xFF000000, font, 18, 5, 5 + 2 * 18, results);
+    pax_draw_text(pax_buffer, 0xFF000000, font, 18, 5, 240 - 3 * 18, status);
+    if (buttons) pax_draw_text(pax_buffer, 0xFF000000, font, 18, 5, 240 - 18, "🅰 run again 🅱 back");
+    display_flush();
+}
+
+static double bench_get_number(const cJSON* object, const char* name, const char* field) {
+    const cJSON* value = cJSON_GetObjectItem(cJSON_GetObjectItem(object, name), field);
+    return cJSON_IsNumber(value) ? value->valuedouble : 0;
+}
+
+// Append a line to the results shown on the display.
+static void bench_append(char* results, size_t results_size, const char* format, ...) {
+    size_t  used = strlen(results);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(&results[used], results_size - used, format, args);
+    va_end(args);
+}
+
+static bool bench_store(cJSON* json) {
+    char* data = cJSON_Print(json);
+    if (data == NULL) return false;
+    FILE* fd      = fopen(WIFI_BENCH_RESULTS_FN, "w");
+    bool  success = false;
+    if (fd != NULL) {
+        success = (fwrite(data, 1, strlen(data), fd) == strlen(data));
+        fclose(fd);
+    }
+    free(data);
+    if (!success) ESP_LOGE(TAG, "Failed to store the results in %s", WIFI_BENCH_RESULTS_FN);
+    return success;
+}
+
+static void bench_run(const char* server, char* results, size_t results_size) {
+    char url[BENCH_URL_SIZE];
+    char status[48];
+    results[0] = '\0';
+
+    cJSON* json = cJSON_CreateObject();
+    if (json == NULL) return;
+    cJSON_AddStringToObject(json, "server", server);
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        cJSON_AddNumberToObject(json, "rssi", ap_info.rssi);
+        cJSON_AddNumberToObject(json, "channel", ap_info.primary);
+    }
+
+    snprintf(url, sizeof(url), "%s/test.bin", server);
+    display_bench_state(results, "Measuring latency...", false);
+    if (bench_latency(url, json)) {
+        bench_append(results, results_size, "DNS %.0f ms, TCP %.0f ms, TLS %.0f ms\nFirst byte %.0f ms\nLatency p50 %.0f ms, p99 %.0f ms\n",
+                     bench_get_number(json, "phases", "dns_ms"), bench_get_number(json, "phases", "tcp_ms"), bench_get_number(json, "phases", "tls_ms"),
+                     bench_get_number(json, "phases", "ttfb_ms"), bench_get_number(json, "latency", "p50_ms"), bench_get_number(json, "latency", "p99_ms"));
+    } else {
+        bench_append(results, results_size, "Latency: failed\n");
+    }
+
+    display_bench_state(results, "Downloading...", false);
+    float single = bench_download_streams(url, 1, cJSON_AddObjectToObject(json, "download"));
+    bench_append(results, results_size, (single > 0) ? "Download: %.2f Mbps\n" : "Download: failed\n", single);
+
+    snprintf(status, sizeof(status), "Downloading (%u streams)...", WIFI_BENCH_STREAMS);
+    display_bench_state(results, status, false);
+    float multi = bench_download_streams(url, WIFI_BENCH_STREAMS, cJSON_AddObjectToObject(json, "download_multi"));
+    bench_append(results, results_size, (multi > 0) ? "Download x%u: %.2f Mbps\n" : "Download x%u: failed\n", WIFI_BENCH_STREAMS, multi);
+
+    snprintf(url, sizeof(url), "%s/upload", server);
+    display_bench_state(results, "Uploading...", false);
+    float upload = bench_upload(url, cJSON_AddObjectToObject(json, "upload"));
+    bench_append(results, results_size, (upload > 0) ? "Upload: %.2f Mbps\n" : "Upload: failed\n", upload);
+
+    ESP_LOGI(TAG, "Results:\n%s", results);
+    bench_store(json);
+    cJSON_Delete(json);
+}
+
+void wifi_benchmark() {
+    pax_buf_t*   pax_buffer              = get_pax_buffer();
+    char         server[BENCH_URL_SIZE]  = WIFI_BENCH_DEFAULT_URL;
+    size_t       server_size             = sizeof(server);
+    nvs_handle_t handle;
+
+    if (nvs_open("system", NVS_READWRITE, &handle) != ESP_OK) return;
+    if (nvs_get_str(handle, "bench.url", server, &server_size) != ESP_OK) {
+        strlcpy(server, WIFI_BENCH_DEFAULT_URL, sizeof(server));
+    }
+    bool accepted = keyboard(30, 30, pax_buffer->width - 60, pax_buffer->height - 60, "Benchmark server", "Press 🅷 to cancel", server, sizeof(server));
+    if (accepted) {
+        nvs_set_str(handle, "bench.url", server);
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (!accepted) return;
+
+    // Accept the server with or without a trailing slash.
+    size_t length = strlen(server);
+    while ((length > 0) && (server[length - 1] == '/')) server[--length] = '\0';
+
+    char* results = malloc(BENCH_RESULT_LENGTH);
+    if (results == NULL) return;
+    results[0] = '\0';
+
+    while (true) {
+        display_bench_state(results, "Connecting...", false);
+        if (!wifi_session_acquire()) {
+            display_bench_state(results, "Failed to connect to network!", true);
+        } else {
+            wifi_session_transfer_begin();
+            bench_run(server, results, BENCH_RESULT_LENGTH);
+            wifi_session_transfer_end();
+            wifi_session_release();
+            display_bench_state(results, "Results stored in " WIFI_BENCH_RESULTS_FN, true);
+        }
+        if (!wait_for_button()) break;
+    }
+    free(results);
+}
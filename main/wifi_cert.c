@@ -6,29 +6,59 @@
 #include "esp_crt_bundle.h"
 #include "esp_log.h"
 #include "esp_tls.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
-extern const uint8_t custom_ota_cert_pem_start[] asm("_binary_custom_ota_cert_pem_start");
-extern const uint8_t custom_ota_cert_cert_pem_end[] asm("_binary_custom_ota_cert_pem_end");
+// The certificates are converted from PEM to DER at build time, which mbedtls parses without decoding base64 first
+extern const uint8_t custom_ota_cert_der_start[] asm("_binary_custom_ota_cert_der_start");
+extern const uint8_t custom_ota_cert_der_end[] asm("_binary_custom_ota_cert_der_end");
 
-extern const uint8_t isrgrootx1_pem_start[] asm("_binary_isrgrootx1_pem_start");
-extern const uint8_t isrgrootx1_pem_end[] asm("_binary_isrgrootx1_pem_end");
+extern const uint8_t isrgrootx1_der_start[] asm("_binary_isrgrootx1_der_start");
+extern const uint8_t isrgrootx1_der_end[] asm("_binary_isrgrootx1_der_end");
 
-esp_err_t init_ca_store() {
-    // This function is called from main and initializes a custom certificate storage.
-    // Custom certificates can be added to this storage as required.
+static const char* TAG = "wifi_cert";
+
+typedef enum _ca_store_state {
+    CA_STORE_EMPTY,
+    CA_STORE_LOADING,
+    CA_STORE_LOADED,
+} ca_store_state_t;
+
+static portMUX_TYPE              ca_store_lock  = portMUX_INITIALIZER_UNLOCKED;
+static volatile ca_store_state_t ca_store_state = CA_STORE_EMPTY;
+
+static esp_err_t load_ca_store() {
     esp_err_t res = esp_tls_init_global_ca_store();
     if (res != ESP_OK) {
         return res;
     }
 
-    res = esp_tls_set_global_ca_store(custom_ota_cert_pem_start, custom_ota_cert_cert_pem_end - custom_ota_cert_pem_start);  // Self-signed fallback certificate
+    res = esp_tls_set_global_ca_store(custom_ota_cert_der_start, custom_ota_cert_der_end - custom_ota_cert_der_start);  // Self-signed fallback certificate
     if (res != ESP_OK) {
         return res;
     }
 
-    res = esp_tls_set_global_ca_store(isrgrootx1_pem_start, isrgrootx1_pem_end - isrgrootx1_pem_start);  // Let's encrypt root CA
+    res = esp_tls_set_global_ca_store(isrgrootx1_der_start, isrgrootx1_der_end - isrgrootx1_der_start);  // Let's encrypt root CA
+    return res;
+}
+
+esp_err_t init_ca_store() {
+    portENTER_CRITICAL(&ca_store_lock);
+    bool load = (ca_store_state == CA_STORE_EMPTY);
+    if (load) ca_store_state = CA_STORE_LOADING;
+    portEXIT_CRITICAL(&ca_store_lock);
+
+    if (!load) {
+        // Another task is loading the certificates, wait for it
+        while (ca_store_state == CA_STORE_LOADING) vTaskDelay(1);
+        return (ca_store_state == CA_STORE_LOADED) ? ESP_OK : ESP_FAIL;
+    }
+
+    esp_err_t res = load_ca_store();
     if (res != ESP_OK) {
-        return res;
+        ESP_LOGE(TAG, "Failed to load the CA store: %s", esp_err_to_name(res));
+        esp_tls_free_global_ca_store();
     }
+    ca_store_state = (res == ESP_OK) ? CA_STORE_LOADED : CA_STORE_EMPTY;
     return res;
 }
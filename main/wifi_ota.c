@@ -10,22 +10,34 @@
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "gzip_stream.h"
 #include "hardware.h"
+#include "http_download.h"
+#include "http_timing.h"
+#include "mirrors.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "string.h"
 #include "wifi.h"
 #include "wifi_cert.h"
 #include "wifi_connect.h"
+#include "wifi_session.h"
 
 #define HASH_LEN 32
 
+#define OTA_WRITE_BLOCK          (64 * 1024)  // Flash is written, and so erased, in 64 KB blocks which erase much faster than 4 KB sectors
+#define OTA_PROGRESS_INTERVAL_US 250000       // Minimum time between progress updates on the display
+
 static const char *TAG = "OTA update";
 
+static http_timing_t ota_timing;  // Timing of the uncompressed image download
+
 esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
+    http_timing_event(&ota_timing, evt);
     switch (evt->event_id) {
         case HTTP_EVENT_ERROR:
             ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
@@ -124,23 +136,181 @@ void display_ota_state(const char *text, bool nightly) {
     display_flush();
 }
 
+// Redraw only the status line, at most every OTA_PROGRESS_INTERVAL_US
+static void display_ota_progress(int64_t *last_update, int percent, bool nightly) {
+    int64_t now = esp_timer_get_time();
+    if ((*last_update != 0) && (now - *last_update < OTA_PROGRESS_INTERVAL_US)) return;
+    *last_update = now;
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "Updating... %d%%", percent);
+    pax_buf_t        *pax_buffer = get_pax_buffer();
+    const pax_font_t *font       = pax_font_saira_regular;
+    pax_draw_rect(pax_buffer, nightly ? 0xFF000000 : 0xFFFFFFFF, 0, 120 + 10, pax_buffer->width, 18);
+    pax_vec1_t size = pax_text_size(font, 18, buffer);
+    pax_draw_text(pax_buffer, nightly ? 0xFFFFFFFF : 0xFF000000, font, 18, (320 / 2) - (size.x / 2), 120 + 10, buffer);
+    display_flush_partial(0, 120 + 10, pax_buffer->width - 1, 120 + 10 + 18 - 1);
+}
+
+typedef struct {
+    const esp_partition_t *partition;
+    esp_ota_handle_t       handle;
+    bool                   begun;        // esp_ota_begin has been called
+    bool                   up_to_date;   // The image has the version that is running
+    gzip_stream_t         *inflater;
+    size_t                 received;     // Amount of compressed data fed to the inflater
+    uint8_t               *block;        // Decompressed data waiting to be written
+    size_t                 buffered;     // Amount of data in the block
+    size_t                 written;      // Amount of data written to the partition
+    bool                   nightly;
+    int64_t                last_update;  // Time of the last progress update
+} ota_stream_t;
+
+static bool ota_write_block(ota_stream_t *ota) {
+    if (ota->buffered == 0) return true;
+    if (!ota->begun) {
+        // The first block holds the app description, check it before anything is erased
+        size_t desc_offset = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t);
+        if (ota->buffered < desc_offset + sizeof(esp_app_desc_t)) return false;
+        if (validate_image_header((esp_app_desc_t *) &ota->block[desc_offset]) != ESP_OK) {
+            ota->up_to_date = true;
+            return false;
+        }
+        // Sequential writes erase just the range being written, so writing whole blocks erases whole blocks
+        if (esp_ota_begin(ota->partition, OTA_WITH_SEQUENTIAL_WRITES, &ota->handle) != ESP_OK) return false;
+        ota->begun = true;
+    }
+    if (esp_ota_write(ota->handle, ota->block, ota->buffered) != ESP_OK) return false;
+    ota->written += ota->buffered;
+    ota->buffered = 0;
+    return true;
+}
+
+static bool ota_inflated(const uint8_t *data, size_t length, size_t offset, size_t total, void *user) {
+    ota_stream_t *ota = (ota_stream_t *) user;
+    while (length > 0) {
+        size_t chunk = OTA_WRITE_BLOCK - ota->buffered;
+        if (chunk > length) chunk = length;
+        memcpy(&ota->block[ota->buffered], data, chunk);
+        ota->buffered += chunk;
+        data += chunk;
+        length -= chunk;
+        if ((ota->buffered == OTA_WRITE_BLOCK) && (!ota_write_block(ota))) return false;
+    }
+    return true;
+}
+
+static bool ota_receive(const uint8_t *data, size_t length, size_t offset, size_t total, void *user) {
+    ota_stream_t *ota = (ota_stream_t *) user;
+    if ((offset == 0) && ((ota->inflater == NULL) || (ota->received > 0))) {
+        // Start of the (retried) download
+        if (ota->inflater != NULL) gzip_stream_free(ota->inflater);
+        if (ota->begun) esp_ota_abort(ota->handle);
+        ota->begun    = false;
+        ota->buffered = 0;
+        ota->written  = 0;
+        ota->received = 0;
+        ota->inflater = gzip_stream_create(ota_inflated, ota);
+        if (ota->inflater == NULL) return false;
+    }
+    if (!gzip_stream_feed(ota->inflater, data, length)) return false;
+    ota->received += length;
+    if (total > 0) display_ota_progress(&ota->last_update, ((offset + length) * 100) / total, ota->nightly);
+    return true;
+}
+
+// Download the gzip compressed image and inflate it straight into the OTA partition.
+// Returns ESP_ERR_NOT_FOUND when the compressed image can't be downloaded, so the uncompressed image can be tried instead.
+static esp_err_t ota_update_compressed(const char *url, bool nightly) {
+    ota_stream_t ota = {0};
+    ota.nightly      = nightly;
+    ota.partition    = esp_ota_get_next_update_partition(NULL);
+    ota.block        = malloc(OTA_WRITE_BLOCK);
+    if ((ota.partition == NULL) || (ota.block == NULL)) {
+        free(ota.block);
+        return ESP_ERR_NO_MEM;
+    }
+
+    bool success = download_stream(url, ota_receive, &ota);
+    success      = success && (ota.inflater != NULL) && gzip_stream_finished(ota.inflater);
+    success      = success && ota_write_block(&ota);
+    bool started = ota.begun;
+    if (ota.inflater != NULL) gzip_stream_free(ota.inflater);
+    free(ota.block);
+
+    if (ota.up_to_date) return ESP_ERR_INVALID_VERSION;
+    if (!success) {
+        if (ota.begun) esp_ota_abort(ota.handle);
+        return started ? ESP_FAIL : ESP_ERR_NOT_FOUND;
+    }
+
+    ESP_LOGI(TAG, "Wrote %u bytes", ota.written);
+    esp_err_t err = esp_ota_end(ota.handle);
+    if (err == ESP_OK) err = esp_ota_set_boot_partition(ota.partition);
+    return err;
+}
+
 void ota_update(bool nightly) {
     display_ota_state("Connecting to WiFi...", nightly);
 
-    char *ota_url = nightly ? "https://mch2022.ota.bodge.team/mch2022_dev.bin" : "https://mch2022.ota.bodge.team/mch2022.bin";
+    char *ota_url = nightly ? MIRROR_OTA_URL "/mch2022_dev.bin" : MIRROR_OTA_URL "/mch2022.bin";
 
-    if (!wifi_connect_to_stored()) {
+    if (!wifi_session_acquire()) {
         display_ota_state("Failed to connect to WiFi", nightly);
         vTaskDelay(500 / portTICK_PERIOD_MS);
         return;
     }
 
     display_ota_state("Starting update...", nightly);
-    esp_wifi_set_ps(WIFI_PS_NONE);  // Disable any WiFi power save mode
+    wifi_session_transfer_begin();
 
     ESP_LOGI(TAG, "Starting OTA update");
 
-    esp_http_client_config_t config = {.url = ota_url, .use_global_ca_store = true, .event_handler = _http_event_handler, .keep_alive_enable = true};
+    // The compressed image is about a third of the size, which shortens the download considerably
+    char ota_url_compressed[128];
+    snprintf(ota_url_compressed, sizeof(ota_url_compressed), "%s.gz", ota_url);
+    esp_err_t err = ota_update_compressed(ota_url_compressed, nightly);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Compressed upgrade successful. Rebooting ...");
+        display_ota_state("Update installed", nightly);
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        esp_restart();
+    } else if (err == ESP_ERR_INVALID_VERSION) {
+        wifi_session_transfer_end();
+        wifi_session_release();
+        display_ota_state("Already up-to-date!", nightly);
+        vTaskDelay(2000 / portTICK_PERIOD_MS);
+        return;
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGE(TAG, "Compressed upgrade failed 0x%x", err);
+        display_ota_state((err == ESP_ERR_OTA_VALIDATE_FAILED) ? "Image validation failed" : "Update failed", nightly);
+        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        esp_restart();
+    }
+    ESP_LOGW(TAG, "No compressed image available, downloading the uncompressed image");
+
+    // esp_https_ota does not go through http_download, pick the mirror here
+    char mirrored_url[256];
+    mirror_rewrite(ota_url, mirrored_url, sizeof(mirrored_url));
+    err = init_ca_store();
+    if (err != ESP_OK) {
+        wifi_session_transfer_end();
+        wifi_session_release();
+        ESP_LOGE(TAG, "Failed to load the CA certificates: %s", esp_err_to_name(err));
+        display_ota_state("Failed to load certificates", nightly);
+        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        return;
+    }
+
+    esp_http_client_config_t config = {
+        .url                 = mirrored_url,
+        .use_global_ca_store = true,
+        .event_handler       = _http_event_handler,
+        .keep_alive_enable   = true,
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        .save_client_session = true,  // Resume the TLS session when a partial download has to reconnect
+#endif
+    };
 
     esp_https_ota_config_t ota_config = {
         .http_config         = &config,
@@ -157,10 +327,14 @@ void ota_update(bool nightly) {
 
     display_ota_state("Starting download...", nightly);
 
+    http_timing_begin(&ota_timing, mirrored_url, false);
     esp_https_ota_handle_t https_ota_handle = NULL;
-    esp_err_t              err              = esp_https_ota_begin(&ota_config, &https_ota_handle);
+    err                                     = esp_https_ota_begin(&ota_config, &https_ota_handle);
     if (err != ESP_OK) {
-        wifi_disconnect_and_disable();
+        http_timing_end(&ota_timing, false);
+        mirror_report_failure(mirrored_url);
+        wifi_session_transfer_end();
+        wifi_session_release();
         ESP_LOGE(TAG, "ESP HTTPS OTA Begin failed");
         display_ota_state("Failed to start download", nightly);
         vTaskDelay(5000 / portTICK_PERIOD_MS);
@@ -171,16 +345,20 @@ void ota_update(bool nightly) {
     err = esp_https_ota_get_img_desc(https_ota_handle, &app_desc);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_https_ota_read_img_desc failed");
+        http_timing_end(&ota_timing, false);
         esp_https_ota_abort(https_ota_handle);
-        wifi_disconnect_and_disable();
+        wifi_session_transfer_end();
+        wifi_session_release();
         display_ota_state("Failed to read image desc", nightly);
         vTaskDelay(5000 / portTICK_PERIOD_MS);
         return;
     }
     err = validate_image_header(&app_desc);
     if (err != ESP_OK) {
+        http_timing_end(&ota_timing, true);
         esp_https_ota_abort(https_ota_handle);
-        wifi_disconnect_and_disable();
+        wifi_session_transfer_end();
+        wifi_session_release();
         display_ota_state("Already up-to-date!", nightly);
         vTaskDelay(2000 / portTICK_PERIOD_MS);
         return;
@@ -188,6 +366,7 @@ void ota_update(bool nightly) {
 
     esp_err_t ota_finish_err = ESP_OK;
     int       percent_shown  = -1;
+    int64_t   last_update    = 0;
     while (1) {
         err = esp_https_ota_perform(https_ota_handle);
         if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
@@ -201,12 +380,11 @@ void ota_update(bool nightly) {
         if (percent != percent_shown) {
             ESP_LOGI(TAG, "Downloading %d / %d (%d%%)", len_read, len_total, percent);
             percent_shown = percent;
-            char buffer[128];
-            snprintf(buffer, sizeof(buffer), "Updating... %d%%", percent);
-            display_ota_state(buffer, nightly);
+            display_ota_progress(&last_update, percent, nightly);
         }
     }
 
+    http_timing_end(&ota_timing, esp_https_ota_is_complete_data_received(https_ota_handle));
     if (esp_https_ota_is_complete_data_received(https_ota_handle) != true) {
         // the OTA image was not completely received and user can customise the response to this situation.
         ESP_LOGE(TAG, "Complete data was not received.");
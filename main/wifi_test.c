@@ -21,8 +21,10 @@
 #include "string.h"
 #include "system_wrapper.h"
 #include "wifi.h"
+#include "wifi_cert.h"
 #include "wifi_connect.h"
 #include "wifi_connection.h"
+#include "wifi_session.h"
 
 static const char* wifi_auth_names[] = {
     "None", "WEP", "WPA1", "WPA2", "WPA1/2", "WPA2 Ent", "WPA3", "WPA2/3", "WAPI",
@@ -98,29 +100,40 @@ void wifi_connection_test(xQueueHandle button_queue) {
     nvs_close(handle);
 
     bool quit             = false;
+    bool connected        = false;
     char test_result[128] = {0};
     while (!quit) {
         esp_netif_ip_info_t* ip_info = wifi_get_ip_info();
-        wifi_disconnect_and_disable();
+        if (connected) {
+            wifi_session_transfer_end();
+            wifi_session_release();
+            connected = false;
+        }
         display_test_state(test_result, ssid, password, authmode, phase2, username, anon_ident, ip_info, true);
         quit = !wait_for_button();
         if (quit) break;
         display_test_state("Connecting...", ssid, password, authmode, phase2, username, anon_ident, ip_info, false);
 
-        if (!wifi_connect_to_stored()) {
+        if (!wifi_session_acquire_fresh()) {  // The test is about connecting, not about reusing the connection
             sprintf(test_result, "Failed to connect to network!");
             continue;
         }
+        connected = true;
 
         display_test_state("Testing...", ssid, password, authmode, phase2, username, anon_ident, ip_info, false);
 
-        esp_wifi_set_ps(WIFI_PS_NONE);  // Disable any WiFi power save mode
+        wifi_session_transfer_begin();
 
+        esp_err_t err = init_ca_store();
+        if (err != ESP_OK) {
+            snprintf(test_result, sizeof(test_result), "Failed to load certificates: %s", esp_err_to_name(err));
+            continue;
+        }
         esp_http_client_config_t config = {.url = "https://mch2022.ota.bodge.team/test.bin", .use_global_ca_store = true, .keep_alive_enable = true};
 
         esp_http_client_handle_t client     = esp_http_client_init(&config);
         int64_t                  time_start = esp_timer_get_time();
-        esp_err_t                err        = esp_http_client_perform(client);
+        err                                 = esp_http_client_perform(client);
         int64_t                  time_end   = esp_timer_get_time();
 
         if (err != ESP_OK) {
@@ -0,0 +1,75 @@
+// Stand-ins for the parts of the firmware that need the badge: mirrors, WiFi, the CA store, the display and deep sleep.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootscreen.h"
+#include "esp_sleep.h"
+#include "graphics_wrapper.h"
+#include "hardware.h"
+#include "mirrors.h"
+#include "soc/rtc_cntl_reg.h"
+#include "system_wrapper.h"
+#include "wifi_cert.h"
+#include "wifi_connection.h"
+#include "wifi_session.h"
+
+// Requests to the canonical servers go to the stand-in server started by with_server.sh
+void mirror_rewrite(const char* url, char* output, size_t size) {
+    const char* base      = getenv("STANDIN_URL");
+    const char* servers[] = {MIRROR_HATCHERY_URL, MIRROR_OTA_URL};
+    for (size_t index = 0; (base != NULL) && (index < MIRROR_SERVERS); index++) {
+        size_t length = strlen(servers[index]);
+        if (strncmp(url, servers[index], length) != 0) continue;
+        snprintf(output, size, "%s%s", base, &url[length]);
+        return;
+    }
+    snprintf(output, size, "%s", url);
+}
+
+void mirror_report_failure(const char* url) {}
+
+esp_err_t init_ca_store() { return ESP_OK; }
+
+bool shim_wifi_connected = true;  // Cleared by tests to see what happens offline
+
+bool wifi_is_connected() { return shim_wifi_connected; }
+
+void wifi_session_transfer_begin() {}
+
+void wifi_session_transfer_end() {}
+
+uint32_t shim_rtc_store0 = 0;
+
+void display_boot_screen() {}
+
+void render_message(char* message) { fprintf(stderr, "Message: %s\n", message); }
+
+esp_err_t display_flush() { return ESP_OK; }
+
+bool wait_for_button() { return true; }
+
+size_t get_file_size(FILE* fd) {
+    long position = ftell(fd);
+    fseek(fd, 0, SEEK_END);
+    long size = ftell(fd);
+    fseek(fd, position, SEEK_SET);
+    return size;
+}
+
+uint8_t* load_file_to_ram(FILE* fd) {
+    size_t   size = get_file_size(fd);
+    uint8_t* data = malloc(size);
+    if ((data != NULL) && (fread(data, 1, size, fd) != size)) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option) { return ESP_OK; }
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) { return ESP_OK; }
+
+void esp_deep_sleep_start() { abort(); }
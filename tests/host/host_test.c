@@ -0,0 +1,46 @@
+#include "host_test.h"
+
+#include <string.h>
+
+#include "http_download.h"
+#include "mirrors.h"
+
+const char* standin_root() {
+    const char* root = getenv("STANDIN_ROOT");
+    CHECK(root != NULL);  // Run the test with with_server.sh
+    return root;
+}
+
+const char* standin_url(const char* path) {
+    static char url[256];
+    snprintf(url, sizeof(url), MIRROR_HATCHERY_URL "%s", path);
+    return url;
+}
+
+int standin_stat(const char* key) {
+    char*  data = NULL;
+    size_t size = 0;
+    CHECK(download_ram(standin_url("/stats"), (uint8_t**) &data, &size));
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    char* found = memmem(data, size, pattern, strlen(pattern));
+    CHECK(found != NULL);
+    int value = atoi(&found[strlen(pattern)]);
+    free(data);
+    return value;
+}
+
+unsigned char* standin_random_file(const char* path, size_t size) {
+    unsigned char* data = malloc(size);
+    CHECK(data != NULL);
+    for (size_t index = 0; index < size; index++) {
+        data[index] = random();
+    }
+    char file_path[512];
+    snprintf(file_path, sizeof(file_path), "%s/%s", standin_root(), path);
+    FILE* file = fopen(file_path, "wb");
+    CHECK(file != NULL);
+    CHECK(fwrite(data, 1, size, file) == size);
+    fclose(file);
+    return data;
+}
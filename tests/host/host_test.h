@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Stop the test with a message when `condition` is false.
+#define CHECK(condition)                                                                       \
+    do {                                                                                       \
+        if (!(condition)) {                                                                    \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);     \
+            exit(1);                                                                           \
+        }                                                                                      \
+    } while (0)
+
+// Directory the stand-in server serves its files from, files written here can be downloaded right away.
+const char* standin_root();
+
+// URL of `path` on the stand-in server, for example "/file.bin". The URL is valid until the next call.
+const char* standin_url(const char* path);
+
+// Get a counter from the /stats of the stand-in server, the request itself goes through the connection pool.
+int standin_stat(const char* key);
+
+// Write `size` random bytes to `path` under the root of the stand-in server, returns the data (free it with free).
+unsigned char* standin_random_file(const char* path, size_t size);
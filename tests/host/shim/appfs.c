@@ -0,0 +1,121 @@
+#include "appfs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SHIM_APPFS_ENTRIES 16
+
+typedef struct {
+    char*    name;  // NULL if the entry is free
+    char*    title;
+    uint16_t version;
+    size_t   size;
+    uint8_t* data;  // Size rounded up to whole pages, like the real AppFS allocates
+} shim_appfs_entry_t;
+
+static shim_appfs_entry_t entries[SHIM_APPFS_ENTRIES];
+
+static size_t allocated(size_t size) { return (size + SPI_FLASH_MMU_PAGE_SIZE - 1) & ~(SPI_FLASH_MMU_PAGE_SIZE - 1); }
+
+static shim_appfs_entry_t* entry(appfs_handle_t fd) {
+    if ((fd < 0) || (fd >= SHIM_APPFS_ENTRIES) || (entries[fd].name == NULL)) return NULL;
+    return &entries[fd];
+}
+
+esp_err_t appfsInit(int type, int subtype) { return ESP_OK; }
+
+appfs_handle_t appfsOpen(const char* filename) {
+    for (appfs_handle_t fd = 0; fd < SHIM_APPFS_ENTRIES; fd++) {
+        if ((entries[fd].name != NULL) && (strcmp(entries[fd].name, filename) == 0)) return fd;
+    }
+    return APPFS_INVALID_FD;
+}
+
+bool appfsExists(const char* filename) { return appfsOpen(filename) != APPFS_INVALID_FD; }
+
+esp_err_t appfsDeleteFile(const char* filename) {
+    shim_appfs_entry_t* found = entry(appfsOpen(filename));
+    if (found == NULL) return ESP_ERR_NOT_FOUND;
+    free(found->name);
+    free(found->title);
+    free(found->data);
+    memset(found, 0, sizeof(shim_appfs_entry_t));
+    return ESP_OK;
+}
+
+esp_err_t appfsCreateFileExt(const char* filename, const char* title, uint16_t version, size_t size, appfs_handle_t* handle) {
+    appfsDeleteFile(filename);  // Like the real AppFS, an existing entry with the same name is replaced
+    for (appfs_handle_t fd = 0; fd < SHIM_APPFS_ENTRIES; fd++) {
+        shim_appfs_entry_t* free_entry = &entries[fd];
+        if (free_entry->name != NULL) continue;
+        free_entry->data = malloc(allocated(size));
+        if (free_entry->data == NULL) return ESP_ERR_NO_MEM;
+        memset(free_entry->data, 0x5A, allocated(size));  // Not erased
+        free_entry->name    = strdup(filename);
+        free_entry->title   = strdup(title);
+        free_entry->version = version;
+        free_entry->size    = size;
+        *handle             = fd;
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t appfsErase(appfs_handle_t fd, size_t start, size_t len) {
+    shim_appfs_entry_t* found = entry(fd);
+    if ((found == NULL) || (start % SPI_FLASH_SEC_SIZE) || (len % SPI_FLASH_SEC_SIZE) || (start + len > allocated(found->size))) return ESP_ERR_INVALID_ARG;
+    memset(&found->data[start], 0xFF, len);
+    return ESP_OK;
+}
+
+esp_err_t appfsWrite(appfs_handle_t fd, size_t start, uint8_t* buf, size_t len) {
+    shim_appfs_entry_t* found = entry(fd);
+    if ((found == NULL) || (start + len > allocated(found->size))) return ESP_ERR_INVALID_ARG;
+    for (size_t index = 0; index < len; index++) {
+        if (found->data[start + index] != 0xFF) return ESP_ERR_INVALID_STATE;  // Not erased
+    }
+    memcpy(&found->data[start], buf, len);
+    return ESP_OK;
+}
+
+esp_err_t appfsRead(appfs_handle_t fd, size_t start, void* buf, size_t len) {
+    shim_appfs_entry_t* found = entry(fd);
+    if ((found == NULL) || (start + len > allocated(found->size))) return ESP_ERR_INVALID_ARG;
+    memcpy(buf, &found->data[start], len);
+    return ESP_OK;
+}
+
+void appfsEntryInfoExt(appfs_handle_t fd, const char** name, const char** title, uint16_t* version, int* size) {
+    shim_appfs_entry_t* found = entry(fd);
+    if (found == NULL) return;
+    if (name != NULL) *name = found->name;
+    if (title != NULL) *title = found->title;
+    if (version != NULL) *version = found->version;
+    if (size != NULL) *size = found->size;
+}
+
+void appfsEntryInfo(appfs_handle_t fd, const char** name, int* size) { appfsEntryInfoExt(fd, name, NULL, NULL, size); }
+
+appfs_handle_t appfsNextEntry(appfs_handle_t fd) {
+    for (fd = (fd < 0) ? 0 : fd + 1; fd < SHIM_APPFS_ENTRIES; fd++) {
+        if (entries[fd].name != NULL) return fd;
+    }
+    return APPFS_INVALID_FD;
+}
+
+esp_err_t appfsRename(const char* from, const char* to) {
+    shim_appfs_entry_t* found = entry(appfsOpen(from));
+    if (found == NULL) return ESP_ERR_NOT_FOUND;
+    appfsDeleteFile(to);
+    free(found->name);
+    found->name = strdup(to);
+    return ESP_OK;
+}
+
+int shim_appfs_count() {
+    int count = 0;
+    for (appfs_handle_t fd = 0; fd < SHIM_APPFS_ENTRIES; fd++) {
+        if (entries[fd].name != NULL) count++;
+    }
+    return count;
+}
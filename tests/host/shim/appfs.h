@@ -0,0 +1,33 @@
+#pragma once
+
+// AppFS in RAM. Like NOR flash, data can only be written to erased bytes, so the tests notice a write that wasn't erased first.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define APPFS_PART_TYPE         0x43
+#define APPFS_PART_SUBTYPE      0x3
+#define APPFS_INVALID_FD        -1
+#define SPI_FLASH_SEC_SIZE      4096
+#define SPI_FLASH_MMU_PAGE_SIZE 0x10000
+
+typedef int appfs_handle_t;
+
+esp_err_t      appfsInit(int type, int subtype);
+bool           appfsExists(const char* filename);
+appfs_handle_t appfsOpen(const char* filename);
+esp_err_t      appfsDeleteFile(const char* filename);
+esp_err_t      appfsCreateFileExt(const char* filename, const char* title, uint16_t version, size_t size, appfs_handle_t* handle);
+esp_err_t      appfsErase(appfs_handle_t fd, size_t start, size_t len);
+esp_err_t      appfsWrite(appfs_handle_t fd, size_t start, uint8_t* buf, size_t len);
+esp_err_t      appfsRead(appfs_handle_t fd, size_t start, void* buf, size_t len);
+void           appfsEntryInfo(appfs_handle_t fd, const char** name, int* size);
+void           appfsEntryInfoExt(appfs_handle_t fd, const char** name, const char** title, uint16_t* version, int* size);
+appfs_handle_t appfsNextEntry(appfs_handle_t fd);
+esp_err_t      appfsRename(const char* from, const char* to);
+
+// Amount of entries, for checking that nothing was left behind.
+int shim_appfs_count();
@@ -0,0 +1,3 @@
+#pragma once
+
+void display_boot_screen();
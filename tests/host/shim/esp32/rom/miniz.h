@@ -0,0 +1,78 @@
+#pragma once
+
+// The tinfl inflater of the ROM (miniz 1.15) on top of zlib.
+// Like the ROM version it reads ahead: when the deflate stream ends, up to 3 bytes that follow it have been
+// consumed into the bit buffer, m_num_bits tells how many bits are left there.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE        32768
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+#define TINFL_LOOKAHEAD_BYTES     3
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM        = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED           = -1,
+    TINFL_STATUS_DONE             = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT  = 2,
+} tinfl_status;
+
+typedef struct {
+    z_stream stream;
+    int      initialized;
+    int      done;
+    uint32_t m_num_bits;
+    uint32_t m_bit_buf;
+} tinfl_decompressor;
+
+#define tinfl_init(r)         \
+    do {                      \
+        (r)->initialized = 0; \
+        (r)->done        = 0; \
+        (r)->m_num_bits  = 0; \
+        (r)->m_bit_buf   = 0; \
+    } while (0)
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* in_size, uint8_t* start, uint8_t* out, size_t* out_size,
+                                            uint32_t flags) {
+    if (r->done) {
+        *in_size  = 0;
+        *out_size = 0;
+        return TINFL_STATUS_DONE;
+    }
+    if (!r->initialized) {
+        memset(&r->stream, 0, sizeof(r->stream));
+        if (inflateInit2(&r->stream, -15) != Z_OK) return TINFL_STATUS_FAILED;
+        r->initialized = 1;
+    }
+    r->stream.next_in   = (Bytef*) in;
+    r->stream.avail_in  = *in_size;
+    r->stream.next_out  = out;
+    r->stream.avail_out = *out_size;
+    int res             = inflate(&r->stream, Z_NO_FLUSH);
+    *in_size -= r->stream.avail_in;
+    *out_size -= r->stream.avail_out;
+    if (res == Z_STREAM_END) {
+        uint32_t lookahead = (r->stream.avail_in < TINFL_LOOKAHEAD_BYTES) ? r->stream.avail_in : TINFL_LOOKAHEAD_BYTES;
+        for (uint32_t index = 0; index < lookahead; index++) {
+            r->m_bit_buf |= (uint32_t) in[*in_size + index] << (8 * index);
+        }
+        r->m_num_bits = 8 * lookahead;
+        *in_size += lookahead;
+        r->done = 1;
+        inflateEnd(&r->stream);
+        return TINFL_STATUS_DONE;
+    }
+    if ((res != Z_OK) && (res != Z_BUF_ERROR)) {
+        inflateEnd(&r->stream);
+        r->initialized = 0;
+        return TINFL_STATUS_FAILED;
+    }
+    if (r->stream.avail_out == 0) return TINFL_STATUS_HAS_MORE_OUTPUT;
+    return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
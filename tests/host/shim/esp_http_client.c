@@ -0,0 +1,299 @@
+#include "esp_http_client.h"
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define SHIM_MAX_HEADERS 16
+#define SHIM_BUFFER_SIZE 4096
+
+typedef struct {
+    char* key;
+    char* value;
+} shim_header_t;
+
+struct esp_http_client {
+    char                     host[128];
+    int                      port;
+    char                     path[256];
+    esp_http_client_method_t method;
+    const char*              post_data;
+    int                      post_length;
+    shim_header_t            headers[SHIM_MAX_HEADERS];
+    http_event_handle_cb     event_handler;
+    void*                    user_data;
+    int                      timeout_ms;
+    int                      sock;  // -1 if not connected
+    int                      status;
+    int64_t                  content_length;
+    uint8_t                  buffer[SHIM_BUFFER_SIZE];
+    size_t                   buffered;
+    size_t                   position;
+};
+
+static void dispatch(esp_http_client_handle_t client, esp_http_client_event_id_t id, void* data, int length, char* key, char* value) {
+    if (client->event_handler == NULL) return;
+    esp_http_client_event_t evt = {
+        .event_id     = id,
+        .client       = client,
+        .data         = data,
+        .data_len     = length,
+        .user_data    = client->user_data,
+        .header_key   = key,
+        .header_value = value,
+    };
+    client->event_handler(&evt);
+}
+
+static bool parse_url(esp_http_client_handle_t client, const char* url) {
+    if (strncasecmp(url, "http://", 7) != 0) {
+        fprintf(stderr, "E (HTTP client shim) Only http:// URLs are supported: %s\n", url);
+        return false;
+    }
+    const char* host   = &url[7];
+    size_t      length = strcspn(host, ":/?#");
+    if ((length == 0) || (length >= sizeof(client->host))) return false;
+    char new_host[sizeof(client->host)];
+    memcpy(new_host, host, length);
+    new_host[length] = '\0';
+    int         port = 80;
+    const char* rest = &host[length];
+    if (*rest == ':') {
+        port = atoi(&rest[1]);
+        rest += strcspn(rest, "/?#");
+    }
+    // Like the real client, a connection to another server is closed
+    if ((client->sock >= 0) && ((port != client->port) || (strcasecmp(new_host, client->host) != 0))) esp_http_client_close(client);
+    strcpy(client->host, new_host);
+    client->port = port;
+    snprintf(client->path, sizeof(client->path), "%s", (*rest == '\0') ? "/" : rest);
+    return true;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (client == NULL) return NULL;
+    client->sock          = -1;
+    client->method        = config->method;
+    client->event_handler = config->event_handler;
+    client->user_data     = config->user_data;
+    client->timeout_ms    = (config->timeout_ms > 0) ? config->timeout_ms : 5000;
+    if (!parse_url(client, config->url)) {
+        free(client);
+        return NULL;
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char* url) { return parse_url(client, url) ? ESP_OK : ESP_FAIL; }
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char* key) {
+    for (size_t index = 0; index < SHIM_MAX_HEADERS; index++) {
+        shim_header_t* header = &client->headers[index];
+        if ((header->key == NULL) || (strcasecmp(header->key, key) != 0)) continue;
+        free(header->key);
+        free(header->value);
+        header->key   = NULL;
+        header->value = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value) {
+    esp_http_client_delete_header(client, key);
+    for (size_t index = 0; index < SHIM_MAX_HEADERS; index++) {
+        shim_header_t* header = &client->headers[index];
+        if (header->key != NULL) continue;
+        header->key   = strdup(key);
+        header->value = strdup(value);
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char* data, int len) {
+    client->post_data   = data;
+    client->post_length = len;
+    return ESP_OK;
+}
+
+static bool connect_socket(esp_http_client_handle_t client) {
+    char port[8];
+    snprintf(port, sizeof(port), "%d", client->port);
+    struct addrinfo  hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo* addr  = NULL;
+    if ((getaddrinfo(client->host, port, &hints, &addr) != 0) || (addr == NULL)) return false;
+    int sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if ((sock >= 0) && (connect(sock, addr->ai_addr, addr->ai_addrlen) != 0)) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(addr);
+    if (sock < 0) return false;
+    struct timeval timeout = {.tv_sec = client->timeout_ms / 1000, .tv_usec = (client->timeout_ms % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    client->sock     = sock;
+    client->buffered = 0;
+    client->position = 0;
+    return true;
+}
+
+static bool send_all(esp_http_client_handle_t client, const void* data, size_t length) {
+    const uint8_t* position = data;
+    while (length > 0) {
+        ssize_t sent = send(client->sock, position, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        position += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Make sure there is buffered data, returns false when the connection was closed or timed out
+static bool fill(esp_http_client_handle_t client) {
+    if (client->position < client->buffered) return true;
+    ssize_t received = recv(client->sock, client->buffer, sizeof(client->buffer), 0);
+    if (received <= 0) return false;
+    client->buffered = received;
+    client->position = 0;
+    return true;
+}
+
+static bool read_line(esp_http_client_handle_t client, char* line, size_t size) {
+    size_t length = 0;
+    while (true) {
+        if (!fill(client)) return false;
+        char c = client->buffer[client->position++];
+        if (c == '\n') break;
+        if ((c != '\r') && (length < size - 1)) line[length++] = c;
+    }
+    line[length] = '\0';
+    return true;
+}
+
+// Pass up to `length` bytes of the body to the event handler, returns the amount passed or 0 if the connection was lost
+static size_t read_body(esp_http_client_handle_t client, size_t length) {
+    if (!fill(client)) return 0;
+    size_t available = client->buffered - client->position;
+    if (available > length) available = length;
+    dispatch(client, HTTP_EVENT_ON_DATA, &client->buffer[client->position], available, NULL, NULL);
+    client->position += available;
+    return available;
+}
+
+static esp_err_t fail(esp_http_client_handle_t client, esp_err_t err) {
+    dispatch(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+    esp_http_client_close(client);
+    return err;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) {
+    static const char* methods[] = {"GET", "POST", "PUT", "PATCH", "DELETE", "HEAD"};
+    client->status               = 0;
+    client->content_length       = -1;
+    if (client->sock < 0) {
+        if (!connect_socket(client)) return fail(client, ESP_ERR_HTTP_CONNECT);
+        dispatch(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    }
+
+    char request[1024];
+    int  length = snprintf(request, sizeof(request), "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n", methods[client->method],
+                           client->path, client->host, client->port);
+    for (size_t index = 0; index < SHIM_MAX_HEADERS; index++) {
+        if (client->headers[index].key == NULL) continue;
+        length += snprintf(&request[length], sizeof(request) - length, "%s: %s\r\n", client->headers[index].key, client->headers[index].value);
+    }
+    if (client->post_data != NULL) length += snprintf(&request[length], sizeof(request) - length, "Content-Length: %d\r\n", client->post_length);
+    length += snprintf(&request[length], sizeof(request) - length, "\r\n");
+    if (!send_all(client, request, length)) return fail(client, ESP_ERR_HTTP_WRITE_DATA);
+    if ((client->post_data != NULL) && (!send_all(client, client->post_data, client->post_length))) return fail(client, ESP_ERR_HTTP_WRITE_DATA);
+    dispatch(client, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+
+    char line[512];
+    int  minor = 0;
+    if ((!read_line(client, line, sizeof(line))) || (sscanf(line, "HTTP/1.%d %d", &minor, &client->status) != 2)) {
+        return fail(client, ESP_ERR_HTTP_FETCH_HEADER);
+    }
+    bool keep_alive = (minor >= 1);
+    bool chunked    = false;
+    while (true) {
+        if (!read_line(client, line, sizeof(line))) return fail(client, ESP_ERR_HTTP_FETCH_HEADER);
+        if (line[0] == '\0') break;
+        char* value = strchr(line, ':');
+        if (value == NULL) continue;
+        *value++ = '\0';
+        while (*value == ' ') value++;
+        if (strcasecmp(line, "Content-Length") == 0) client->content_length = atoll(value);
+        if ((strcasecmp(line, "Transfer-Encoding") == 0) && (strcasecmp(value, "chunked") == 0)) chunked = true;
+        if (strcasecmp(line, "Connection") == 0) keep_alive = (strcasecmp(value, "close") != 0);
+        dispatch(client, HTTP_EVENT_ON_HEADER, NULL, 0, line, value);
+    }
+
+    // Like esp_http_client, reading stops without an error when the event handler closed the connection
+    bool no_body = (client->method == HTTP_METHOD_HEAD) || (client->status == 204) || (client->status == 304) || (client->status < 200);
+    if (no_body) {
+    } else if (chunked) {
+        while (client->sock >= 0) {
+            if (!read_line(client, line, sizeof(line))) return fail(client, ESP_FAIL);
+            size_t left = strtoul(line, NULL, 16);
+            if (left == 0) {
+                if (!read_line(client, line, sizeof(line))) return fail(client, ESP_FAIL);
+                break;
+            }
+            while ((left > 0) && (client->sock >= 0)) {
+                size_t passed = read_body(client, left);
+                if (passed == 0) return fail(client, ESP_FAIL);
+                left -= passed;
+            }
+            if ((client->sock >= 0) && (!read_line(client, line, sizeof(line)))) return fail(client, ESP_FAIL);
+        }
+    } else if (client->content_length >= 0) {
+        int64_t left = client->content_length;
+        while ((left > 0) && (client->sock >= 0)) {
+            size_t passed = read_body(client, left);
+            if (passed == 0) return fail(client, ESP_FAIL);
+            left -= passed;
+        }
+    } else {
+        while ((client->sock >= 0) && (read_body(client, SHIM_BUFFER_SIZE) > 0)) {
+        }
+        keep_alive = false;
+    }
+    dispatch(client, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+    if (!keep_alive) esp_http_client_close(client);
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) { return client->status; }
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) { return client->content_length; }
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    if (client->sock < 0) return ESP_OK;
+    close(client->sock);
+    client->sock = -1;
+    dispatch(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    if (client == NULL) return ESP_FAIL;
+    esp_http_client_close(client);
+    for (size_t index = 0; index < SHIM_MAX_HEADERS; index++) {
+        free(client->headers[index].key);
+        free(client->headers[index].value);
+    }
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOG_SHIM(level, tag, format, ...) fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_SHIM("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_SHIM("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_SHIM("I", tag, format, ##__VA_ARGS__)
+// Debug and verbose messages are left out, but still compiled like the arguments are used
+#define ESP_LOGD(tag, format, ...)                                        \
+    do {                                                                  \
+        if (0) ESP_LOG_SHIM("D", tag, format, ##__VA_ARGS__);             \
+    } while (0)
+#define ESP_LOGV(tag, format, ...)                                        \
+    do {                                                                  \
+        if (0) ESP_LOG_SHIM("V", tag, format, ##__VA_ARGS__);             \
+    } while (0)
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum { ESP_PD_DOMAIN_RTC_SLOW_MEM } esp_sleep_pd_domain_t;
+typedef enum { ESP_PD_OPTION_ON } esp_sleep_pd_option_t;
+
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option);
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+void      esp_deep_sleep_start();
@@ -0,0 +1,38 @@
+#include "esp_system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "esp_err.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+const char* esp_err_to_name(esp_err_t code) {
+    static char name[16];
+    snprintf(name, sizeof(name), "0x%x", code);
+    return name;
+}
+
+uint32_t esp_random() { return (uint32_t) random(); }
+
+int64_t esp_timer_get_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// The ROM function and zlib compute the same CRC, both invert it before and after
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) { return (uint32_t) crc32(crc, buf, len); }
+
+__attribute__((weak)) size_t strlcpy(char* destination, const char* source, size_t size) {
+    size_t length = strlen(source);
+    if (size > 0) {
+        size_t copied = (length < size - 1) ? length : size - 1;
+        memcpy(destination, source, copied);
+        destination[copied] = '\0';
+    }
+    return length;
+}
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct _shim_semaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    UBaseType_t     count;
+    UBaseType_t     max;
+};
+
+typedef struct {
+    TaskFunction_t function;
+    void*          arg;
+} shim_task_t;
+
+typedef struct {
+    pthread_t thread;
+    uint32_t  count;
+    bool      used;
+} shim_notification_t;
+
+#define SHIM_MAX_TASKS 16
+
+static pthread_mutex_t     notify_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t      notify_cond  = PTHREAD_COND_INITIALIZER;
+static shim_notification_t notifications[SHIM_MAX_TASKS];
+
+static void* task_main(void* arg) {
+    shim_task_t task = *(shim_task_t*) arg;
+    free(arg);
+    task.function(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg, UBaseType_t priority, TaskHandle_t* handle) {
+    shim_task_t* task = malloc(sizeof(shim_task_t));
+    if (task == NULL) return pdFAIL;
+    task->function = function;
+    task->arg      = arg;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_main, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle != NULL) *handle = (TaskHandle_t) thread;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+    return xTaskCreate(function, name, stack_size, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != NULL) abort();
+    pthread_mutex_lock(&notify_mutex);
+    for (size_t index = 0; index < SHIM_MAX_TASKS; index++) {
+        if (notifications[index].used && pthread_equal(notifications[index].thread, pthread_self())) notifications[index].used = false;
+    }
+    pthread_mutex_unlock(&notify_mutex);
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) { usleep(ticks * 1000); }
+
+TickType_t xTaskGetTickCount() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t) (now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+// Notification counter of a thread, created on first use (call with notify_mutex held)
+static shim_notification_t* notification(pthread_t thread) {
+    shim_notification_t* free_entry = NULL;
+    for (size_t index = 0; index < SHIM_MAX_TASKS; index++) {
+        if (notifications[index].used && pthread_equal(notifications[index].thread, thread)) return &notifications[index];
+        if ((!notifications[index].used) && (free_entry == NULL)) free_entry = &notifications[index];
+    }
+    if (free_entry == NULL) abort();
+    free_entry->thread = thread;
+    free_entry->count  = 0;
+    free_entry->used   = true;
+    return free_entry;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&notify_mutex);
+    notification((pthread_t) task)->count++;
+    pthread_cond_broadcast(&notify_cond);
+    pthread_mutex_unlock(&notify_mutex);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (ticks % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&notify_mutex);
+    shim_notification_t* entry = notification(pthread_self());
+    while (entry->count == 0) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&notify_cond, &notify_mutex);
+        } else if (pthread_cond_timedwait(&notify_cond, &notify_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t count = entry->count;
+    if (count > 0) entry->count = clear ? 0 : (count - 1);
+    pthread_mutex_unlock(&notify_mutex);
+    return count;
+}
+
+static SemaphoreHandle_t create(UBaseType_t max, UBaseType_t initial) {
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(struct _shim_semaphore));
+    if (semaphore == NULL) return NULL;
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&semaphore->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    semaphore->count = initial;
+    semaphore->max   = max;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return create(1, 1); }
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return create(1, 0); }
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) { return create(max, initial); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (ticks % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&semaphore->mutex);
+    while (semaphore->count == 0) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+        } else if (pthread_cond_timedwait(&semaphore->cond, &semaphore->mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    BaseType_t taken = (semaphore->count > 0) ? pdTRUE : pdFALSE;
+    if (taken) semaphore->count--;
+    pthread_mutex_unlock(&semaphore->mutex);
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    pthread_mutex_lock(&semaphore->mutex);
+    BaseType_t given = (semaphore->count < semaphore->max) ? pdTRUE : pdFALSE;
+    if (given) semaphore->count++;
+    pthread_cond_signal(&semaphore->cond);
+    pthread_mutex_unlock(&semaphore->mutex);
+    return given;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    if (semaphore == NULL) return;
+    pthread_mutex_destroy(&semaphore->mutex);
+    pthread_cond_destroy(&semaphore->cond);
+    free(semaphore);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// FreeRTOS on top of pthreads, one tick is one millisecond.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// The FreeRTOS headers of ESP-IDF pull these in, the firmware relies on that
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdFALSE            0
+#define pdTRUE             1
+#define pdFAIL             0
+#define pdPASS             1
+#define portMAX_DELAY      ((TickType_t) 0xffffffff)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  ((TickType_t) (ms))
+
+// Critical sections nest on the same core, a recursive mutex does the same for a thread
+typedef pthread_mutex_t portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+#define portENTER_CRITICAL(mux)      pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)       pthread_mutex_unlock(mux)
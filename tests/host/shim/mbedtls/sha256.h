@@ -0,0 +1,39 @@
+#pragma once
+
+// The SHA-256 API of mbedtls 2.x, as used with ESP-IDF v4.4, on top of OpenSSL. Link with -lcrypto.
+
+#include <openssl/evp.h>
+#include <stddef.h>
+
+typedef struct {
+    EVP_MD_CTX* context;
+} mbedtls_sha256_context;
+
+static inline void mbedtls_sha256_init(mbedtls_sha256_context* ctx) { ctx->context = EVP_MD_CTX_new(); }
+
+static inline void mbedtls_sha256_free(mbedtls_sha256_context* ctx) {
+    EVP_MD_CTX_free(ctx->context);
+    ctx->context = NULL;
+}
+
+static inline int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, int is224) {
+    return EVP_DigestInit_ex(ctx->context, is224 ? EVP_sha224() : EVP_sha256(), NULL) ? 0 : -1;
+}
+
+static inline int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length) {
+    return EVP_DigestUpdate(ctx->context, input, length) ? 0 : -1;
+}
+
+static inline int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+    return EVP_DigestFinal_ex(ctx->context, output, NULL) ? 0 : -1;
+}
+
+static inline int mbedtls_sha256_ret(const unsigned char* input, size_t length, unsigned char output[32], int is224) {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    int res = mbedtls_sha256_starts_ret(&ctx, is224);
+    if (res == 0) res = mbedtls_sha256_update_ret(&ctx, input, length);
+    if (res == 0) res = mbedtls_sha256_finish_ret(&ctx, output);
+    mbedtls_sha256_free(&ctx);
+    return res;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Functions of the newlib C library of ESP-IDF that older glibc versions lack, included in every file with -include.
+
+#include <stddef.h>
+
+size_t strlcpy(char* destination, const char* source, size_t size);
@@ -0,0 +1,5 @@
+#pragma once
+
+// Configuration of the firmware as far as the code under test uses it.
+#define CONFIG_DOWNLOAD_CONCURRENCY 3
+#define CONFIG_WL_SECTOR_SIZE       4096
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+// The RTC registers are plain variables
+extern uint32_t shim_rtc_store0;
+
+#define RTC_CNTL_STORE0_REG   (&shim_rtc_store0)
+#define REG_READ(reg)         (*(reg))
+#define REG_WRITE(reg, value) (*(reg) = (value))
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+bool     wait_for_button();
+uint8_t* load_file_to_ram(FILE* fd);
+size_t   get_file_size(FILE* fd);
@@ -0,0 +1,3 @@
+#pragma once
+
+// Empty: nothing from this header is used by the code under test.
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Whether the badge is connected, see shim_wifi_connected in fakes.c.
+bool wifi_is_connected();
@@ -0,0 +1,142 @@
+// Updating an app in AppFS with a patch made by tools/appfs_patch.py, fed to appfs_patch.c in chunks of random sizes.
+// The patched entry has to match the SHA-256 of the new app, a corrupted or truncated patch leaves the old app untouched.
+
+#include <string.h>
+
+#include "appfs.h"
+#include "appfs_patch.h"
+#include "host_test.h"
+#include "mbedtls/sha256.h"
+
+#define OLD_SIZE   150001
+#define OLD_PATH   "build/test_appfs_patch.old"
+#define NEW_PATH   "build/test_appfs_patch.new"
+#define PATCH_PATH "build/test_appfs_patch.patch"
+
+static uint8_t old_app[OLD_SIZE];
+static uint8_t new_app[OLD_SIZE + 10000];
+static size_t  new_size;
+
+static void save(const char* path, const uint8_t* data, size_t size) {
+    FILE* file = fopen(path, "wb");
+    CHECK(file != NULL);
+    CHECK(fwrite(data, 1, size, file) == size);
+    fclose(file);
+}
+
+static uint8_t* load(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(*size);
+    CHECK(fread(data, 1, *size, file) == *size);
+    fclose(file);
+    return data;
+}
+
+// A new version of the app: some bytes changed, a block inserted and a block removed, like a rebuild after a small change
+static void make_new_app() {
+    memcpy(new_app, old_app, 40000);
+    for (size_t index = 1000; index < 40000; index += 997) new_app[index]++;
+    for (size_t index = 40000; index < 45000; index++) new_app[index] = random();
+    memcpy(&new_app[45000], &old_app[40000], 60000);
+    memcpy(&new_app[105000], &old_app[110000], OLD_SIZE - 110000);
+    new_size = 105000 + OLD_SIZE - 110000;
+}
+
+static void install_old_app() {
+    appfs_sink_t sink;
+    CHECK(appfs_sink_begin(&sink, "app", "App", 1, OLD_SIZE, NULL) == ESP_OK);
+    CHECK(appfs_sink_write(&sink, old_app, OLD_SIZE) == ESP_OK);
+    CHECK(appfs_sink_finish(&sink) == ESP_OK);
+}
+
+static void entry_sha256(const char* name, uint8_t hash[32]) {
+    appfs_handle_t handle = appfsOpen(name);
+    CHECK(handle != APPFS_INVALID_FD);
+    int size = 0;
+    appfsEntryInfo(handle, NULL, &size);
+    uint8_t* data = malloc(size);
+    CHECK(appfsRead(handle, 0, data, size) == ESP_OK);
+    CHECK(mbedtls_sha256_ret(data, size, hash, 0) == 0);
+    free(data);
+}
+
+// Feed `length` bytes of the patch in chunks of random sizes, returns the first error
+static esp_err_t apply(appfs_patch_t* patch, const uint8_t* data, size_t length) {
+    size_t position = 0;
+    while (position < length) {
+        size_t chunk = 1 + (random() % 3000);
+        if (chunk > length - position) chunk = length - position;
+        esp_err_t res = appfs_patch_write(patch, &data[position], chunk);
+        if (res != ESP_OK) return res;
+        position += chunk;
+    }
+    return ESP_OK;
+}
+
+int main() {
+    for (size_t index = 0; index < OLD_SIZE; index++) {
+        old_app[index] = random();
+    }
+    make_new_app();
+    save(OLD_PATH, old_app, OLD_SIZE);
+    save(NEW_PATH, new_app, new_size);
+    CHECK(system("python3 ../../tools/appfs_patch.py " OLD_PATH " " NEW_PATH " " PATCH_PATH) == 0);
+    size_t   patch_size = 0;
+    uint8_t* patch_data = load(PATCH_PATH, &patch_size);
+
+    uint8_t old_hash[32];
+    uint8_t new_hash[32];
+    uint8_t hash[32];
+    CHECK(mbedtls_sha256_ret(old_app, OLD_SIZE, old_hash, 0) == 0);
+    CHECK(mbedtls_sha256_ret(new_app, new_size, new_hash, 0) == 0);
+
+    // The patched entry replaces the old one and has the SHA-256 of the new app
+    appfs_patch_t patch;
+    install_old_app();
+    CHECK(appfs_patch_begin(&patch, "app", "App", 2, NULL) == ESP_OK);
+    CHECK(apply(&patch, patch_data, patch_size) == ESP_OK);
+    CHECK(appfs_patch_finish(&patch) == ESP_OK);
+    entry_sha256("app", hash);
+    CHECK(memcmp(hash, new_hash, sizeof(hash)) == 0);
+    CHECK(shim_appfs_count() == 1);
+
+    // A patch for another version of the app is refused right away
+    CHECK(appfs_patch_begin(&patch, "app", "App", 3, NULL) == ESP_OK);
+    CHECK(apply(&patch, patch_data, patch_size) == ESP_ERR_INVALID_VERSION);
+    appfs_patch_abort(&patch);
+    entry_sha256("app", hash);
+    CHECK(memcmp(hash, new_hash, sizeof(hash)) == 0);
+
+    // A corrupted byte in the diff data of the first block is caught by the hash, the old app stays
+    install_old_app();
+    size_t diff_length = patch_data[APPFS_PATCH_HEADER_SIZE] | (patch_data[APPFS_PATCH_HEADER_SIZE + 1] << 8) | (patch_data[APPFS_PATCH_HEADER_SIZE + 2] << 16);
+    CHECK(diff_length > 0);
+    size_t corrupted = APPFS_PATCH_HEADER_SIZE + APPFS_PATCH_BLOCK_SIZE + diff_length / 2;
+    patch_data[corrupted] ^= 0x40;
+    CHECK(appfs_patch_begin(&patch, "app", "App", 2, NULL) == ESP_OK);
+    CHECK(apply(&patch, patch_data, patch_size) == ESP_OK);
+    CHECK(appfs_patch_finish(&patch) == ESP_ERR_INVALID_CRC);
+    patch_data[corrupted] ^= 0x40;
+    entry_sha256("app", hash);
+    CHECK(memcmp(hash, old_hash, sizeof(hash)) == 0);
+    CHECK(shim_appfs_count() == 1);
+
+    // So is a truncated patch
+    CHECK(appfs_patch_begin(&patch, "app", "App", 2, NULL) == ESP_OK);
+    CHECK(apply(&patch, patch_data, patch_size - 100) == ESP_OK);
+    CHECK(appfs_patch_finish(&patch) == ESP_ERR_INVALID_SIZE);
+    entry_sha256("app", hash);
+    CHECK(memcmp(hash, old_hash, sizeof(hash)) == 0);
+    CHECK(shim_appfs_count() == 1);
+
+    free(patch_data);
+    remove(OLD_PATH);
+    remove(NEW_PATH);
+    remove(PATCH_PATH);
+    printf("test_appfs_patch: OK\n");
+    return 0;
+}
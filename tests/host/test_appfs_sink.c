@@ -0,0 +1,103 @@
+// Writing an app to AppFS while it streams in, the way app_management.c installs a downloaded app.
+// The stream is fake: random data cut into chunks of random sizes, like the HTTP client delivers them.
+
+#include <string.h>
+#include <unistd.h>
+
+#include "appfs.h"
+#include "appfs_wrapper.h"
+#include "host_test.h"
+
+#define APP_SIZE  200001  // Spans several 64 KB pages and ends in the middle of a sector
+#define COPY_PATH "build/test_appfs_sink.copy"
+
+static uint8_t app[APP_SIZE];
+
+// Feed `length` bytes of the app to the sink in chunks of 1 to `max_chunk` bytes
+static esp_err_t stream(appfs_sink_t* sink, size_t length, size_t max_chunk) {
+    size_t position = 0;
+    while (position < length) {
+        size_t chunk = 1 + (random() % max_chunk);
+        if (chunk > length - position) chunk = length - position;
+        esp_err_t res = appfs_sink_write(sink, &app[position], chunk);
+        if (res != ESP_OK) return res;
+        position += chunk;
+    }
+    return ESP_OK;
+}
+
+static void check_installed(const char* name) {
+    appfs_handle_t handle = appfsOpen(name);
+    CHECK(handle != APPFS_INVALID_FD);
+    int size = 0;
+    appfsEntryInfo(handle, NULL, &size);
+    CHECK(size == APP_SIZE);
+    static uint8_t stored[APP_SIZE];
+    CHECK(appfsRead(handle, 0, stored, APP_SIZE) == ESP_OK);
+    CHECK(memcmp(stored, app, APP_SIZE) == 0);
+}
+
+static void check_copy() {
+    static uint8_t copy[APP_SIZE + 1];
+    FILE*          file = fopen(COPY_PATH, "rb");
+    CHECK(file != NULL);
+    CHECK(fread(copy, 1, sizeof(copy), file) == APP_SIZE);
+    fclose(file);
+    CHECK(memcmp(copy, app, APP_SIZE) == 0);
+}
+
+int main() {
+    for (size_t index = 0; index < APP_SIZE; index++) {
+        app[index] = random();
+    }
+    appfs_sink_t sink;
+
+    // Chunks of every size, small ones hit the sector buffer and large ones the erase ahead
+    size_t max_chunks[] = {1, 7, 1460, 4096, 70000};
+    for (size_t index = 0; index < sizeof(max_chunks) / sizeof(max_chunks[0]); index++) {
+        CHECK(appfs_sink_begin(&sink, "app", "App", 1, APP_SIZE, NULL) == ESP_OK);
+        CHECK(stream(&sink, APP_SIZE, max_chunks[index]) == ESP_OK);
+        CHECK(appfs_sink_finish(&sink) == ESP_OK);
+        check_installed("app");
+        CHECK(shim_appfs_count() == 1);
+    }
+
+    // A copy is written next to the entry
+    CHECK(appfs_sink_begin(&sink, "app", "App", 2, APP_SIZE, COPY_PATH) == ESP_OK);
+    CHECK(stream(&sink, APP_SIZE, 5000) == ESP_OK);
+    CHECK(appfs_sink_finish(&sink) == ESP_OK);
+    check_installed("app");
+    check_copy();
+
+    // A download that is retried from the start aborts the sink and begins again, like appfs_receive does
+    CHECK(appfs_sink_begin(&sink, "app", "App", 3, APP_SIZE, COPY_PATH) == ESP_OK);
+    CHECK(stream(&sink, APP_SIZE / 2, 5000) == ESP_OK);
+    appfs_sink_abort(&sink);
+    CHECK(appfs_sink_begin(&sink, "app", "App", 3, APP_SIZE, COPY_PATH) == ESP_OK);
+    CHECK(stream(&sink, APP_SIZE, 5000) == ESP_OK);
+    CHECK(appfs_sink_finish(&sink) == ESP_OK);
+    check_installed("app");
+    check_copy();
+    CHECK(shim_appfs_count() == 1);
+
+    // A stream that ends early leaves nothing behind
+    CHECK(appfs_sink_begin(&sink, "short", "Short", 1, APP_SIZE, COPY_PATH) == ESP_OK);
+    CHECK(stream(&sink, APP_SIZE - 1, 5000) == ESP_OK);
+    CHECK(appfs_sink_finish(&sink) == ESP_ERR_INVALID_SIZE);
+    CHECK(appfsOpen("short") == APPFS_INVALID_FD);
+    CHECK(access(COPY_PATH, F_OK) != 0);
+
+    // Neither does a stream that sends more than the announced size
+    CHECK(appfs_sink_begin(&sink, "long", "Long", 1, APP_SIZE - 5000, NULL) == ESP_OK);
+    CHECK(stream(&sink, APP_SIZE, 5000) == ESP_ERR_INVALID_SIZE);
+    appfs_sink_abort(&sink);
+    CHECK(appfsOpen("long") == APPFS_INVALID_FD);
+    CHECK(shim_appfs_count() == 1);
+
+    // An empty app is refused before anything is created
+    CHECK(appfs_sink_begin(&sink, "empty", "Empty", 1, 0, NULL) == ESP_ERR_INVALID_SIZE);
+    CHECK(shim_appfs_count() == 1);
+
+    printf("test_appfs_sink: OK\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Resuming downloads after the connection dropped. The stand-in server cuts responses off at random points,
+// every download has to end up identical to the served file, byte for byte.
+// Run with drops: with_server.sh --drop-rate 0.5 --seed 1 -- test_download_resume
+
+#include <string.h>
+
+#include "host_test.h"
+#include "http_download.h"
+
+#define FILE_SIZE (300 * 1000 + 7)
+#define FILE_PATH "build/test_download_resume.bin"
+
+typedef struct {
+    uint8_t* data;
+    size_t   size;
+    bool     out_of_order;  // A chunk didn't continue where the previous one ended, and didn't restart at 0 either
+} collected_t;
+
+static bool collect(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    collected_t* collected = (collected_t*) user;
+    if ((offset != 0) && (offset != collected->size)) collected->out_of_order = true;
+    collected->data = realloc(collected->data, offset + length);
+    CHECK(collected->data != NULL);
+    memcpy(&collected->data[offset], data, length);
+    collected->size = offset + length;
+    return true;
+}
+
+static unsigned char* replacement = NULL;  // New contents of the file, written during the download
+
+// Collect the data and replace the served file as soon as the download has started
+static bool collect_and_replace(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    if (replacement == NULL) replacement = standin_random_file("file.bin", FILE_SIZE);
+    return collect(data, length, offset, total, user);
+}
+
+int main() {
+    unsigned char* expected = standin_random_file("file.bin", FILE_SIZE);
+
+    // To a file, resumed with a range request
+    CHECK(download_file(standin_url("/file.bin"), FILE_PATH));
+    FILE* file = fopen(FILE_PATH, "rb");
+    CHECK(file != NULL);
+    static uint8_t downloaded[FILE_SIZE + 1];
+    CHECK(fread(downloaded, 1, sizeof(downloaded), file) == FILE_SIZE);
+    fclose(file);
+    CHECK(memcmp(downloaded, expected, FILE_SIZE) == 0);
+    remove(FILE_PATH);
+
+    // To RAM
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    CHECK(download_ram(standin_url("/file.bin"), &data, &size));
+    CHECK(size == FILE_SIZE);
+    CHECK(memcmp(data, expected, FILE_SIZE) == 0);
+    free(data);
+
+    // Streamed, the callback sees the offsets continue where the dropped response stopped
+    collected_t collected = {0};
+    CHECK(download_stream(standin_url("/file.bin"), collect, &collected));
+    CHECK(!collected.out_of_order);
+    CHECK(collected.size == FILE_SIZE);
+    CHECK(memcmp(collected.data, expected, FILE_SIZE) == 0);
+    free(collected.data);
+
+    // The file changes while it is downloaded. After a drop If-Range makes the server send the new file completely
+    // instead of a range of it, the result is one of the two files and never a mix.
+    bool restarted = false;
+    for (int attempt = 0; (attempt < 10) && (!restarted); attempt++) {
+        collected_t changing = {0};
+        CHECK(download_stream(standin_url("/file.bin"), collect_and_replace, &changing));
+        CHECK(!changing.out_of_order);
+        CHECK(changing.size == FILE_SIZE);
+        restarted = (memcmp(changing.data, replacement, FILE_SIZE) == 0);
+        if (!restarted) CHECK(memcmp(changing.data, expected, FILE_SIZE) == 0);  // Not dropped after the change
+        free(changing.data);
+        free(expected);
+        expected    = replacement;
+        replacement = NULL;
+    }
+    CHECK(restarted);
+
+    int drops = standin_stat("drops");
+    printf("%d responses were dropped\n", drops);
+    CHECK(drops > 0);
+    free(expected);
+    printf("test_download_resume: OK\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Inflating real gzip files, made with the gzip command, fed in chunks of every size.
+// The inflater in ROM reads ahead into the gzip trailer, see shim/esp32/rom/miniz.h.
+// The files are also downloaded from the stand-in server, which serves file.gz for file to clients that accept gzip.
+
+#include <string.h>
+
+#include "gzip_stream.h"
+#include "host_test.h"
+#include "http_download.h"
+
+#define TEXT_SIZE   100000
+#define RANDOM_SIZE 50000
+
+typedef struct {
+    uint8_t* data;
+    size_t   size;
+} output_t;
+
+static bool collect(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    output_t* output = (output_t*) user;
+    CHECK(offset == output->size);
+    output->data = realloc(output->data, output->size + length);
+    CHECK(output->data != NULL);
+    memcpy(&output->data[output->size], data, length);
+    output->size += length;
+    return true;
+}
+
+static uint8_t* load(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(*size);
+    CHECK(fread(data, 1, *size, file) == *size);
+    fclose(file);
+    return data;
+}
+
+// Write `data` to the root of the stand-in server and compress it with gzip, `options` are passed to gzip
+static uint8_t* make_gzip(const char* name, const uint8_t* data, size_t size, const char* options, size_t* compressed_size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", standin_root(), name);
+    FILE* file = fopen(path, "wb");
+    CHECK(file != NULL);
+    CHECK(fwrite(data, 1, size, file) == size);
+    fclose(file);
+    char command[1200];
+    snprintf(command, sizeof(command), "gzip %s -c '%s' > '%s.gz'", options, path, path);
+    CHECK(system(command) == 0);
+    strcat(path, ".gz");
+    return load(path, compressed_size);
+}
+
+static void inflate_in_chunks(const uint8_t* compressed, size_t compressed_size, const uint8_t* expected, size_t size) {
+    size_t chunk_sizes[] = {1, 2, 3, 5, 8, 13, 100, 1460, 4096, compressed_size};
+    for (size_t index = 0; index < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); index++) {
+        output_t       output = {0};
+        gzip_stream_t* stream = gzip_stream_create(collect, &output);
+        CHECK(stream != NULL);
+        for (size_t position = 0; position < compressed_size; position += chunk_sizes[index]) {
+            size_t chunk = (compressed_size - position < chunk_sizes[index]) ? (compressed_size - position) : chunk_sizes[index];
+            CHECK(gzip_stream_feed(stream, &compressed[position], chunk));
+        }
+        CHECK(gzip_stream_finished(stream));
+        CHECK(gzip_stream_output_size(stream) == size);
+        CHECK(output.size == size);
+        CHECK((size == 0) || (memcmp(output.data, expected, size) == 0));
+        gzip_stream_free(stream);
+        free(output.data);
+    }
+}
+
+int main() {
+    static uint8_t text[TEXT_SIZE];
+    for (size_t index = 0; index < TEXT_SIZE; index++) {
+        text[index] = "the quick brown fox jumps over the lazy dog\n"[(index * 7 + (index / 1000)) % 44];
+    }
+    static uint8_t noise[RANDOM_SIZE];
+    for (size_t index = 0; index < RANDOM_SIZE; index++) {
+        noise[index] = random();
+    }
+
+    // With and without the file name in the header, compressible and incompressible
+    size_t   compressed_size;
+    uint8_t* compressed = make_gzip("text.txt", text, TEXT_SIZE, "-9", &compressed_size);
+    inflate_in_chunks(compressed, compressed_size, text, TEXT_SIZE);
+
+    // A corrupted trailer is noticed
+    compressed[compressed_size - 6] ^= 0x01;
+    output_t       output = {0};
+    gzip_stream_t* stream = gzip_stream_create(collect, &output);
+    CHECK(!gzip_stream_feed(stream, compressed, compressed_size));
+    CHECK(!gzip_stream_finished(stream));
+    gzip_stream_free(stream);
+    free(output.data);
+    free(compressed);
+
+    compressed = make_gzip("noise.bin", noise, RANDOM_SIZE, "-n -1", &compressed_size);
+    inflate_in_chunks(compressed, compressed_size, noise, RANDOM_SIZE);
+    free(compressed);
+
+    compressed = make_gzip("empty.txt", text, 0, "", &compressed_size);
+    inflate_in_chunks(compressed, compressed_size, text, 0);
+    free(compressed);
+
+    // Downloaded with Content-Encoding: gzip
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    CHECK(download_ram(standin_url("/text.txt"), &data, &size));
+    CHECK(size == TEXT_SIZE);
+    CHECK(memcmp(data, text, TEXT_SIZE) == 0);
+    free(data);
+    CHECK(standin_stat("gzip") == 1);
+
+    printf("test_gzip_stream: OK\n");
+    return 0;
+}
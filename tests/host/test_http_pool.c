@@ -0,0 +1,92 @@
+// Connection reuse of http_pool, counted by the stand-in server.
+// Run with a keep-alive timeout of 2 seconds: with_server.sh --keep-alive 2 -- test_http_pool
+
+#include <string.h>
+#include <unistd.h>
+
+#include "host_test.h"
+#include "http_download.h"
+#include "http_pool.h"
+
+#define FILE_SIZE 20000
+
+static void download_and_compare(const char* path, const unsigned char* expected) {
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    CHECK(download_ram(standin_url(path), &data, &size));
+    CHECK(size == FILE_SIZE);
+    CHECK(memcmp(data, expected, FILE_SIZE) == 0);
+    free(data);
+}
+
+extern bool shim_wifi_connected;
+
+static bool reject(const uint8_t* data, size_t length, size_t offset, size_t total, void* user) {
+    (*(int*) user)++;
+    return false;
+}
+
+int main() {
+    unsigned char* expected = standin_random_file("file.bin", FILE_SIZE);
+    uint32_t       connections, reuses;
+
+    // Requests to the same server share a single connection
+    for (int request = 0; request < 5; request++) {
+        download_and_compare("/file.bin", expected);
+    }
+    CHECK(standin_stat("connections") == 1);
+    http_pool_get_stats(&connections, &reuses);
+    CHECK((connections == 1) && (reuses == 5));
+
+    // An error status doesn't close the connection
+    uint8_t* data = NULL;
+    CHECK(!download_ram_post(standin_url("/missing"), "text/plain", "", 0, &data, NULL));
+    download_and_compare("/file.bin", expected);
+    CHECK(standin_stat("connections") == 1);
+
+    // A missing file is not retried, the server would give the same answer
+    int requests = standin_stat("requests");
+    CHECK(!download_ram(standin_url("/missing.bin"), &data, NULL));
+    CHECK(standin_stat("requests") - requests - 1 == 1);
+
+    // A body the callback rejects is not retried, and the connection is closed instead of reading the rest of the body
+    int calls          = 0;
+    int connections_at = standin_stat("connections");
+    requests           = standin_stat("requests");
+    CHECK(!download_stream(standin_url("/file.bin"), reject, &calls));
+    CHECK(calls == 1);
+    CHECK(standin_stat("requests") - requests - 1 == 1);
+    download_and_compare("/file.bin", expected);
+    CHECK(standin_stat("connections") == connections_at + 1);
+
+    // Without WiFi nothing is requested, and there is nothing to retry
+    requests            = standin_stat("requests");
+    shim_wifi_connected = false;
+    CHECK(!download_ram(standin_url("/file.bin"), &data, NULL));
+    CHECK(!download_ram_cached(standin_url("/file.bin"), &data, NULL));
+    shim_wifi_connected = true;
+    CHECK(standin_stat("requests") - requests - 1 == 0);
+
+    // A connection that the server is about to close is not reused
+    download_and_compare("/file.bin", expected);
+    int connections_before = standin_stat("connections");
+    sleep(1);
+    http_pool_get_stats(&connections, &reuses);
+    download_and_compare("/file.bin", expected);
+    uint32_t reuses_after;
+    http_pool_get_stats(NULL, &reuses_after);
+    CHECK(reuses_after == reuses);
+    CHECK(standin_stat("connections") == connections_before + 1);
+
+    // Neither is a connection the server already closed
+    sleep(3);
+    http_pool_get_stats(&connections, &reuses);
+    download_and_compare("/file.bin", expected);
+    http_pool_get_stats(NULL, &reuses_after);
+    CHECK(reuses_after == reuses);
+    CHECK(standin_stat("connections") == connections_before + 2);
+
+    free(expected);
+    printf("test_http_pool: OK\n");
+    return 0;
+}
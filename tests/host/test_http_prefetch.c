@@ -0,0 +1,53 @@
+// Cancelling prefetches. A cancelled prefetch, or one of a response that is too large to prefetch, closes its connection
+// instead of reading the rest of the response, so the foreground doesn't wait for it.
+
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_timer.h"
+#include "host_test.h"
+#include "http_prefetch.h"
+
+#define SMALL_SIZE (HTTP_PREFETCH_MAX_SIZE - 1000)  // Takes about two seconds at the prefetch rate
+#define LARGE_SIZE (HTTP_PREFETCH_MAX_SIZE * 4)
+
+// Wait for `url` like the foreground does, returns the time it took in milliseconds
+static int64_t wait_ms(const char* url) {
+    int64_t start = esp_timer_get_time();
+    http_prefetch_wait(url);
+    return (esp_timer_get_time() - start) / 1000;
+}
+
+int main() {
+    free(standin_random_file("small.bin", SMALL_SIZE));
+    free(standin_random_file("large.bin", LARGE_SIZE));
+    CHECK(http_prefetch_start());
+
+    // A response that is too large is given up on at its first chunk
+    int connections = standin_stat("connections");
+    int requests    = standin_stat("requests");
+    http_prefetch(standin_url("/large.bin"));
+    usleep(200 * 1000);
+    CHECK(wait_ms(standin_url("/other.bin")) < 100);
+    CHECK(standin_stat("requests") - requests - 1 == 1);
+    CHECK(standin_stat("connections") == connections + 1);
+
+    // Cancelled while throttled
+    connections = standin_stat("connections");
+    http_prefetch(standin_url("/small.bin"));
+    usleep(300 * 1000);
+    http_prefetch_cancel();
+    CHECK(wait_ms(standin_url("/other.bin")) < 500);
+    CHECK(standin_stat("connections") == connections + 1);
+
+    // Waiting for the running prefetch reads the rest of it at full speed, the connection stays open
+    connections = standin_stat("connections");
+    http_prefetch(standin_url("/small.bin"));
+    usleep(300 * 1000);
+    CHECK(wait_ms(standin_url("/small.bin")) < 500);
+    CHECK(standin_stat("connections") == connections);
+
+    http_prefetch_stop();
+    printf("test_http_prefetch: OK\n");
+    return 0;
+}
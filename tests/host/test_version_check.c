@@ -0,0 +1,87 @@
+// Checking the installed apps for updates against the stand-in server, see POST /versions in tools/standin_server.py.
+// Apps the batched response leaves out, or all apps when it fails, are checked through their app info instead.
+
+#include <string.h>
+
+#include "host_test.h"
+#include "version_check.h"
+
+#define APPS 5
+
+static const char* slugs[APPS] = {"snake", "tetris", "clock", "badge_name", "synth"};
+
+static version_check_item_t items[APPS];
+
+static void write_file(const char* path, const char* contents) {
+    char full_path[512];
+    snprintf(full_path, sizeof(full_path), "%s/%s", standin_root(), path);
+    char command[600];
+    snprintf(command, sizeof(command), "mkdir -p \"$(dirname '%s')\"", full_path);
+    CHECK(system(command) == 0);
+    FILE* file = fopen(full_path, "w");
+    CHECK(file != NULL);
+    fputs(contents, file);
+    fclose(file);
+}
+
+static int latest(size_t index) { return 10 + index; }
+
+// Write the "versions" file the batched endpoint answers from, with the first `count` apps
+static void write_versions(size_t count) {
+    char   versions[1024] = "[";
+    size_t length         = 1;
+    for (size_t index = 0; index < count; index++) {
+        length += snprintf(&versions[length], sizeof(versions) - length, "%s{\"type\": \"esp32\", \"category\": \"games\", \"slug\": \"%s\", \"version\": %d}",
+                           (index > 0) ? ", " : "", slugs[index], latest(index));
+    }
+    snprintf(&versions[length], sizeof(versions) - length, "]");
+    write_file("versions", versions);
+}
+
+// Check all apps, returns the number of requests it took
+static int check(bool expect_complete) {
+    for (size_t index = 0; index < APPS; index++) {
+        items[index] = (version_check_item_t){.type = "esp32", .category = "games", .slug = slugs[index], .installed = 1, .latest = 0};
+    }
+    int requests = standin_stat("requests");
+    CHECK(version_check(items, APPS) == expect_complete);
+    return standin_stat("requests") - requests - 1;  // Without the second /stats request
+}
+
+int main() {
+    for (size_t index = 0; index < APPS; index++) {
+        char path[64];
+        char info[64];
+        snprintf(path, sizeof(path), "esp32/games/%s", slugs[index]);
+        snprintf(info, sizeof(info), "{\"slug\": \"%s\", \"version\": %d}", slugs[index], latest(index));
+        write_file(path, info);
+    }
+
+    // No batched endpoint, every app is checked individually
+    CHECK(check(true) == 1 + APPS);
+    CHECK(standin_stat("versions") == 0);
+    for (size_t index = 0; index < APPS; index++) CHECK(items[index].latest == latest(index));
+
+    // One batched request answers for all apps
+    write_versions(APPS);
+    CHECK(check(true) == 1);
+    CHECK(standin_stat("versions") == 1);
+    for (size_t index = 0; index < APPS; index++) CHECK(items[index].latest == latest(index));
+
+    // The batched response leaves out the last two apps, only those are checked individually
+    write_versions(APPS - 2);
+    CHECK(check(true) == 1 + 2);
+    CHECK(standin_stat("versions") == 2);
+    for (size_t index = 0; index < APPS; index++) CHECK(items[index].latest == latest(index));
+
+    // An app the server doesn't know at all stays unknown, the others are still found
+    char path[64];
+    snprintf(path, sizeof(path), "%s/esp32/games/%s", standin_root(), slugs[APPS - 1]);
+    CHECK(remove(path) == 0);
+    check(false);
+    for (size_t index = 0; index < APPS - 1; index++) CHECK(items[index].latest == latest(index));
+    CHECK(items[APPS - 1].latest == -1);
+
+    printf("test_version_check: OK\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+#!/usr/bin/env bash
+# Run a host test against the stand-in server: with_server.sh [server options] -- test [arguments]
+# The server serves a fresh temporary directory, its location and the URL of the server are passed to the test
+# in STANDIN_ROOT and STANDIN_URL.
+set -e
+
+repo="$(cd "$(dirname "$0")/../.." && pwd)"
+server_args=()
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+	server_args+=("$1")
+	shift
+done
+shift
+
+work="$(mktemp -d)"
+mkdir "$work/root"
+python3 "$repo/tools/standin_server.py" --port-file "$work/port" "${server_args[@]}" "$work/root" &
+server=$!
+trap 'kill $server 2> /dev/null; rm -rf "$work"' EXIT
+for attempt in $(seq 50); do
+	[ -f "$work/port" ] && break
+	sleep 0.1
+done
+if [ ! -f "$work/port" ]; then
+	echo "Stand-in server did not start"
+	exit 1
+fi
+
+export STANDIN_ROOT="$work/root"
+export STANDIN_URL="http://127.0.0.1:$(cat "$work/port")"
+"$@"
@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Create a patch that updates an esp32 app in AppFS from one version to the next.
+
+Usage: appfs_patch.py old.bin new.bin patch.bin
+
+The patch format is described in main/include/appfs_patch.h. Requires the bsdiff4 package.
+"""
+
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x31445041  # "APD1"
+
+
+def write_patch(old, new, control, diff, extra):
+    """Serialize bsdiff control tuples with their diff and extra data, interleaved so the patch can be applied while it streams in."""
+    patch = bytearray(struct.pack("<III", MAGIC, len(old), len(new)))
+    patch += hashlib.sha256(new).digest()
+    diff_position = 0
+    extra_position = 0
+    for diff_length, extra_length, adjustment in control:
+        patch += struct.pack("<IIi", diff_length, extra_length, adjustment)
+        patch += diff[diff_position:diff_position + diff_length]
+        patch += extra[extra_position:extra_position + extra_length]
+        diff_position += diff_length
+        extra_position += extra_length
+    return bytes(patch)
+
+
+def main():
+    if len(sys.argv) != 4:
+        print(__doc__.strip())
+        sys.exit(1)
+    import bsdiff4.core
+
+    with open(sys.argv[1], "rb") as f:
+        old = f.read()
+    with open(sys.argv[2], "rb") as f:
+        new = f.read()
+    control, diff, extra = bsdiff4.core.diff(old, new)
+    patch = write_patch(old, new, control, diff, extra)
+    with open(sys.argv[3], "wb") as f:
+        f.write(patch)
+    print("{}: {} bytes ({:.1f}% of {})".format(sys.argv[3], len(patch), 100.0 * len(patch) / max(len(new), 1), sys.argv[2]))
+    print("sha256 of {}: {}".format(sys.argv[1], hashlib.sha256(old).hexdigest()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+"""Convert a PEM certificate to DER, so the firmware can embed it without having to decode it at runtime.
+
+Usage: pem_to_der.py certificate.pem certificate.der
+
+The PEM file must contain exactly one certificate. Used by main/CMakeLists.txt.
+"""
+
+import base64
+import sys
+
+BEGIN = "-----BEGIN CERTIFICATE-----"
+END = "-----END CERTIFICATE-----"
+
+
+def pem_to_der(pem):
+    """Return the DER encoding of the single certificate in the PEM text."""
+    if pem.count(BEGIN) != 1 or pem.count(END) != 1:
+        raise ValueError("expected exactly one certificate")
+    body = pem.split(BEGIN)[1].split(END)[0]
+    return base64.b64decode("".join(body.split()), validate=True)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip())
+        sys.exit(1)
+
+    with open(sys.argv[1], "r") as f:
+        pem = f.read()
+    try:
+        der = pem_to_der(pem)
+    except ValueError as error:
+        print("{}: {}".format(sys.argv[1], error))
+        sys.exit(1)
+    with open(sys.argv[2], "wb") as f:
+        f.write(der)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""Stand-in for the Hatchery and OTA servers, for testing the download code without the real servers.
+
+Usage: standin_server.py [options] root
+
+Serves the files in root over HTTP/1.1 with keep-alive. Idle connections are closed after the keep-alive
+timeout, which is announced in a Keep-Alive header like real servers do.
+GET /stats returns the connections and TLS handshakes the server has seen as JSON, so tests can check
+that connections are reused.
+
+Files are served with an ETag and support resuming with Range and If-Range. With --drop-rate the server
+drops the connection at a random point in the body of that fraction of the responses, to test resuming.
+Clients that accept gzip get file.gz with Content-Encoding: gzip for file, if it exists.
+
+POST /versions is the batched version check of the Hatchery. It answers with the entries of the JSON list in
+the file "versions" in root that match the requested apps, or 404 if there is no such file. Apps left out of that
+file test the fallback to the app info, which is served from the file type/category/slug.
+
+With --tls the server speaks HTTPS, for pointing a badge at it through the "mirror.hatchery" NVS key.
+Used by the host tests in tests/host.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import random
+import re
+import socket
+import ssl
+import sys
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Stats:
+    """Counters shared by all connections."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.values = {"connections": 0, "handshakes": 0, "resumed": 0, "requests": 0, "drops": 0, "gzip": 0, "versions": 0}
+
+    def add(self, key, amount=1):
+        with self.lock:
+            self.values[key] += amount
+
+    def get(self):
+        with self.lock:
+            return dict(self.values)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        # The socket timeout closes idle connections, handle_one_request gives up on a connection that times out
+        self.timeout = self.server.options.keep_alive
+        super().setup()
+
+    def log_message(self, format, *args):
+        if self.server.options.verbose:
+            super().log_message(format, *args)
+
+    def send_body(self, status, body, content_type="application/octet-stream", headers=None, drop=False):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("Keep-Alive", "timeout={}".format(self.server.options.keep_alive))
+        for key, value in (headers or {}).items():
+            self.send_header(key, value)
+        self.end_headers()
+        if self.command == "HEAD":
+            return
+        if drop and len(body) > 0 and self.server.should_drop():
+            # Send part of the body and drop the connection without closing it cleanly
+            self.wfile.write(body[:self.server.drop_point(len(body))])
+            self.wfile.flush()
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, b"\x01\x00\x00\x00\x00\x00\x00\x00")
+            self.close_connection = True
+            return
+        self.wfile.write(body)
+
+    def file_path(self):
+        path = os.path.normpath(self.path.split("?")[0].lstrip("/"))
+        if path.startswith(".."):
+            return None
+        path = os.path.join(self.server.options.root, path)
+        return path if os.path.isfile(path) else None
+
+    def do_GET(self):
+        self.server.stats.add("requests")
+        if self.path == "/stats":
+            self.send_body(200, json.dumps(self.server.stats.get()).encode(), "application/json")
+            return
+        path = self.file_path()
+        if path is None:
+            self.send_body(404, b"Not found\n", "text/plain")
+            return
+        with open(path, "rb") as f:
+            data = f.read()
+        etag = '"{}"'.format(hashlib.sha256(data).hexdigest()[:16])
+        if self.headers.get("If-None-Match") == etag:
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+        start = self.range_start(etag)
+        if start is not None and start < len(data):
+            content_range = "bytes {}-{}/{}".format(start, len(data) - 1, len(data))
+            self.send_body(206, data[start:], headers={"ETag": etag, "Content-Range": content_range}, drop=True)
+            return
+        compressed = path + ".gz"
+        if start is None and "gzip" in self.headers.get("Accept-Encoding", "") and os.path.isfile(compressed):
+            with open(compressed, "rb") as f:
+                data = f.read()
+            self.server.stats.add("gzip")
+            self.send_body(200, data, headers={"ETag": etag + "-gzip", "Content-Encoding": "gzip"}, drop=True)
+            return
+        self.send_body(200, data, headers={"ETag": etag}, drop=True)
+
+    def range_start(self, etag):
+        """Return the start of the requested range, or None if the complete file has to be sent."""
+        match = re.fullmatch(r"bytes=(\d+)-", self.headers.get("Range", ""))
+        if match is None:
+            return None
+        if_range = self.headers.get("If-Range")
+        if if_range is not None and if_range != etag:
+            return None  # The file changed since the first part was downloaded
+        return int(match.group(1))
+
+    do_HEAD = do_GET
+
+    def do_POST(self):
+        self.server.stats.add("requests")
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        path = os.path.join(self.server.options.root, "versions")
+        if self.path != "/versions" or not os.path.isfile(path):
+            self.send_body(404, b"Not found\n", "text/plain")
+            return
+        try:
+            requested = json.loads(body)
+            with open(path) as f:
+                known = json.load(f)
+        except ValueError:
+            self.send_body(400, b"Bad request\n", "text/plain")
+            return
+        keys = ("type", "category", "slug")
+        wanted = {tuple(app.get(key) for key in keys) for app in requested}
+        response = [app for app in known if tuple(app.get(key) for key in keys) in wanted]
+        self.server.stats.add("versions")
+        self.send_body(200, json.dumps(response).encode(), "application/json")
+
+
+class Server(ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, options):
+        self.options = options
+        self.stats = Stats()
+        self.context = None
+        self.random = random.Random(options.seed)
+        self.random_lock = threading.Lock()
+        if options.tls is not None:
+            self.context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+            self.context.load_cert_chain(*options.tls)
+        super().__init__((options.host, options.port), Handler)
+
+    def should_drop(self):
+        with self.random_lock:
+            drop = self.random.random() < self.options.drop_rate
+        if drop:
+            self.stats.add("drops")
+        return drop
+
+    def drop_point(self, length):
+        with self.random_lock:
+            return self.random.randrange(length)
+
+    def finish_request(self, request, client_address):
+        # The handshake is done in the connection thread, so a slow client doesn't block the others
+        self.stats.add("connections")
+        if self.context is not None:
+            try:
+                request = self.context.wrap_socket(request, server_side=True)
+            except (ssl.SSLError, OSError):
+                return
+            self.stats.add("resumed" if request.session_reused else "handshakes")
+        super().finish_request(request, client_address)
+
+    def handle_error(self, request, client_address):
+        # Clients close the connection in the middle of a response to abort a download
+        if isinstance(sys.exc_info()[1], (ConnectionResetError, BrokenPipeError)):
+            return
+        super().handle_error(request, client_address)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("root", help="directory with the files to serve")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=0, help="port to listen on, a free port is picked by default")
+    parser.add_argument("--port-file", help="write the port the server listens on to this file once it accepts connections")
+    parser.add_argument("--keep-alive", type=int, default=5, help="seconds an idle connection is kept open")
+    parser.add_argument("--drop-rate", type=float, default=0.0, help="fraction of the responses that is cut off at a random point")
+    parser.add_argument("--seed", type=int, help="seed for the random drops, to make a test repeatable")
+    parser.add_argument("--tls", nargs=2, metavar=("CERT", "KEY"), help="serve HTTPS with this certificate and key")
+    parser.add_argument("--verbose", action="store_true", help="log every request")
+    options = parser.parse_args()
+
+    server = Server(options)
+    port = server.server_address[1]
+    if options.port_file is not None:
+        with open(options.port_file + ".tmp", "w") as f:
+            f.write("{}\n".format(port))
+        os.rename(options.port_file + ".tmp", options.port_file)
+    print("Serving {} on port {}".format(options.root, port), file=sys.stderr)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()